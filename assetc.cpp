@@ -0,0 +1,132 @@
+/*
+ * ========================================
+ * Asset Compiler
+ * ========================================
+ * Bakes the source geometry in models.cpp into .mesh files, run by the
+ * build. All the welding, normal generation and LOD simplification
+ * happens here, once, instead of at every launch.
+ *
+ * Lit meshes are packed to VERTEX_FORMAT_PACKED, --float keeps them as
+ * plain floats to compare against.
+ */
+#include "log.h"
+#include "mesh.h"
+#include "meshfile.h"
+#include "models.h"
+#include "shipmeshes.h"
+#include "vertexformat.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static const MeshAttribute POSITION_ATTRIBUTES[] = {
+  { 0, 3, MESH_FLOAT32, 0, 0 }
+};
+
+// Triangles kept by the ship's lower LODs, as a share of the full model.
+// LOD n is written to ship_lodn.mesh.
+static const float SHIP_LOD_KEEP[] = { 0.5f, 0.25f };
+static_assert(sizeof(SHIP_LOD_KEEP) / sizeof(SHIP_LOD_KEEP[0]) + 1 == SHIP_LODS,
+              "one keep ratio for every ship LOD after the first");
+
+// Unpacks every attribute again and checks it came back within the
+// format's error bound
+static bool checkPacking(const MeshData& data, const VertexLayout& layout, const std::vector<uint8_t>& packed)
+{
+  for (int i = 0; i < 3; i++)
+  {
+    const MeshAttribute& attribute = layout.attributes[i];
+    MeshAttributeType type = (MeshAttributeType) attribute.type;
+
+    float range = 0.0f;
+    for (unsigned int v = 0; v < data.vertexCount(); v++)
+    {
+      for (int k = 0; k < 3; k++)
+        range = std::max(range, std::fabs(data.vertices[v * MESH_STRIDE + i * 3 + k]));
+    }
+    float bound = vertexError(type, attribute.normalized != 0, range);
+
+    for (unsigned int v = 0; v < data.vertexCount(); v++)
+    {
+      float decoded[4];
+      decodeAttribute(type, attribute.normalized != 0, attribute.components,
+                      &packed[(size_t) v * layout.stride + attribute.offset], decoded);
+      for (int k = 0; k < 3; k++)
+      {
+        if (std::fabs(decoded[k] - data.vertices[v * MESH_STRIDE + i * 3 + k]) > bound)
+          return false;
+      }
+    }
+  }
+  return true;
+}
+
+// keep below 1 simplifies the model down to that share of its triangles
+static bool compileLit(const ModelGeometry& model, NormalMode mode, const VertexFormat& format,
+                       const std::string& path, float keep = 1.0f)
+{
+  std::vector<float> positions(model.positions, model.positions + model.positionCount);
+  std::vector<unsigned int> indices(model.indices, model.indices + model.indexCount);
+  std::vector<float> colors(model.colors, model.colors + model.indexCount);
+  if (keep < 1.0f)
+    simplifyMesh(positions, indices, colors, (size_t) (model.indexCount / 3 * keep));
+
+  MeshData data = buildMesh(positions, indices, colors, mode);
+
+  VertexLayout layout = vertexLayout(format);
+  std::vector<uint8_t> vertices;
+  packVertices(data.vertices.data(), data.vertexCount(), layout, vertices);
+  if (!checkPacking(data, layout, vertices))
+  {
+    LOG(ERROR, LOG_ASSET, "ERROR::ASSETC::PACKING_OUT_OF_BOUNDS %s", path.c_str());
+    return false;
+  }
+
+  MeshFileSource source;
+  source.vertices = vertices.data();
+  source.vertexCount = data.vertexCount();
+  source.vertexStride = layout.stride;
+  source.attributes = layout.attributes;
+  source.attributeCount = 3;
+  source.indices = data.indices.data();
+  source.indexCount = (uint32_t) data.indices.size();
+  return writeMeshFile(path.c_str(), source);
+}
+
+// Flat coloured in the shader, only needs positions
+static bool compilePositions(const ModelGeometry& model, const std::string& path)
+{
+  MeshFileSource source;
+  source.vertices = model.positions;
+  source.vertexCount = (uint32_t) (model.positionCount / 3);
+  source.vertexStride = 3 * sizeof(float);
+  source.attributes = POSITION_ATTRIBUTES;
+  source.attributeCount = 1;
+  source.indices = model.indices;
+  source.indexCount = (uint32_t) model.indexCount;
+  return writeMeshFile(path.c_str(), source);
+}
+
+int main(int argc, char* args[])
+{
+  bool floats = argc == 3 && std::strcmp(args[1], "--float") == 0;
+  if (argc != 2 && !floats)
+  {
+    std::cout << "usage: assetc [--float] OUTPUT_DIR" << std::endl;
+    return 1;
+  }
+  std::string out = args[argc - 1];
+  const VertexFormat& format = floats ? VERTEX_FORMAT_FLOAT : VERTEX_FORMAT_PACKED;
+
+  bool ok = compileLit(SHIP_MODEL, NormalMode::FLAT, format, out + "/ship.mesh");
+  for (int lod = 1; lod < SHIP_LODS; lod++)
+  {
+    std::string path = out + "/ship_lod" + std::to_string(lod) + ".mesh";
+    ok = compileLit(SHIP_MODEL, NormalMode::FLAT, format, path, SHIP_LOD_KEEP[lod - 1]) && ok;
+  }
+  ok = compilePositions(LIGHT_MODEL, out + "/light.mesh") && ok;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,662 @@
+/*
+ * ========================================
+ * Microbenchmarks
+ * ========================================
+ * Repeatable timings of the hot paths, for comparing one commit against
+ * another. Every benchmark is warmed up, then timed in batches long enough
+ * to swamp the clock, and reported as the median and spread of the time
+ * per item across the batches. Inputs come from fixed seeds.
+ *
+ *   astro_bench [--filter TEXT] [--reps N] [--json FILE] [--baseline FILE]
+ *   astro_bench --check [--filter TEXT]
+ *
+ * --json writes the results, --baseline reads an earlier --json and shows
+ * how each median moved. Run it from the source directory so the shader
+ * files are found. --check runs no benchmarks, it compares the fast paths
+ * against their references and fails on a difference.
+ */
+#include "simulation.h"
+#include "snapshot.h"
+#include "transforms.h"
+#include "culling.h"
+#include "clusters.h"
+#include "shadersource.h"
+#include "models.h"
+#ifdef BENCH_GLM
+#include "mesh.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+static const double WARMUP_MS = 100.0;
+static const double SAMPLE_MS = 5.0; // Each repetition runs at least this long
+static const int REPETITIONS = 30;
+
+struct Benchmark
+{
+  std::string name;
+  const char* unit; // What one item is
+  size_t items;     // Per call of run
+  std::function<void()> run;
+};
+
+struct BenchResult
+{
+  std::string name;
+  const char* unit;
+  int repetitions;
+  size_t iterations; // Calls of run per repetition
+  double median;     // All times in ns per item
+  double p10;
+  double p90;
+  double p99;
+  double min;
+  double max;
+};
+
+// Results are written here so the work can't be optimized away
+static volatile float sink;
+
+static double nowMs()
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Nearest rank, samples sorted
+static double percentile(const std::vector<double>& samples, double p)
+{
+  size_t rank = (size_t) (p / 100.0 * (samples.size() - 1) + 0.5);
+  return samples[std::min(rank, samples.size() - 1)];
+}
+
+static BenchResult measure(const Benchmark& benchmark, int repetitions)
+{
+  // Warm up caches, branch predictors and clocks, and find out how many
+  // calls fill a sample
+  size_t calls = 0;
+  double start = nowMs(), elapsed = 0;
+  while (elapsed < WARMUP_MS || calls < 3)
+  {
+    benchmark.run();
+    calls++;
+    elapsed = nowMs() - start;
+  }
+  size_t iterations = std::max<size_t>(1, (size_t) (SAMPLE_MS / (elapsed / calls)));
+
+  std::vector<double> samples;
+  for (int r = 0; r < repetitions; r++)
+  {
+    auto sampleStart = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++)
+      benchmark.run();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - sampleStart).count();
+    samples.push_back(ns / ((double) iterations * benchmark.items));
+  }
+  std::sort(samples.begin(), samples.end());
+
+  BenchResult result;
+  result.name = benchmark.name;
+  result.unit = benchmark.unit;
+  result.repetitions = repetitions;
+  result.iterations = iterations;
+  result.median = percentile(samples, 50);
+  result.p10 = percentile(samples, 10);
+  result.p90 = percentile(samples, 90);
+  result.p99 = percentile(samples, 99);
+  result.min = samples.front();
+  result.max = samples.back();
+  return result;
+}
+
+/*
+ * ========================================
+ * Benchmarks
+ * ========================================
+ */
+// Entities spread out and steering at random, like benchEntities
+static void fillWorld(EntityStore& world, size_t count)
+{
+  std::mt19937 random(1234);
+  std::uniform_int_distribution<int> steer(0, 15);
+  std::uniform_real_distribution<float> position(-5.0f, 5.0f);
+  std::uniform_real_distribution<float> angle(-0.7f, 0.7f);
+
+  world.reserve(world.size() + count);
+  for (size_t n = 0; n < count; n++)
+  {
+    size_t i = world.size();
+    world.create(position(random), position(random), MESH_SHIP);
+    world.steer[i] = (uint8_t) steer(random);
+    world.tiltX[i] = angle(random);
+    world.tiltY[i] = angle(random);
+  }
+  snapshotSystem(world);
+}
+
+// What update() ends up doing per tick for every entity: tilt towards the
+// held keys or back to level, clamped, and move within the x limit
+static void addSteering(std::vector<Benchmark>& benchmarks, size_t count)
+{
+  auto world = std::make_shared<EntityStore>();
+  fillWorld(*world, count);
+
+  benchmarks.push_back({ "steering/" + std::to_string(count), "entity", count, [world]
+  {
+    steeringSystem(*world, (float) SimConstants::DT);
+    sink = world->tiltX[0];
+  } });
+}
+
+// What the simulation thread copies out for the renderer after every tick
+static void addSnapshot(std::vector<Benchmark>& benchmarks, size_t count)
+{
+  auto state = std::make_shared<SimState>();
+  fillWorld(state->world, count);
+  auto snapshot = std::make_shared<FrameSnapshot>();
+
+  benchmarks.push_back({ "snapshot/" + std::to_string(count), "entity", count, [state, snapshot]
+  {
+    captureSnapshot(*state, *snapshot);
+    sink = snapshot->current[MESH_SHIP].x[0];
+  } });
+}
+
+// draw()'s per-mesh work: blend the snapshot's two ticks, then build the
+// matrices
+static void addDrawTransforms(std::vector<Benchmark>& benchmarks, size_t count)
+{
+  auto state = std::make_shared<SimState>();
+  fillWorld(state->world, count);
+  steeringSystem(state->world, (float) SimConstants::DT);
+  auto snapshot = std::make_shared<FrameSnapshot>();
+  captureSnapshot(*state, *snapshot);
+  auto blended = std::make_shared<EntityTransforms>();
+  auto matrices = std::make_shared<std::vector<float>>(snapshot->current[MESH_SHIP].x.size() * 16);
+
+  benchmarks.push_back({ "draw_transforms/" + std::to_string(count), "entity", count, [snapshot, blended, matrices]
+  {
+    interpolate(*snapshot, 0.5f, MESH_SHIP, *blended);
+    buildModelMatrices(blended->x.data(), blended->y.data(), blended->tiltX.data(), blended->tiltY.data(),
+                       blended->x.size(), matrices->data());
+    sink = (*matrices)[12];
+  } });
+}
+
+struct TransformInputs
+{
+  std::vector<float> x, y, tiltX, tiltY, out;
+};
+
+static std::shared_ptr<TransformInputs> transformInputs(size_t count)
+{
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<float> position(-5.0f, 5.0f);
+  std::uniform_real_distribution<float> angle(-0.8f, 0.8f);
+
+  auto inputs = std::make_shared<TransformInputs>();
+  for (size_t i = 0; i < count; i++)
+  {
+    inputs->x.push_back(position(random));
+    inputs->y.push_back(position(random));
+    inputs->tiltX.push_back(angle(random));
+    inputs->tiltY.push_back(angle(random));
+  }
+  inputs->out.resize(count * 16);
+  return inputs;
+}
+
+#ifdef BENCH_GLM
+// The translate/rotate chain draw() used to run per entity, what the
+// kernels are timed and checked against
+static glm::mat4 glmModel(float x, float y, float tiltX, float tiltY)
+{
+  glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, 0.0f));
+  model = glm::rotate(model, tiltX, glm::vec3(0.0f, 0.0f, 1.0f));
+  return glm::rotate(model, tiltY, glm::vec3(1.0f, 0.0f, 0.0f));
+}
+#endif
+
+static void addModelMatrices(std::vector<Benchmark>& benchmarks, size_t count)
+{
+  auto inputs = transformInputs(count);
+
+  const SimdLevel LEVELS[] = { SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2 };
+  for (SimdLevel level : LEVELS)
+  {
+    if ((int) level > (int) simdLevel())
+      continue;
+
+    std::string name = std::string("model_matrices/") + simdLevelName(level) + "/" + std::to_string(count);
+    benchmarks.push_back({ name, "matrix", count, [inputs, level, count]
+    {
+      TransformInputs& in = *inputs;
+      buildModelMatrices(level, in.x.data(), in.y.data(), in.tiltX.data(), in.tiltY.data(), count, in.out.data());
+      sink = in.out[12];
+    } });
+  }
+
+#ifdef BENCH_GLM
+  benchmarks.push_back({ "model_matrices/glm_chain/" + std::to_string(count), "matrix", count, [inputs, count]
+  {
+    TransformInputs& in = *inputs;
+    glm::mat4* out = (glm::mat4*) in.out.data();
+    for (size_t i = 0; i < count; i++)
+      out[i] = glmModel(in.x[i], in.y[i], in.tiltX[i], in.tiltY[i]);
+    sink = in.out[12];
+  } });
+#endif
+}
+
+// The game's camera, 20 units above the plane, with three LODs
+static CullView gameCullView()
+{
+  // perspective(45 degrees, 16:9, 0.1, 100) * translate(0, 0, -20), column-major
+  const float nearPlane = 0.1f, farPlane = 100.0f;
+  const float focal = 1.0f / std::tan(0.3926991f);
+  float viewProjection[16] = {};
+  viewProjection[0] = focal * 9.0f / 16.0f;
+  viewProjection[5] = focal;
+  viewProjection[10] = -(farPlane + nearPlane) / (farPlane - nearPlane);
+  viewProjection[11] = -1.0f;
+  viewProjection[14] = -20.0f * viewProjection[10] - 2.0f * farPlane * nearPlane / (farPlane - nearPlane);
+  viewProjection[15] = 20.0f;
+  const float lodPixels[] = { 64.0f, 24.0f, 8.0f };
+  return makeCullView(viewProjection, focal * 720.0f / 2.0f, lodPixels, 3);
+}
+
+// Spread over a field wide enough that about a third of the ships are on
+// screen
+static void addCull(std::vector<Benchmark>& benchmarks, size_t count)
+{
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<float> position(-40.0f, 40.0f);
+  auto x = std::make_shared<std::vector<float>>();
+  auto y = std::make_shared<std::vector<float>>();
+  for (size_t i = 0; i < count; i++)
+  {
+    x->push_back(position(random));
+    y->push_back(position(random));
+  }
+
+  CullView view = gameCullView();
+  auto visible = std::make_shared<VisibleSet>();
+
+  const SimdLevel LEVELS[] = { SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2 };
+  for (SimdLevel level : LEVELS)
+  {
+    if ((int) level > (int) simdLevel())
+      continue;
+
+    std::string name = std::string("cull/") + simdLevelName(level) + "/" + std::to_string(count);
+    benchmarks.push_back({ name, "sphere", count, [x, y, visible, view, level, count]
+    {
+      cullSpheres(level, view, x->data(), y->data(), count, 1.0f, 3, *visible);
+      sink = (float) visible->visible();
+    } });
+  }
+}
+
+// Point lights around the ships in front of the game's camera, binned into
+// the cluster grid on one thread
+static void addLightClusters(std::vector<Benchmark>& benchmarks, size_t count)
+{
+  std::mt19937 random(4321);
+  std::uniform_real_distribution<float> x(-11.0f, 11.0f), y(-8.0f, 8.0f), z(0.0f, 4.0f), radius(2.0f, 5.0f);
+  auto lights = std::make_shared<std::vector<PointLight>>(count);
+  for (PointLight& light : *lights)
+    light = { x(random), y(random), z(random), radius(random), 1.0f, 1.0f, 1.0f, 0.0f };
+
+  // translate(0, 0, -20) and perspective(45 degrees, 4:3, 0.1, 100)'s scales
+  const float focal = 1.0f / std::tan(0.3926991f);
+  float view[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, -20, 1 };
+  float projection[16] = {};
+  projection[0] = focal * 3.0f / 4.0f;
+  projection[5] = focal;
+  ClusterView clusterView = makeClusterView(view, projection, 0.1f, 100.0f);
+  auto clusters = std::make_shared<LightClusters>();
+
+  std::string name = "light_clusters/" + std::to_string(count);
+  benchmarks.push_back({ name, "light", count, [lights, clusters, clusterView, count]
+  {
+    assignLights(clusterView, lights->data(), count, *clusters);
+    sink = (float) clusters->indices.size();
+  } });
+}
+
+#ifdef BENCH_GLM
+// Welding and normal generation, what assetc does for every mesh
+static void addBuildMesh(std::vector<Benchmark>& benchmarks, NormalMode mode, const char* name)
+{
+  const ModelGeometry& model = SHIP_MODEL;
+  auto positions = std::make_shared<std::vector<float>>(model.positions, model.positions + model.positionCount);
+  auto indices = std::make_shared<std::vector<unsigned int>>(model.indices, model.indices + model.indexCount);
+  auto colors = std::make_shared<std::vector<float>>(model.colors, model.colors + model.indexCount);
+
+  benchmarks.push_back({ name, "mesh", 1, [positions, indices, colors, mode]
+  {
+    MeshData data = buildMesh(*positions, *indices, *colors, mode);
+    sink = data.vertices[0];
+  } });
+}
+#endif
+
+// Every file ShaderCompiler reads for the game's programs
+static void addShaderFiles(std::vector<Benchmark>& benchmarks)
+{
+  static const char* FILES[] = {
+    "res/shaders/vertex.glsl", "res/shaders/fragment.glsl",
+    "res/shaders/light_vertex.glsl", "res/shaders/light_fragment.glsl",
+    "res/shaders/fallback_vertex.glsl", "res/shaders/fallback_fragment.glsl"
+  };
+  static const size_t FILE_COUNT = sizeof(FILES) / sizeof(FILES[0]);
+
+  for (const char* file : FILES)
+  {
+    if (readShaderFile(file).empty())
+    {
+      std::fprintf(stderr, "shader_files: %s not found, run from the source directory\n", file);
+      return;
+    }
+  }
+
+  benchmarks.push_back({ "shader_files/read", "file", FILE_COUNT, []
+  {
+    size_t bytes = 0;
+    for (const char* file : FILES)
+      bytes += readShaderFile(file).size();
+    sink = (float) bytes;
+  } });
+
+  auto sources = std::make_shared<std::vector<std::string>>();
+  for (const char* file : FILES)
+    sources->push_back(readShaderFile(file));
+
+  auto defines = std::make_shared<std::vector<std::string>>(1, "INSTANCED");
+  benchmarks.push_back({ "shader_files/defines", "file", FILE_COUNT, [sources, defines]
+  {
+    size_t bytes = 0;
+    for (const std::string& source : *sources)
+      bytes += withDefines(source, *defines).size();
+    sink = (float) bytes;
+  } });
+}
+
+/*
+ * ========================================
+ * Checks
+ * ========================================
+ * The fast paths against their references, run by --check and ctest.
+ * Timing a wrong result is no use.
+ */
+#ifdef BENCH_GLM
+// Every SimdLevel this CPU has against glm. Angles well past the tilt
+// limit reach every quadrant of sin and cos, and the odd count runs the
+// scalar tails too.
+static bool checkModelMatrices()
+{
+  static const size_t COUNT = 100003;
+  static const float TOLERANCE = 1e-5f;
+
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<float> position(-5.0f, 5.0f);
+  std::uniform_real_distribution<float> angle(-10.0f, 10.0f);
+
+  TransformInputs in;
+  std::vector<glm::mat4> expected(COUNT);
+  for (size_t i = 0; i < COUNT; i++)
+  {
+    in.x.push_back(position(random));
+    in.y.push_back(position(random));
+    in.tiltX.push_back(angle(random));
+    in.tiltY.push_back(angle(random));
+    expected[i] = glmModel(in.x[i], in.y[i], in.tiltX[i], in.tiltY[i]);
+  }
+  in.out.resize(COUNT * 16);
+
+  bool passed = true;
+  const SimdLevel LEVELS[] = { SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2 };
+  for (SimdLevel level : LEVELS)
+  {
+    if ((int) level > (int) simdLevel())
+      continue;
+
+    buildModelMatrices(level, in.x.data(), in.y.data(), in.tiltX.data(), in.tiltY.data(), COUNT, in.out.data());
+
+    float worst = 0;
+    for (size_t i = 0; i < COUNT; i++)
+    {
+      const float* model = &expected[i][0][0];
+      for (int k = 0; k < 16; k++)
+        worst = std::max(worst, std::fabs(in.out[i * 16 + k] - model[k]));
+    }
+
+    bool same = worst <= TOLERANCE;
+    passed = passed && same;
+    std::printf("model_matrices/%s: max error %g against glm, %s\n", simdLevelName(level), worst,
+                same ? "same" : "DIFFERENT");
+  }
+  return passed;
+}
+#endif
+
+// One view's lists from every SimdLevel this CPU has against scalar
+static bool compareCulling(const char* name, const CullView& view, const std::vector<float>& x,
+                           const std::vector<float>& y, float radius, int lodCount)
+{
+  VisibleSet expected, actual;
+  cullSpheres(SimdLevel::SCALAR, view, x.data(), y.data(), x.size(), radius, lodCount, expected);
+
+  bool passed = true;
+  const SimdLevel LEVELS[] = { SimdLevel::SSE2, SimdLevel::AVX2 };
+  for (SimdLevel level : LEVELS)
+  {
+    if ((int) level > (int) simdLevel())
+      continue;
+
+    cullSpheres(level, view, x.data(), y.data(), x.size(), radius, lodCount, actual);
+    bool same = true;
+    for (int lod = 0; lod < CULL_MAX_LODS; lod++)
+      same = same && actual.lods[lod] == expected.lods[lod];
+    passed = passed && same;
+    std::printf("culling/%s/%s: %zu of %zu visible, %s\n", simdLevelName(level), name, actual.visible(),
+                x.size(), same ? "same" : "DIFFERENT");
+  }
+  return passed;
+}
+
+// Every SimdLevel gives the same lists in the same order. A seeded field
+// under the game's camera, and a grid whose spheres sit exactly on the
+// planes and LOD threshold of an identity view. Counts are odd so the
+// scalar tails run too.
+static bool checkCulling()
+{
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<float> position(-40.0f, 40.0f);
+  std::vector<float> x, y;
+  for (size_t i = 0; i < 100003; i++)
+  {
+    x.push_back(position(random));
+    y.push_back(position(random));
+  }
+  bool passed = compareCulling("field", gameCullView(), x, y, 1.0f, 3);
+
+  // The planes are x, y = +-1 pushed out by the radius, so 0.5 spheres at
+  // +-1.5 touch them. At w = 1 they come out 32 px, right on the first
+  // threshold.
+  const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+  const float lodPixels[] = { 32.0f, 12.0f };
+  CullView edges = makeCullView(identity, 64.0f, lodPixels, 3);
+  x.clear();
+  y.clear();
+  for (int i = 0; i <= 16; i++)
+  {
+    for (int j = 0; j <= 16; j++)
+    {
+      x.push_back(-2.0f + 0.25f * i);
+      y.push_back(-2.0f + 0.25f * j);
+    }
+  }
+  passed = compareCulling("edges", edges, x, y, 0.5f, 3) && passed;
+
+  // Up the x = -1.5 edge, short enough that some levels never leave
+  // their tail
+  for (size_t count : { 1, 3, 7, 9, 15 })
+  {
+    std::vector<float> headX(x.begin() + 34, x.begin() + 34 + count);
+    std::vector<float> headY(y.begin() + 34, y.begin() + 34 + count);
+    std::string name = "edges/" + std::to_string(count);
+    passed = compareCulling(name.c_str(), edges, headX, headY, 0.5f, 3) && passed;
+  }
+  return passed;
+}
+
+static int runChecks(const char* filter)
+{
+  bool passed = true;
+  if (!filter || std::strstr("culling", filter))
+    passed = checkCulling() && passed;
+#ifdef BENCH_GLM
+  if (!filter || std::strstr("model_matrices", filter))
+    passed = checkModelMatrices() && passed;
+#endif
+  return passed ? 0 : 1;
+}
+
+/*
+ * ========================================
+ * Reporting
+ * ========================================
+ */
+static bool writeJson(const char* path, const std::vector<BenchResult>& results)
+{
+  FILE* file = std::fopen(path, "w");
+  if (!file)
+  {
+    std::fprintf(stderr, "ERROR::BENCH::CANNOT_WRITE %s\n", path);
+    return false;
+  }
+
+  std::fprintf(file, "{\n  \"simd\": \"%s\",\n  \"compiler\": \"%s\",\n  \"benchmarks\": [\n",
+               simdLevelName(simdLevel()), __VERSION__);
+  // One benchmark per line, readBaseline relies on it
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const BenchResult& r = results[i];
+    std::fprintf(file, "    {\"name\": \"%s\", \"unit\": \"ns/%s\", \"repetitions\": %d, \"iterations\": %zu, "
+                 "\"median\": %.4f, \"p10\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"min\": %.4f, \"max\": %.4f}%s\n",
+                 r.name.c_str(), r.unit, r.repetitions, r.iterations, r.median, r.p10, r.p90, r.p99, r.min, r.max,
+                 i + 1 < results.size() ? "," : "");
+  }
+  std::fprintf(file, "  ]\n}\n");
+  return std::fclose(file) == 0;
+}
+
+// Medians by name from a file writeJson made
+static std::map<std::string, double> readBaseline(const char* path)
+{
+  std::map<std::string, double> medians;
+  FILE* file = std::fopen(path, "r");
+  if (!file)
+  {
+    std::fprintf(stderr, "ERROR::BENCH::CANNOT_READ %s\n", path);
+    return medians;
+  }
+
+  char line[1024];
+  while (std::fgets(line, sizeof(line), file))
+  {
+    char name[256];
+    const char* median = std::strstr(line, "\"median\": ");
+    if (median && std::sscanf(line, " {\"name\": \"%255[^\"]\"", name) == 1)
+      medians[name] = std::atof(median + 10);
+  }
+  std::fclose(file);
+  return medians;
+}
+
+int main(int argc, char* args[])
+{
+  const char* filter = nullptr;
+  const char* jsonPath = nullptr;
+  const char* baselinePath = nullptr;
+  int repetitions = REPETITIONS;
+  bool check = false;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (std::strcmp(args[i], "--filter") == 0 && i + 1 < argc)
+      filter = args[++i];
+    else if (std::strcmp(args[i], "--reps") == 0 && i + 1 < argc)
+      repetitions = std::max(1, std::atoi(args[++i]));
+    else if (std::strcmp(args[i], "--json") == 0 && i + 1 < argc)
+      jsonPath = args[++i];
+    else if (std::strcmp(args[i], "--baseline") == 0 && i + 1 < argc)
+      baselinePath = args[++i];
+    else if (std::strcmp(args[i], "--check") == 0)
+      check = true;
+    else
+    {
+      std::printf("usage: astro_bench [--filter TEXT] [--reps N] [--json FILE] [--baseline FILE] | --check [--filter TEXT]\n");
+      return 1;
+    }
+  }
+
+  if (check)
+    return runChecks(filter);
+
+  std::vector<Benchmark> benchmarks;
+  addSteering(benchmarks, 1000);
+  addSteering(benchmarks, 100000);
+  addSnapshot(benchmarks, 10000);
+  addDrawTransforms(benchmarks, 10000);
+  addModelMatrices(benchmarks, 10000);
+  addCull(benchmarks, 100000);
+  addLightClusters(benchmarks, 256);
+  addLightClusters(benchmarks, 1024);
+#ifdef BENCH_GLM
+  addBuildMesh(benchmarks, NormalMode::FLAT, "build_mesh/flat");
+  addBuildMesh(benchmarks, NormalMode::SMOOTH, "build_mesh/smooth");
+#endif
+  addShaderFiles(benchmarks);
+
+  std::map<std::string, double> baseline;
+  if (baselinePath)
+    baseline = readBaseline(baselinePath);
+
+  std::printf("%-40s %10s %10s %10s %10s  %s\n", "benchmark (ns per item)", "median", "p10", "p90", "p99",
+              baselinePath ? "vs baseline" : "");
+
+  std::vector<BenchResult> results;
+  for (const Benchmark& benchmark : benchmarks)
+  {
+    if (filter && benchmark.name.find(filter) == std::string::npos)
+      continue;
+
+    BenchResult r = measure(benchmark, repetitions);
+    results.push_back(r);
+
+    std::string name = r.name + " (" + r.unit + ")";
+    std::printf("%-40s %10.3f %10.3f %10.3f %10.3f", name.c_str(), r.median, r.p10, r.p90, r.p99);
+    auto old = baseline.find(r.name);
+    if (old != baseline.end() && old->second > 0)
+      std::printf("  %+.1f%%", (r.median / old->second - 1.0) * 100.0);
+    std::printf("\n");
+    std::fflush(stdout);
+  }
+
+  if (jsonPath && !writeJson(jsonPath, results))
+    return 1;
+  return 0;
+}
@@ -0,0 +1,63 @@
+#include "camera.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <cmath>
+#include "profiler.h"
+
+Camera::Camera(int width, int height)
+  : width(0), height(0)
+{
+  block.view = glm::mat4(1.0f);
+  block.lightPos = glm::vec3(0.0f);
+  block.lightColor = glm::vec3(1.0f);
+  block.pad0 = block.pad1 = 0;
+
+  glGenBuffers(1, &ubo);
+  glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), NULL, GL_DYNAMIC_DRAW);
+  glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BINDING, ubo);
+
+  resize(width, height);
+}
+
+Camera::~Camera()
+{
+  glDeleteBuffers(1, &ubo);
+}
+
+void Camera::resize(int width, int height)
+{
+  if (width == this->width && height == this->height)
+    return;
+
+  this->width = width;
+  this->height = height;
+  block.projection = glm::perspective(glm::radians(45.0f), (float) width / height, CAMERA_NEAR, CAMERA_FAR);
+  block.clusters = glm::vec4((float) width / CLUSTER_X, (float) height / CLUSTER_Y,
+                             CLUSTER_Z / std::log(CAMERA_FAR / CAMERA_NEAR), CAMERA_NEAR);
+}
+
+void Camera::update(const glm::mat4& view, const glm::vec3& lightPos, const glm::vec3& lightColor)
+{
+  block.view = view;
+  block.lightPos = lightPos;
+  block.lightColor = lightColor;
+
+  glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraBlock), &block);
+  profiler.count(COUNTER_UPLOAD_BYTES, sizeof(CameraBlock));
+}
+
+const glm::mat4& Camera::view() const
+{
+  return block.view;
+}
+
+const glm::mat4& Camera::projection() const
+{
+  return block.projection;
+}
+
+float Camera::pixelScale() const
+{
+  return block.projection[1][1] * height / 2.0f;
+}
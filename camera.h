@@ -0,0 +1,59 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "clusters.h"
+
+/*
+ * ========================================
+ * Camera
+ * ========================================
+ * Per-frame data every program needs, kept in one std140 uniform buffer
+ * bound at CAMERA_BINDING. Programs pick it up with
+ * shader->bindBlock("Camera", CAMERA_BINDING) once after linking.
+ */
+static const unsigned int CAMERA_BINDING = 0;
+static const float CAMERA_NEAR = 0.1f;
+static const float CAMERA_FAR = 100.0f;
+
+// Must match the Camera block in the shaders, std140 pads vec3 to 16 bytes
+struct CameraBlock
+{
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::vec3 lightPos;
+  float pad0;
+  glm::vec3 lightColor;
+  float pad1;
+  // Pixels across and up a light cluster, depth slices per unit of log
+  // depth, near plane. See clusters.h.
+  glm::vec4 clusters;
+};
+
+static_assert(sizeof(CameraBlock) == 176, "CameraBlock must match the std140 layout");
+
+class Camera
+{
+public:
+  Camera(int width, int height);
+  ~Camera();
+
+  // Only recomputes the projection when the size actually changed
+  void resize(int width, int height);
+  // One buffer upload for all programs, call once per frame
+  void update(const glm::mat4& view, const glm::vec3& lightPos, const glm::vec3& lightColor);
+
+  const glm::mat4& view() const;
+  const glm::mat4& projection() const;
+  // Pixels on screen per unit of size at a distance of one, for LOD picking
+  float pixelScale() const;
+
+private:
+  unsigned int ubo;
+  int width;
+  int height;
+  CameraBlock block;
+};
+
+#endif
@@ -0,0 +1,190 @@
+#include "clusters.h"
+#include "jobs.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/*
+ * ========================================
+ * View
+ * ========================================
+ */
+ClusterView makeClusterView(const float* view, const float* projection, float nearPlane, float farPlane)
+{
+  ClusterView cluster;
+  std::memcpy(cluster.view, view, sizeof(cluster.view));
+  cluster.scaleX = projection[0];
+  cluster.scaleY = projection[5];
+  cluster.nearPlane = nearPlane;
+  cluster.farPlane = farPlane;
+  return cluster;
+}
+
+int clusterSlice(float depth, float nearPlane, float farPlane)
+{
+  if (depth <= nearPlane)
+    return 0;
+  int slice = (int) (std::log(depth / nearPlane) * (CLUSTER_Z / std::log(farPlane / nearPlane)));
+  return std::min(slice, CLUSTER_Z - 1);
+}
+
+// Tile of a normalized device coordinate, clamped to the screen
+static int clusterTile(float ndc, int tiles)
+{
+  int tile = (int) std::floor((ndc * 0.5f + 0.5f) * tiles);
+  return std::min(std::max(tile, 0), tiles - 1);
+}
+
+/*
+ * ========================================
+ * Binning
+ * ========================================
+ */
+// The box of clusters a light touches, inclusive, false if none
+struct LightBounds
+{
+  int x0, x1, y0, y1, z0, z1;
+};
+
+static bool lightBounds(const ClusterView& view, const PointLight& light, LightBounds& out)
+{
+  const float* v = view.view;
+  float cx = v[0] * light.x + v[4] * light.y + v[8] * light.z + v[12];
+  float cy = v[1] * light.x + v[5] * light.y + v[9] * light.z + v[13];
+  float depth = -(v[2] * light.x + v[6] * light.y + v[10] * light.z + v[14]);
+  float r = light.radius;
+  if (depth + r < view.nearPlane || depth - r > view.farPlane)
+    return false;
+
+  // On screen a view space x is scaleX * x / depth, so the box's extremes
+  // are at its nearest or furthest depth
+  float nearest = std::max(depth - r, view.nearPlane), furthest = std::min(depth + r, view.farPlane);
+  float left = std::min(view.scaleX * (cx - r) / nearest, view.scaleX * (cx - r) / furthest);
+  float right = std::max(view.scaleX * (cx + r) / nearest, view.scaleX * (cx + r) / furthest);
+  float bottom = std::min(view.scaleY * (cy - r) / nearest, view.scaleY * (cy - r) / furthest);
+  float top = std::max(view.scaleY * (cy + r) / nearest, view.scaleY * (cy + r) / furthest);
+  if (right < -1 || left > 1 || top < -1 || bottom > 1)
+    return false;
+
+  out.x0 = clusterTile(left, CLUSTER_X);
+  out.x1 = clusterTile(right, CLUSTER_X);
+  out.y0 = clusterTile(bottom, CLUSTER_Y);
+  out.y1 = clusterTile(top, CLUSTER_Y);
+  out.z0 = clusterSlice(nearest, view.nearPlane, view.farPlane);
+  out.z1 = clusterSlice(furthest, view.nearPlane, view.farPlane);
+  return true;
+}
+
+// Counts, then places, so each cluster's lights end up in light order
+static void binSlice(int z, const std::vector<LightBounds>& bounds, const std::vector<uint16_t>& lights,
+                     LightClusters& out)
+{
+  std::vector<uint32_t>& ranges = out.sliceRanges[z];
+  ranges.assign(CLUSTER_X * CLUSTER_Y * 2, 0);
+  for (size_t i = 0; i < bounds.size(); i++)
+  {
+    const LightBounds& box = bounds[i];
+    if (z < box.z0 || z > box.z1)
+      continue;
+    for (int y = box.y0; y <= box.y1; y++)
+    {
+      for (int x = box.x0; x <= box.x1; x++)
+        ranges[(y * CLUSTER_X + x) * 2 + 1]++;
+    }
+  }
+
+  // Counts become offsets, the second slot the fill cursor, counts again
+  // once everyone's in
+  uint32_t total = 0;
+  for (int c = 0; c < CLUSTER_X * CLUSTER_Y; c++)
+  {
+    ranges[c * 2] = total;
+    total += ranges[c * 2 + 1];
+    ranges[c * 2 + 1] = 0;
+  }
+
+  std::vector<uint16_t>& indices = out.sliceIndices[z];
+  indices.resize(total);
+  for (size_t i = 0; i < bounds.size(); i++)
+  {
+    const LightBounds& box = bounds[i];
+    if (z < box.z0 || z > box.z1)
+      continue;
+    for (int y = box.y0; y <= box.y1; y++)
+    {
+      for (int x = box.x0; x <= box.x1; x++)
+      {
+        uint32_t* range = &ranges[(y * CLUSTER_X + x) * 2];
+        indices[range[0] + range[1]++] = lights[i];
+      }
+    }
+  }
+}
+
+void assignLights(const ClusterView& view, const PointLight* lights, size_t count, LightClusters& out,
+                  JobSystem* jobs, bool everywhere)
+{
+  count = std::min(count, CLUSTER_MAX_LIGHTS);
+  out.lights = count;
+  out.ranges.resize(CLUSTER_COUNT * 2);
+
+  if (everywhere)
+  {
+    out.indices.resize(count);
+    for (size_t i = 0; i < count; i++)
+      out.indices[i] = (uint16_t) i;
+    for (int c = 0; c < CLUSTER_COUNT; c++)
+    {
+      out.ranges[c * 2] = 0;
+      out.ranges[c * 2 + 1] = (uint32_t) count;
+    }
+    return;
+  }
+
+  // Lights nobody can see are dropped here
+  std::vector<LightBounds> bounds;
+  std::vector<uint16_t> visible;
+  bounds.reserve(count);
+  visible.reserve(count);
+  for (size_t i = 0; i < count; i++)
+  {
+    LightBounds box;
+    if (lightBounds(view, lights[i], box))
+    {
+      bounds.push_back(box);
+      visible.push_back((uint16_t) i);
+    }
+  }
+
+  auto bin = [&](size_t begin, size_t end)
+  {
+    for (size_t z = begin; z < end; z++)
+      binSlice((int) z, bounds, visible, out);
+  };
+  if (jobs)
+    jobs->parallelFor("light clusters", CLUSTER_Z, 1, bin);
+  else
+    bin(0, CLUSTER_Z);
+
+  // Slices in order, offsets moved past the ones before
+  size_t total = 0;
+  for (int z = 0; z < CLUSTER_Z; z++)
+    total += out.sliceIndices[z].size();
+  out.indices.resize(total);
+
+  uint32_t base = 0;
+  for (int z = 0; z < CLUSTER_Z; z++)
+  {
+    const std::vector<uint32_t>& ranges = out.sliceRanges[z];
+    uint32_t* into = &out.ranges[z * CLUSTER_X * CLUSTER_Y * 2];
+    for (int c = 0; c < CLUSTER_X * CLUSTER_Y; c++)
+    {
+      into[c * 2] = base + ranges[c * 2];
+      into[c * 2 + 1] = ranges[c * 2 + 1];
+    }
+
+    const std::vector<uint16_t>& indices = out.sliceIndices[z];
+    std::copy(indices.begin(), indices.end(), out.indices.begin() + base);
+    base += (uint32_t) indices.size();
+  }
+}
@@ -0,0 +1,74 @@
+#ifndef CLUSTERS_H
+#define CLUSTERS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+/*
+ * ========================================
+ * Light Clusters
+ * ========================================
+ * The view frustum cut into CLUSTER_X by CLUSTER_Y screen tiles and
+ * CLUSTER_Z depth slices, spaced evenly in log depth so they stay roughly
+ * cube shaped. Every point light is binned into the clusters its bounding
+ * sphere's box touches; the fragment shader works out its own cluster and
+ * only shades that cluster's lights, however many there are in total.
+ *
+ * Binning goes a slice at a time, slices spread across the job system.
+ * Each slice lists its lights in light order into its own buffer and the
+ * buffers are joined in slice order, so the result doesn't depend on how
+ * many threads there were.
+ */
+static const int CLUSTER_X = 16;
+static const int CLUSTER_Y = 9;
+static const int CLUSTER_Z = 24;
+static const int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+// Light numbers are 16 bit, and the shader's loop has to end somewhere
+static const size_t CLUSTER_MAX_LIGHTS = 1024;
+
+// Laid out as the two RGBA texels per light the shader reads
+struct PointLight
+{
+  float x, y, z;
+  float radius; // Falls off to nothing here
+  float r, g, b;
+  float pad;
+};
+
+struct ClusterView
+{
+  float view[16];   // Column-major, glm's layout
+  float scaleX;     // projection[0][0]
+  float scaleY;     // projection[1][1]
+  float nearPlane;
+  float farPlane;
+};
+
+// Symmetric perspective projections only, what glm::perspective makes
+ClusterView makeClusterView(const float* view, const float* projection, float nearPlane, float farPlane);
+
+// Depth slice of a view space distance, the shader does the same sum
+int clusterSlice(float depth, float nearPlane, float farPlane);
+
+struct LightClusters
+{
+  // Per cluster, x fastest then y then slice: offset into indices, count
+  std::vector<uint32_t> ranges;
+  std::vector<uint16_t> indices;
+  size_t lights; // Binned, past CLUSTER_MAX_LIGHTS are dropped
+
+  // One per slice, joined after
+  std::vector<uint16_t> sliceIndices[CLUSTER_Z];
+  std::vector<uint32_t> sliceRanges[CLUSTER_Z];
+};
+
+// Refills out. Without jobs, or with everywhere set, it runs on the calling
+// thread. everywhere puts every light in every cluster, plain forward
+// shading, to compare against.
+void assignLights(const ClusterView& view, const PointLight* lights, size_t count, LightClusters& out,
+                  JobSystem* jobs = nullptr, bool everywhere = false);
+
+#endif
@@ -0,0 +1,304 @@
+#include "collision.h"
+#include "simulation.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+/*
+ * ========================================
+ * Broad Phase
+ * ========================================
+ */
+// Keys are row-major cell numbers inside the bodies' bounding box, so a
+// row of cells is one contiguous key range and the keys stay small enough
+// to sort in two passes for any sensible world. Grids wider than this many
+// cells clamp the outliers into the edge cells, slow but still correct.
+static const int64_t GRID_MAX_CELLS = 0xFFFF;
+
+static inline int32_t cellCoordinate(float position, float inverseCell)
+{
+  float cell = std::floor(position * inverseCell);
+  cell = std::min(std::max(cell, -1e9f), 1e9f);
+  return (int32_t) cell;
+}
+
+// LSD radix sort of (key, value) pairs, 11 bits a pass, only as many
+// passes as the largest key needs
+static void radixSort(std::vector<uint32_t>& keys, std::vector<uint32_t>& values, uint32_t maxKey,
+                      std::vector<uint32_t>& scratchKeys, std::vector<uint32_t>& scratchValues)
+{
+  static const int BITS = 11;
+  static const uint32_t BUCKETS = 1 << BITS;
+
+  size_t count = keys.size();
+  scratchKeys.resize(count);
+  scratchValues.resize(count);
+
+  for (int shift = 0; shift < 32 && (maxKey >> shift) != 0; shift += BITS)
+  {
+    uint32_t buckets[BUCKETS] = {};
+    for (size_t i = 0; i < count; i++)
+      buckets[(keys[i] >> shift) & (BUCKETS - 1)]++;
+
+    uint32_t offset = 0;
+    for (uint32_t b = 0; b < BUCKETS; b++)
+    {
+      uint32_t size = buckets[b];
+      buckets[b] = offset;
+      offset += size;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+      uint32_t slot = buckets[(keys[i] >> shift) & (BUCKETS - 1)]++;
+      scratchKeys[slot] = keys[i];
+      scratchValues[slot] = values[i];
+    }
+    keys.swap(scratchKeys);
+    values.swap(scratchValues);
+  }
+}
+
+void CollisionWorld::beginScan(size_t entities)
+{
+  scans.resize((entities + COLLISION_SCAN_BATCH - 1) / COLLISION_SCAN_BATCH);
+}
+
+void CollisionWorld::scanBodies(const EntityStore& world, size_t begin, size_t end)
+{
+  const float* radius = world.radius.data();
+
+  for (size_t s = begin / COLLISION_SCAN_BATCH; s * COLLISION_SCAN_BATCH < end; s++)
+  {
+    ScanSlot& slot = scans[s];
+    slot.bodies.clear();
+    slot.maxRadius = 0;
+
+    size_t last = std::min(end, (s + 1) * COLLISION_SCAN_BATCH);
+    for (size_t i = s * COLLISION_SCAN_BATCH; i < last; i++)
+    {
+      if (radius[i] <= 0)
+        continue;
+      slot.bodies.push_back((uint32_t) i);
+      slot.maxRadius = std::max(slot.maxRadius, radius[i]);
+    }
+  }
+}
+
+void CollisionWorld::buildGrid(const EntityStore& world)
+{
+  const float* x = world.x.data();
+  const float* y = world.y.data();
+  const float* radius = world.radius.data();
+
+  // Slots in order, so bodies come out in entity order however the scan
+  // was split
+  size_t count = 0;
+  float maxRadius = 0;
+  for (const ScanSlot& slot : scans)
+  {
+    count += slot.bodies.size();
+    maxRadius = std::max(maxRadius, slot.maxRadius);
+  }
+
+  bodies.clear();
+  for (const ScanSlot& slot : scans)
+    bodies.insert(bodies.end(), slot.bodies.begin(), slot.bodies.end());
+
+  // Cells one diameter of the biggest body wide, so no body spans more than
+  // its own cell and the neighbours
+  float inverseCell = maxRadius > 0 ? 1.0f / (2.0f * maxRadius) : 1.0f;
+
+  // Cell coordinates first, the grid only covers the cells in use
+  keys.resize(count);
+  cellX.resize(count);
+  cellY.resize(count);
+  int32_t minX = INT32_MAX, minY = INT32_MAX, maxX = INT32_MIN, maxY = INT32_MIN;
+  for (size_t i = 0; i < count; i++)
+  {
+    int32_t cx = cellCoordinate(x[bodies[i]], inverseCell);
+    int32_t cy = cellCoordinate(y[bodies[i]], inverseCell);
+    minX = std::min(minX, cx);
+    maxX = std::max(maxX, cx);
+    minY = std::min(minY, cy);
+    maxY = std::max(maxY, cy);
+    cellX[i] = cx;
+    cellY[i] = cy;
+  }
+
+  maxX = (int32_t) std::min<int64_t>(maxX, (int64_t) minX + GRID_MAX_CELLS - 1);
+  maxY = (int32_t) std::min<int64_t>(maxY, (int64_t) minY + GRID_MAX_CELLS - 1);
+  rowStride = count ? (uint32_t) (maxX - minX + 1) : 1;
+  for (size_t i = 0; i < count; i++)
+  {
+    uint32_t cx = (uint32_t) (std::min(cellX[i], maxX) - minX);
+    uint32_t cy = (uint32_t) (std::min(cellY[i], maxY) - minY);
+    keys[i] = cy * rowStride + cx;
+  }
+
+  uint32_t maxKey = count ? (uint32_t) (maxY - minY) * rowStride + (uint32_t) (maxX - minX) : 0;
+  radixSort(keys, bodies, maxKey, scratchKeys, scratchBodies);
+
+  sortedX.resize(count);
+  sortedY.resize(count);
+  sortedRadius.resize(count);
+  cells.clear();
+  for (size_t i = 0; i < count; i++)
+  {
+    uint32_t body = bodies[i];
+    sortedX[i] = x[body];
+    sortedY[i] = y[body];
+    sortedRadius[i] = radius[body];
+
+    if (cells.empty() || cells.back().key != keys[i])
+      cells.push_back({ keys[i], (uint32_t) i, (uint32_t) i });
+    cells.back().end = (uint32_t) i + 1;
+  }
+
+  counters.bodies = count;
+  counters.cells = cells.size();
+}
+
+/*
+ * ========================================
+ * Narrow Phase
+ * ========================================
+ */
+void CollisionWorld::testCells(const Cell& first, const Cell& second)
+{
+  bool same = &first == &second;
+  size_t tested = 0;
+
+  for (uint32_t i = first.begin; i < first.end; i++)
+  {
+    float x = sortedX[i];
+    float y = sortedY[i];
+    float radius = sortedRadius[i];
+
+    uint32_t j = same ? i + 1 : second.begin;
+    tested += second.end - j;
+    for (; j < second.end; j++)
+    {
+      float dx = sortedX[j] - x;
+      float dy = sortedY[j] - y;
+      float reach = sortedRadius[j] + radius;
+
+      if (dx * dx + dy * dy < reach * reach)
+        touching.push_back({ std::min(bodies[i], bodies[j]), std::max(bodies[i], bodies[j]) });
+    }
+  }
+  counters.pairsTested += tested;
+}
+
+void CollisionWorld::detect(const EntityStore& world)
+{
+  beginScan(world.size());
+  scanBodies(world, 0, world.size());
+  detectScanned(world);
+}
+
+void CollisionWorld::detectScanned(const EntityStore& world)
+{
+  counters = CollisionStats();
+  touching.clear();
+
+  buildGrid(world);
+
+  // Cells come sorted by row then column, so the row above is always found
+  // by moving one cursor forward. Neighbours come from the cell's column:
+  // on grids one or two cells wide, key + 1 and key + rowStride +- 1 can be
+  // the next row, or this cell, rather than a neighbour.
+  size_t above = 0;
+  for (size_t c = 0; c < cells.size(); c++)
+  {
+    const Cell& cell = cells[c];
+    uint32_t column = cell.key % rowStride;
+    bool left = column > 0;
+    bool right = column + 1 < rowStride;
+    testCells(cell, cell);
+
+    if (right && c + 1 < cells.size() && cells[c + 1].key == cell.key + 1)
+      testCells(cell, cells[c + 1]);
+
+    uint64_t first = (uint64_t) cell.key + rowStride - (left ? 1 : 0);
+    uint64_t last = (uint64_t) cell.key + rowStride + (right ? 1 : 0);
+    while (above < cells.size() && cells[above].key < first)
+      above++;
+    for (size_t k = above; k < cells.size() && cells[k].key <= last; k++)
+      testCells(cell, cells[k]);
+  }
+
+  findStarted(world);
+
+  counters.contacts = touching.size();
+  counters.started = began.size();
+}
+
+/*
+ * Contacts are remembered by slot pair, dense indices move around. Last
+ * tick's pairs sit in an open addressing hash set, rebuilt every tick.
+ */
+static const uint64_t EMPTY_PAIR = ~0ull;
+
+// Fibonacci hashing, the top bits of the product are the well mixed ones
+static inline size_t hashPair(uint64_t key, int bits)
+{
+  return (size_t) ((key * 0x9E3779B97F4A7C15ull) >> (64 - bits));
+}
+
+void CollisionWorld::findStarted(const EntityStore& world)
+{
+  began.clear();
+
+  // Load factor at most a half
+  int bits = 4;
+  while (((size_t) 1 << bits) < touching.size() * 2)
+    bits++;
+  current.assign((size_t) 1 << bits, EMPTY_PAIR);
+  size_t mask = current.size() - 1;
+
+  for (const ContactPair& contact : touching)
+  {
+    uint64_t a = world.handle(contact.a).slot;
+    uint64_t b = world.handle(contact.b).slot;
+    uint64_t key = std::min(a, b) << 32 | std::max(a, b);
+
+    size_t i = hashPair(key, bits);
+    while (current[i] != EMPTY_PAIR)
+      i = (i + 1) & mask;
+    current[i] = key;
+
+    bool seen = false;
+    if (!previous.empty())
+    {
+      size_t previousMask = previous.size() - 1;
+      for (size_t j = hashPair(key, previousBits); previous[j] != EMPTY_PAIR; j = (j + 1) & previousMask)
+      {
+        if (previous[j] == key)
+        {
+          seen = true;
+          break;
+        }
+      }
+    }
+    if (!seen)
+      began.push_back(contact);
+  }
+
+  previous.swap(current);
+  previousBits = bits;
+}
+
+/*
+ * ========================================
+ * Damage
+ * ========================================
+ */
+void damageSystem(EntityStore& world, const std::vector<ContactPair>& started)
+{
+  for (const ContactPair& contact : started)
+  {
+    world.health[contact.a] = std::max(0, world.health[contact.a] - SimConstants::COLLISION_DAMAGE);
+    world.health[contact.b] = std::max(0, world.health[contact.b] - SimConstants::COLLISION_DAMAGE);
+  }
+}
@@ -0,0 +1,110 @@
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include "entities.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * ========================================
+ * Collision
+ * ========================================
+ * Bodies are the entities with a radius, tested as circles in the XY plane
+ * they move in.
+ *
+ * Broad phase: every tick each body is binned into a uniform grid of cells
+ * one diameter of the biggest body wide, and the (cell, body) pairs are
+ * radix sorted so each cell's bodies sit next to each other. A body can then
+ * only touch bodies in its own cell or the 8 around it; walking the cells
+ * in sorted order only the right and upper neighbours need checking.
+ *
+ * Narrow phase: circle against circle on the candidate pairs.
+ */
+// Entities per scan slot, see CollisionWorld::scanBodies
+static const size_t COLLISION_SCAN_BATCH = 16384;
+
+struct ContactPair
+{
+  // Dense indices into the EntityStore, valid until it changes
+  uint32_t a;
+  uint32_t b;
+};
+
+struct CollisionStats
+{
+  size_t bodies = 0;
+  size_t cells = 0;
+  size_t pairsTested = 0;
+  size_t contacts = 0;
+  size_t started = 0;
+};
+
+class CollisionWorld
+{
+public:
+  // Rebuilds the grid and finds every overlapping pair
+  void detect(const EntityStore& world);
+
+  // detect() in steps, so the pass over every entity looking for bodies can
+  // be split across threads. beginScan, then scanBodies on every range of
+  // whole COLLISION_SCAN_BATCH slots, in any order and on any thread, then
+  // detectScanned. Only radii are read until detectScanned.
+  void beginScan(size_t entities);
+  void scanBodies(const EntityStore& world, size_t begin, size_t end);
+  void detectScanned(const EntityStore& world);
+
+  // Every pair touching this tick
+  const std::vector<ContactPair>& contacts() const { return touching; }
+  // Pairs that weren't touching last tick
+  const std::vector<ContactPair>& started() const { return began; }
+  const CollisionStats& stats() const { return counters; }
+
+private:
+  struct Cell
+  {
+    uint32_t key;
+    uint32_t begin;
+    uint32_t end;
+  };
+
+  // Bodies found in one slot of entities
+  struct ScanSlot
+  {
+    std::vector<uint32_t> bodies;
+    float maxRadius = 0;
+  };
+
+  void buildGrid(const EntityStore& world);
+  void testCells(const Cell& first, const Cell& second);
+  void findStarted(const EntityStore& world);
+
+  std::vector<ScanSlot> scans;
+  // Broad phase, bodies sorted by cell
+  std::vector<uint32_t> keys;
+  std::vector<uint32_t> bodies;
+  std::vector<uint32_t> scratchKeys;
+  std::vector<uint32_t> scratchBodies;
+  std::vector<int32_t> cellX;
+  std::vector<int32_t> cellY;
+  std::vector<Cell> cells;
+  uint32_t rowStride = 1;
+  // Body data gathered into sorted order for the narrow phase
+  std::vector<float> sortedX;
+  std::vector<float> sortedY;
+  std::vector<float> sortedRadius;
+
+  std::vector<ContactPair> touching;
+  std::vector<ContactPair> began;
+  // Slot pairs touching last tick, hash set
+  std::vector<uint64_t> previous;
+  std::vector<uint64_t> current;
+  int previousBits = 0;
+
+  CollisionStats counters;
+};
+
+// Both entities of every contact that just started lose health
+void damageSystem(EntityStore& world, const std::vector<ContactPair>& started);
+
+#endif
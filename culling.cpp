@@ -0,0 +1,261 @@
+#include "culling.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CULLING_X86 1
+#include <immintrin.h>
+#endif
+
+/*
+ * ========================================
+ * View
+ * ========================================
+ */
+CullView makeCullView(const float* viewProjection, float pixelScale, const float* lodPixels, int lodCount)
+{
+  // Gribb and Hartmann: each plane is the w row plus or minus another row
+  const float* m = viewProjection;
+  float rows[4][4];
+  for (int r = 0; r < 4; r++)
+  {
+    for (int c = 0; c < 4; c++)
+      rows[r][c] = m[c * 4 + r];
+  }
+
+  CullView view = {};
+  for (int p = 0; p < 6; p++)
+  {
+    const float* row = rows[p / 2];
+    float sign = p % 2 == 0 ? 1.0f : -1.0f;
+    float plane[4];
+    for (int c = 0; c < 4; c++)
+      plane[c] = rows[3][c] + sign * row[c];
+
+    float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+    for (int c = 0; c < 4; c++)
+      view.planes[p][c] = length > 0 ? plane[c] / length : plane[c];
+  }
+
+  for (int c = 0; c < 4; c++)
+    view.w[c] = rows[3][c];
+  view.pixelScale = pixelScale;
+  for (int k = 0; k + 1 < lodCount && k + 1 < CULL_MAX_LODS; k++)
+    view.lodPixels[k] = lodPixels[k];
+  return view;
+}
+
+size_t VisibleSet::visible() const
+{
+  size_t total = 0;
+  for (const std::vector<uint32_t>& lod : lods)
+    total += lod.size();
+  return total;
+}
+
+/*
+ * ========================================
+ * Scalar
+ * ========================================
+ * Every level does the same float operations in the same order, so a
+ * sphere right on a plane lands the same way whichever runs.
+ */
+// Where the next index of each LOD goes
+struct CullOutput
+{
+  uint32_t* lists[CULL_MAX_LODS];
+  size_t counts[CULL_MAX_LODS];
+};
+
+// Plane offsets with the radius folded in, and what a sphere of this
+// radius projects to at w = 1
+struct CullSphere
+{
+  float reach[6];
+  float size;
+  int thresholds;
+};
+
+static void cullScalar(const CullView& view, const CullSphere& sphere, const float* x, const float* y,
+                       size_t begin, size_t count, CullOutput& out)
+{
+  for (size_t i = begin; i < count; i++)
+  {
+    bool inside = true;
+    for (int p = 0; p < 6; p++)
+      inside &= view.planes[p][0] * x[i] + view.planes[p][1] * y[i] + sphere.reach[p] >= 0;
+    if (!inside)
+      continue;
+
+    // Smaller on screen than a threshold is one LOD further down. Compared
+    // as size < pixels * w so there's no divide.
+    float w = view.w[0] * x[i] + view.w[1] * y[i] + view.w[3];
+    int lod = 0;
+    for (int k = 0; k < sphere.thresholds; k++)
+      lod += sphere.size < view.lodPixels[k] * w;
+
+    out.lists[lod][out.counts[lod]++] = (uint32_t) i;
+  }
+}
+
+#ifdef CULLING_X86
+/*
+ * ========================================
+ * SSE2
+ * ========================================
+ * Baseline on x86-64, no dispatch needed.
+ */
+static void cullSse2(const CullView& view, const CullSphere& sphere, const float* x, const float* y,
+                     size_t count, CullOutput& out)
+{
+  __m128 a[6], b[6], reach[6];
+  for (int p = 0; p < 6; p++)
+  {
+    a[p] = _mm_set1_ps(view.planes[p][0]);
+    b[p] = _mm_set1_ps(view.planes[p][1]);
+    reach[p] = _mm_set1_ps(sphere.reach[p]);
+  }
+  const __m128 wx = _mm_set1_ps(view.w[0]), wy = _mm_set1_ps(view.w[1]), wd = _mm_set1_ps(view.w[3]);
+  const __m128 size = _mm_set1_ps(sphere.size);
+  const __m128 zero = _mm_setzero_ps();
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    __m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i);
+    __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], px), _mm_mul_ps(b[0], py)), reach[0]), zero);
+    for (int p = 1; p < 6; p++)
+    {
+      __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[p], px), _mm_mul_ps(b[p], py)), reach[p]);
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+    }
+
+    int mask = _mm_movemask_ps(inside);
+    if (!mask)
+      continue;
+
+    // Each failed threshold is all ones, -1, so subtracting counts them
+    __m128 w = _mm_add_ps(_mm_add_ps(_mm_mul_ps(wx, px), _mm_mul_ps(wy, py)), wd);
+    __m128i lods = _mm_setzero_si128();
+    for (int k = 0; k < sphere.thresholds; k++)
+    {
+      __m128 smaller = _mm_cmplt_ps(size, _mm_mul_ps(_mm_set1_ps(view.lodPixels[k]), w));
+      lods = _mm_sub_epi32(lods, _mm_castps_si128(smaller));
+    }
+
+    alignas(16) int32_t lod[4];
+    _mm_store_si128((__m128i*) lod, lods);
+    for (; mask; mask &= mask - 1)
+    {
+      int lane = __builtin_ctz(mask);
+      out.lists[lod[lane]][out.counts[lod[lane]]++] = (uint32_t) (i + lane);
+    }
+  }
+
+  cullScalar(view, sphere, x, y, i, count, out);
+}
+
+/*
+ * ========================================
+ * AVX2
+ * ========================================
+ * Compiled for AVX2 here only, picked at runtime. No FMA, so the results
+ * match the other levels to the bit.
+ */
+#define CULL_AVX2_TARGET __attribute__((target("avx2")))
+
+CULL_AVX2_TARGET static void cullAvx2(const CullView& view, const CullSphere& sphere, const float* x,
+                                      const float* y, size_t count, CullOutput& out)
+{
+  __m256 a[6], b[6], reach[6];
+  for (int p = 0; p < 6; p++)
+  {
+    a[p] = _mm256_set1_ps(view.planes[p][0]);
+    b[p] = _mm256_set1_ps(view.planes[p][1]);
+    reach[p] = _mm256_set1_ps(sphere.reach[p]);
+  }
+  const __m256 wx = _mm256_set1_ps(view.w[0]), wy = _mm256_set1_ps(view.w[1]), wd = _mm256_set1_ps(view.w[3]);
+  const __m256 size = _mm256_set1_ps(sphere.size);
+  const __m256 zero = _mm256_setzero_ps();
+
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    __m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i);
+    __m256 inside = _mm256_cmp_ps(
+      _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a[0], px), _mm256_mul_ps(b[0], py)), reach[0]), zero, _CMP_GE_OQ);
+    for (int p = 1; p < 6; p++)
+    {
+      __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a[p], px), _mm256_mul_ps(b[p], py)), reach[p]);
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_GE_OQ));
+    }
+
+    int mask = _mm256_movemask_ps(inside);
+    if (!mask)
+      continue;
+
+    __m256 w = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(wx, px), _mm256_mul_ps(wy, py)), wd);
+    __m256i lods = _mm256_setzero_si256();
+    for (int k = 0; k < sphere.thresholds; k++)
+    {
+      __m256 smaller = _mm256_cmp_ps(size, _mm256_mul_ps(_mm256_set1_ps(view.lodPixels[k]), w), _CMP_LT_OQ);
+      lods = _mm256_sub_epi32(lods, _mm256_castps_si256(smaller));
+    }
+
+    alignas(32) int32_t lod[8];
+    _mm256_store_si256((__m256i*) lod, lods);
+    for (; mask; mask &= mask - 1)
+    {
+      int lane = __builtin_ctz(mask);
+      out.lists[lod[lane]][out.counts[lod[lane]]++] = (uint32_t) (i + lane);
+    }
+  }
+
+  cullScalar(view, sphere, x, y, i, count, out);
+}
+#endif
+
+/*
+ * ========================================
+ * Dispatch
+ * ========================================
+ */
+void cullSpheres(const CullView& view, const float* x, const float* y, size_t count, float radius,
+                 int lodCount, VisibleSet& out)
+{
+  cullSpheres(simdLevel(), view, x, y, count, radius, lodCount, out);
+}
+
+void cullSpheres(SimdLevel level, const CullView& view, const float* x, const float* y, size_t count,
+                 float radius, int lodCount, VisibleSet& out)
+{
+  if ((int) level > (int) simdLevel())
+    level = SimdLevel::SCALAR;
+
+  CullSphere sphere;
+  for (int p = 0; p < 6; p++)
+    sphere.reach[p] = view.planes[p][3] + radius;
+  sphere.size = radius * view.pixelScale;
+  sphere.thresholds = std::max(0, std::min(lodCount, CULL_MAX_LODS) - 1);
+
+  // Room for everyone in any list, trimmed after
+  CullOutput output;
+  for (int k = 0; k < CULL_MAX_LODS; k++)
+  {
+    out.lods[k].resize(k <= sphere.thresholds ? count : 0);
+    output.lists[k] = out.lods[k].data();
+    output.counts[k] = 0;
+  }
+
+#ifdef CULLING_X86
+  if (level == SimdLevel::AVX2)
+    cullAvx2(view, sphere, x, y, count, output);
+  else if (level == SimdLevel::SSE2)
+    cullSse2(view, sphere, x, y, count, output);
+  else
+#endif
+    cullScalar(view, sphere, x, y, 0, count, output);
+
+  for (int k = 0; k < CULL_MAX_LODS; k++)
+    out.lods[k].resize(output.counts[k]);
+}
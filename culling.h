@@ -0,0 +1,53 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include "transforms.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * ========================================
+ * Visibility
+ * ========================================
+ * Frustum culling and LOD picking for a whole batch of entities at once,
+ * straight from their SoA positions. Entities are bounding spheres on the
+ * z = 0 plane, where the game keeps them all, tested 4 or 8 at a time
+ * against the six planes of the view-projection matrix. Whatever survives
+ * is sorted into a LOD by the radius it comes out at on screen.
+ */
+static const int CULL_MAX_LODS = 4;
+
+struct CullView
+{
+  float planes[6][4]; // a, b, c, d with the normal pointing in, unit length
+  float w[4];         // The clip space w row, distance along the view axis
+  float pixelScale;   // Pixels across per unit of radius at w = 1
+  // Projected radius in pixels a sphere needs for each LOD but the last,
+  // from the most detailed down
+  float lodPixels[CULL_MAX_LODS - 1];
+};
+
+// viewProjection is column-major, glm's layout. pixelScale is
+// projection[1][1] * viewport height / 2. lodPixels holds lodCount - 1
+// descending thresholds.
+CullView makeCullView(const float* viewProjection, float pixelScale, const float* lodPixels, int lodCount);
+
+// Indices of the visible entities, one list per LOD
+struct VisibleSet
+{
+  std::vector<uint32_t> lods[CULL_MAX_LODS];
+
+  size_t visible() const;
+};
+
+// Every entity is a sphere of radius at (x, y, 0). out is refilled, lists
+// past lodCount stay empty.
+void cullSpheres(const CullView& view, const float* x, const float* y, size_t count, float radius,
+                 int lodCount, VisibleSet& out);
+// Forces one implementation, for benchmarks. Every level gives the same
+// lists in the same order.
+void cullSpheres(SimdLevel level, const CullView& view, const float* x, const float* y, size_t count,
+                 float radius, int lodCount, VisibleSet& out);
+
+#endif
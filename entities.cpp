@@ -0,0 +1,222 @@
+#include "entities.h"
+#include "simulation.h"
+#include <cstring>
+
+/*
+ * ========================================
+ * Entity Store
+ * ========================================
+ */
+EntityStore::EntityStore()
+  : count(0), capacity(0)
+{
+}
+
+void EntityStore::reserve(size_t newCapacity)
+{
+  if (newCapacity <= capacity)
+    return;
+
+  x.reserve(newCapacity, count);
+  y.reserve(newCapacity, count);
+  tiltX.reserve(newCapacity, count);
+  tiltY.reserve(newCapacity, count);
+  prevX.reserve(newCapacity, count);
+  prevY.reserve(newCapacity, count);
+  prevTiltX.reserve(newCapacity, count);
+  prevTiltY.reserve(newCapacity, count);
+  velX.reserve(newCapacity, count);
+  velY.reserve(newCapacity, count);
+  steer.reserve(newCapacity, count);
+  radius.reserve(newCapacity, count);
+  health.reserve(newCapacity, count);
+  mesh.reserve(newCapacity, count);
+  owner.reserve(newCapacity, count);
+
+  capacity = newCapacity;
+}
+
+EntityHandle EntityStore::create(float px, float py, uint16_t meshId)
+{
+  if (count == capacity)
+    reserve(capacity < 64 ? 64 : capacity * 2);
+
+  EntityHandle handle;
+  if (!freeSlots.empty())
+  {
+    handle.slot = freeSlots.back();
+    freeSlots.pop_back();
+  }
+  else
+  {
+    handle.slot = (uint32_t) slotIndex.size();
+    slotIndex.push_back(0);
+    slotGeneration.push_back(0);
+  }
+  handle.generation = slotGeneration[handle.slot];
+
+  size_t i = count++;
+  slotIndex[handle.slot] = (uint32_t) i;
+  owner[i] = handle.slot;
+
+  x[i] = prevX[i] = px;
+  y[i] = prevY[i] = py;
+  tiltX[i] = prevTiltX[i] = 0;
+  tiltY[i] = prevTiltY[i] = 0;
+  velX[i] = 0;
+  velY[i] = 0;
+  steer[i] = 0;
+  radius[i] = 0;
+  health[i] = 100;
+  mesh[i] = meshId;
+
+  return handle;
+}
+
+bool EntityStore::destroy(EntityHandle handle)
+{
+  long found = find(handle);
+  if (found < 0)
+    return false;
+
+  // Move the last entity into the hole so the arrays stay packed
+  size_t i = (size_t) found;
+  size_t last = --count;
+  if (i != last)
+  {
+    x[i] = x[last];
+    y[i] = y[last];
+    tiltX[i] = tiltX[last];
+    tiltY[i] = tiltY[last];
+    prevX[i] = prevX[last];
+    prevY[i] = prevY[last];
+    prevTiltX[i] = prevTiltX[last];
+    prevTiltY[i] = prevTiltY[last];
+    velX[i] = velX[last];
+    velY[i] = velY[last];
+    steer[i] = steer[last];
+    radius[i] = radius[last];
+    health[i] = health[last];
+    mesh[i] = mesh[last];
+    owner[i] = owner[last];
+    slotIndex[owner[i]] = (uint32_t) i;
+  }
+
+  // Bumping the generation makes every outstanding handle stale
+  slotGeneration[handle.slot]++;
+  freeSlots.push_back(handle.slot);
+  return true;
+}
+
+long EntityStore::find(EntityHandle handle) const
+{
+  if (handle.slot >= slotGeneration.size() || slotGeneration[handle.slot] != handle.generation)
+    return -1;
+  return (long) slotIndex[handle.slot];
+}
+
+EntityHandle EntityStore::handle(size_t i) const
+{
+  EntityHandle handle;
+  handle.slot = owner[i];
+  handle.generation = slotGeneration[handle.slot];
+  return handle;
+}
+
+void EntityStore::clear()
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    slotGeneration[owner[i]]++;
+    freeSlots.push_back(owner[i]);
+  }
+  count = 0;
+}
+
+/*
+ * ========================================
+ * Systems
+ * ========================================
+ */
+void snapshotSystem(EntityStore& store)
+{
+  snapshotSystem(store, 0, store.size());
+}
+
+void snapshotSystem(EntityStore& store, size_t begin, size_t end)
+{
+  size_t n = end - begin;
+  std::memcpy(store.prevX.data() + begin, store.x.data() + begin, sizeof(float) * n);
+  std::memcpy(store.prevY.data() + begin, store.y.data() + begin, sizeof(float) * n);
+  std::memcpy(store.prevTiltX.data() + begin, store.tiltX.data() + begin, sizeof(float) * n);
+  std::memcpy(store.prevTiltY.data() + begin, store.tiltY.data() + begin, sizeof(float) * n);
+}
+
+// Tilt towards the pressed direction, or settle back to level. Written as
+// selects rather than branches so the loop over all entities vectorizes,
+// random steering would mispredict every other branch anyway.
+static inline float tilt(float angle, float positive, float negative, float speed, float returnSpeed)
+{
+  float settled = angle > SimConstants::TILT_SNAP ? angle - returnSpeed : 0.0f;
+  settled = angle < -SimConstants::TILT_SNAP ? angle + returnSpeed : settled;
+
+  float raise = angle < 0 ? returnSpeed : speed;
+  angle = (positive > 0) & (angle < SimConstants::TILT_LIMIT) ? angle + raise : angle;
+  float lower = angle > 0 ? returnSpeed : speed;
+  angle = (negative > 0) & (angle > -SimConstants::TILT_LIMIT) ? angle - lower : angle;
+
+  return positive + negative > 0 ? angle : settled;
+}
+
+void steeringSystem(EntityStore& store, float dt)
+{
+  steeringSystem(store, dt, 0, store.size());
+}
+
+void steeringSystem(EntityStore& store, float dt, size_t begin, size_t end)
+{
+  const float move = SimConstants::MOVE_SPEED * dt;
+  const float speed = SimConstants::TILT_SPEED * dt;
+  const float returnSpeed = SimConstants::RETURN_SPEED * dt;
+
+  float* x = store.x.data();
+  float* tiltX = store.tiltX.data();
+  float* tiltY = store.tiltY.data();
+  const uint8_t* steer = store.steer.data();
+
+  for (size_t i = begin; i < end; i++)
+  {
+    // Flags as floats, the vectorizer can't widen bools next to float lanes
+    float left = (float) (steer[i] & STEER_LEFT);
+    float right = (float) (steer[i] & STEER_RIGHT);
+    float up = (float) (steer[i] & STEER_UP);
+    float down = (float) (steer[i] & STEER_DOWN);
+
+    float px = x[i];
+    px = (left > 0) & (px > -SimConstants::X_LIMIT) ? px - move : px;
+    px = (right > 0) & (px < SimConstants::X_LIMIT) ? px + move : px;
+    x[i] = px;
+
+    tiltX[i] = tilt(tiltX[i], left, right, speed, returnSpeed);
+    tiltY[i] = tilt(tiltY[i], up, down, speed, returnSpeed);
+  }
+}
+
+void movementSystem(EntityStore& store, float dt)
+{
+  movementSystem(store, dt, 0, store.size());
+}
+
+void movementSystem(EntityStore& store, float dt, size_t begin, size_t end)
+{
+  float* x = store.x.data();
+  float* y = store.y.data();
+  const float* velX = store.velX.data();
+  const float* velY = store.velY.data();
+
+  for (size_t i = begin; i < end; i++)
+  {
+    x[i] += velX[i] * dt;
+    y[i] += velY[i] * dt;
+  }
+}
@@ -0,0 +1,141 @@
+#ifndef ENTITIES_H
+#define ENTITIES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+/*
+ * ========================================
+ * Entity Store
+ * ========================================
+ * Components live in parallel, cache-line aligned arrays indexed by a
+ * dense index in [0, size()). Systems walk them front to back. Destroying
+ * an entity moves the last one into its place, so outside code holds an
+ * EntityHandle and resolves it with find() instead of keeping indices.
+ */
+static const size_t CACHE_LINE = 64;
+
+template <typename T>
+class AlignedArray
+{
+public:
+  AlignedArray() : items(nullptr), capacity(0) {}
+  ~AlignedArray() { release(); }
+  AlignedArray(const AlignedArray&) = delete;
+  AlignedArray& operator=(const AlignedArray&) = delete;
+
+  // Keeps the first count items
+  void reserve(size_t newCapacity, size_t count)
+  {
+    if (newCapacity <= capacity)
+      return;
+    T* grown = (T*) ::operator new(sizeof(T) * newCapacity, std::align_val_t(CACHE_LINE));
+    for (size_t i = 0; i < count; i++)
+      grown[i] = items[i];
+    release();
+    items = grown;
+    capacity = newCapacity;
+  }
+
+  T* data() { return items; }
+  const T* data() const { return items; }
+  T& operator[](size_t i) { return items[i]; }
+  const T& operator[](size_t i) const { return items[i]; }
+
+private:
+  void release()
+  {
+    if (items)
+      ::operator delete(items, std::align_val_t(CACHE_LINE));
+    items = nullptr;
+  }
+
+  T* items;
+  size_t capacity;
+};
+
+struct EntityHandle
+{
+  uint32_t slot = 0xFFFFFFFF;
+  uint32_t generation = 0;
+};
+
+// Per-entity steering flags, same meaning as the player's keys
+enum SteerFlags : uint8_t
+{
+  STEER_LEFT = 1,
+  STEER_RIGHT = 2,
+  STEER_UP = 4,
+  STEER_DOWN = 8
+};
+
+class EntityStore
+{
+public:
+  EntityStore();
+
+  EntityHandle create(float x, float y, uint16_t mesh);
+  // False if the handle was already stale
+  bool destroy(EntityHandle handle);
+  // Dense index of a live entity, -1 if the handle is stale
+  long find(EntityHandle handle) const;
+  // Handle of the entity at a dense index
+  EntityHandle handle(size_t i) const;
+  void clear();
+
+  size_t size() const { return count; }
+  void reserve(size_t capacity);
+
+  /*
+   * Components, all valid for [0, size())
+   */
+  // Transform
+  AlignedArray<float> x;
+  AlignedArray<float> y;
+  AlignedArray<float> tiltX;
+  AlignedArray<float> tiltY;
+  // Last tick's transform, for render interpolation
+  AlignedArray<float> prevX;
+  AlignedArray<float> prevY;
+  AlignedArray<float> prevTiltX;
+  AlignedArray<float> prevTiltY;
+  // Motion
+  AlignedArray<float> velX;
+  AlignedArray<float> velY;
+  AlignedArray<uint8_t> steer;
+  // Gameplay
+  AlignedArray<float> radius; // Bounding sphere, 0 never collides
+  AlignedArray<int32_t> health;
+  AlignedArray<uint16_t> mesh;
+
+private:
+  AlignedArray<uint32_t> owner; // Dense index -> slot
+
+  size_t count;
+  size_t capacity;
+  std::vector<uint32_t> slotIndex; // Slot -> dense index
+  std::vector<uint32_t> slotGeneration;
+  std::vector<uint32_t> freeSlots;
+};
+
+/*
+ * ========================================
+ * Systems
+ * ========================================
+ */
+// Copies this tick's transforms into the prev* arrays
+void snapshotSystem(EntityStore& store);
+// Steering flags move and tilt entities, same rules the player always had
+void steeringSystem(EntityStore& store, float dt);
+// Integrates velocity
+void movementSystem(EntityStore& store, float dt);
+
+// The same over dense indices [begin, end). Entities don't touch each other
+// in these, so ranges can run on different threads.
+void snapshotSystem(EntityStore& store, size_t begin, size_t end);
+void steeringSystem(EntityStore& store, float dt, size_t begin, size_t end);
+void movementSystem(EntityStore& store, float dt, size_t begin, size_t end);
+
+#endif
@@ -0,0 +1,70 @@
+#include "gpuprofiler.h"
+
+/*
+ * ========================================
+ * GPU Profiler
+ * ========================================
+ */
+GpuProfiler::GpuProfiler()
+  : current(0), open(false), lost(0)
+{
+  for (Frame& frame : frames)
+  {
+    glGenQueries(GPU_PROFILE_QUERIES, frame.queries);
+    frame.used = 0;
+  }
+}
+
+GpuProfiler::~GpuProfiler()
+{
+  for (Frame& frame : frames)
+    glDeleteQueries(GPU_PROFILE_QUERIES, frame.queries);
+}
+
+void GpuProfiler::begin(const char* name)
+{
+  Frame& frame = frames[current];
+  if (!profiler.enabled() || open || frame.used == GPU_PROFILE_QUERIES)
+    return;
+
+  frame.names[frame.used] = name;
+  frame.issuedNs[frame.used] = profiler.now();
+  glBeginQuery(GL_TIME_ELAPSED, frame.queries[frame.used]);
+  open = true;
+}
+
+void GpuProfiler::end()
+{
+  if (!open)
+    return;
+
+  glEndQuery(GL_TIME_ELAPSED);
+  frames[current].used++;
+  open = false;
+}
+
+void GpuProfiler::collect(Frame& frame)
+{
+  for (int i = 0; i < frame.used; i++)
+  {
+    int available = 0;
+    glGetQueryObjectiv(frame.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+    {
+      lost++;
+      continue;
+    }
+
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &elapsed);
+    profiler.recordGpu(frame.names[i], frame.issuedNs[i], frame.issuedNs[i] + (int64_t) elapsed);
+  }
+  frame.used = 0;
+}
+
+void GpuProfiler::endFrame()
+{
+  // The pool we're about to reuse was filled GPU_PROFILE_FRAMES - 1 frames ago
+  current = (current + 1) % GPU_PROFILE_FRAMES;
+  collect(frames[current]);
+}
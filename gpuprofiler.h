@@ -0,0 +1,72 @@
+#ifndef GPUPROFILER_H
+#define GPUPROFILER_H
+
+#include <GL/glew.h>
+#include <cstdint>
+#include "profiler.h"
+
+/*
+ * ========================================
+ * GPU Profiler
+ * ========================================
+ * GL_TIME_ELAPSED queries around GPU work, feeding the profiler's GPU
+ * track. Each frame gets its own pool and a pool is only read back
+ * GPU_PROFILE_FRAMES frames later, by which time the results are almost
+ * always in. Any that aren't are dropped rather than waited for.
+ *
+ * Elapsed queries can't nest or overlap, so scopes are flat. A span is
+ * placed at the CPU time its commands were issued, the GPU runs them a
+ * little later.
+ */
+static const int GPU_PROFILE_FRAMES = 3;
+static const int GPU_PROFILE_QUERIES = 32; // Scopes per frame
+
+class GpuProfiler
+{
+public:
+  GpuProfiler();
+  ~GpuProfiler();
+
+  void begin(const char* name);
+  void end();
+  // Collects the oldest frame's results, once per frame after the last scope
+  void endFrame();
+
+  unsigned int dropped() const { return lost; }
+
+private:
+  struct Frame
+  {
+    unsigned int queries[GPU_PROFILE_QUERIES];
+    const char* names[GPU_PROFILE_QUERIES];
+    int64_t issuedNs[GPU_PROFILE_QUERIES];
+    int used;
+  };
+
+  void collect(Frame& frame);
+
+  Frame frames[GPU_PROFILE_FRAMES];
+  int current;
+  bool open; // Between begin() and end()
+  unsigned int lost;
+};
+
+class GpuProfileScope
+{
+public:
+  GpuProfileScope(GpuProfiler& gpu, const char* name)
+    : gpu(gpu)
+  {
+    gpu.begin(name);
+  }
+
+  ~GpuProfileScope()
+  {
+    gpu.end();
+  }
+
+private:
+  GpuProfiler& gpu;
+};
+
+#endif
@@ -0,0 +1,423 @@
+/*
+ * ========================================
+ * Headless Runner
+ * ========================================
+ * Runs game logic without SDL or OpenGL, for build machines with no display.
+ */
+#include "simulation.h"
+#include "replay.h"
+#include "log.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <thread>
+
+/*
+ * ========================================
+ * Checks
+ * ========================================
+ * Exit 1 on a wrong result, ctest runs them.
+ */
+// Every pair the grid finds against testing every body with every other,
+// bodies scattered over a strip this many cells wide. Grids one or two
+// cells wide are where neighbours wrap onto the next row.
+static bool checkStrip(float cells, size_t bodies)
+{
+  static const float RADIUS = 1.0f;
+  float width = cells * 2 * RADIUS;
+  // About one body in four touching another
+  float length = bodies * 16 * RADIUS * RADIUS / width;
+
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<float> across(0, width);
+  std::uniform_real_distribution<float> along(0, length);
+
+  EntityStore world;
+  world.reserve(bodies);
+  for (size_t i = 0; i < bodies; i++)
+  {
+    world.create(across(random), along(random), MESH_SHIP);
+    world.radius[i] = RADIUS;
+  }
+
+  CollisionWorld collisions;
+  collisions.detect(world);
+  std::vector<uint64_t> found;
+  for (const ContactPair& contact : collisions.contacts())
+    found.push_back((uint64_t) contact.a << 32 | contact.b);
+  std::sort(found.begin(), found.end());
+
+  std::vector<uint64_t> expected;
+  for (uint32_t a = 0; a < bodies; a++)
+  {
+    for (uint32_t b = a + 1; b < bodies; b++)
+    {
+      float dx = world.x[b] - world.x[a];
+      float dy = world.y[b] - world.y[a];
+      float reach = world.radius[a] + world.radius[b];
+      if (dx * dx + dy * dy < reach * reach)
+        expected.push_back((uint64_t) a << 32 | b);
+    }
+  }
+
+  bool same = found == expected;
+  std::cout << "strip " << cells << " cells wide: " << found.size() << " contacts, "
+            << expected.size() << " brute force, " << (same ? "same" : "DIFFERENT") << std::endl;
+  return same;
+}
+
+// Two bodies overlapping on a one cell grid take one hit each
+static bool checkPairDamage()
+{
+  EntityStore world;
+  for (int i = 0; i < 2; i++)
+  {
+    world.create(0.5f * i, 0, MESH_SHIP);
+    world.radius[i] = 1.0f;
+  }
+
+  CollisionWorld collisions;
+  collisions.detect(world);
+  damageSystem(world, collisions.started());
+
+  bool same = world.health[0] == 100 - SimConstants::COLLISION_DAMAGE &&
+              world.health[1] == 100 - SimConstants::COLLISION_DAMAGE;
+  std::cout << "overlapping pair: health " << world.health[0] << " and " << world.health[1] << ", "
+            << (same ? "same" : "DIFFERENT") << std::endl;
+  return same;
+}
+
+// The grid against brute force on narrow strips, and contact damage
+static int checkCollision()
+{
+  bool passed = checkPairDamage();
+  for (float cells : { 0.5f, 1.5f, 2.5f, 8.0f })
+    passed = checkStrip(cells, 4000) && passed;
+  return passed ? 0 : 1;
+}
+
+// The same world for every run, so they can be checked against each other
+static void populateJobs(SimState& state, size_t entities)
+{
+  std::mt19937 random(1234);
+  std::uniform_int_distribution<int> steer(0, 15);
+  std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+  std::uniform_real_distribution<float> velocity(-1.0f, 1.0f);
+
+  EntityStore& world = state.world;
+  world.reserve(entities);
+  for (size_t i = world.size(); i < entities; i++)
+  {
+    world.create(position(random), position(random), MESH_SHIP);
+    world.steer[i] = (uint8_t) steer(random);
+    world.velX[i] = velocity(random);
+    world.velY[i] = velocity(random);
+    // A few bodies so collision has real work
+    world.radius[i] = i % 100 == 0 ? 1.0f : 0.0f;
+  }
+}
+
+// Ticks big enough to be split across workers, against one thread, to the
+// bit. Four threads whatever the machine has, so the split always happens.
+static int checkJobs()
+{
+  static const size_t ENTITIES = 100000;
+  static const int TICKS = 50;
+
+  uint64_t hashes[2];
+  for (int run = 0; run < 2; run++)
+  {
+    SimState state;
+    populateJobs(state, ENTITIES);
+    JobSystem jobs(run == 0 ? 0 : 3);
+
+    SimInput input;
+    for (int tick = 0; tick < TICKS; tick++)
+    {
+      input.left = tick / 10 % 2 == 0;
+      input.right = !input.left;
+      step(state, SimConstants::DT, input, &jobs);
+    }
+    hashes[run] = hashState(state);
+  }
+
+  bool same = hashes[0] == hashes[1];
+  std::printf("%zu entities, %d ticks: 1 thread %016llx, 4 threads %016llx, %s\n", ENTITIES, TICKS,
+              (unsigned long long) hashes[0], (unsigned long long) hashes[1], same ? "same" : "DIFFERENT");
+  return same ? 0 : 1;
+}
+
+/*
+ * ========================================
+ * Benchmarks
+ * ========================================
+ */
+// Times the entity systems from 1K to 1M entities, prints ns per entity
+static int benchEntities()
+{
+  static const size_t COUNTS[] = { 1000, 10000, 100000, 1000000 };
+  // Roughly the same number of entity updates at every size
+  static const size_t UPDATES = 200000000;
+
+  std::mt19937 random(1234);
+  std::uniform_int_distribution<int> steer(0, 15);
+  std::uniform_real_distribution<float> velocity(-1.0f, 1.0f);
+
+  std::cout << "entities    ticks    ms/tick    ns/entity" << std::endl;
+
+  for (size_t count : COUNTS)
+  {
+    EntityStore world;
+    world.reserve(count);
+    for (size_t i = 0; i < count; i++)
+    {
+      world.create(0, 0, MESH_SHIP);
+      world.steer[i] = (uint8_t) steer(random);
+      world.velX[i] = velocity(random);
+      world.velY[i] = velocity(random);
+    }
+
+    size_t ticks = UPDATES / count;
+    float dt = (float) SimConstants::DT;
+
+    // Warm up, faults the pages in and settles the clocks
+    for (size_t t = 0; t < 10; t++)
+    {
+      snapshotSystem(world);
+      steeringSystem(world, dt);
+      movementSystem(world, dt);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < ticks; t++)
+    {
+      snapshotSystem(world);
+      steeringSystem(world, dt);
+      movementSystem(world, dt);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Touch the results so the loops can't be optimized away
+    float checksum = 0;
+    for (size_t i = 0; i < count; i++)
+      checksum += world.x[i] + world.tiltY[i];
+
+    std::printf("%8zu %8zu %10.3f %12.3f   (checksum %g)\n", count, ticks, seconds * 1e3 / ticks,
+                seconds * 1e9 / ((double) ticks * count), checksum);
+  }
+
+  return 0;
+}
+
+// Times collision detection on 100K moving bodies
+static int benchCollision()
+{
+  static const size_t BODIES = 100000;
+  static const int TICKS = 100;
+  static const float RADIUS = 1.0f;
+  // Roughly one body in ten touching another, a busy but sane battlefield
+  static const float SIDE = std::sqrt(BODIES * 40.0f * 3.14159f * RADIUS * RADIUS);
+
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<float> position(-SIDE / 2, SIDE / 2);
+  std::uniform_real_distribution<float> velocity(-10.0f, 10.0f);
+
+  EntityStore world;
+  world.reserve(BODIES);
+  for (size_t i = 0; i < BODIES; i++)
+  {
+    world.create(position(random), position(random), MESH_SHIP);
+    world.radius[i] = RADIUS;
+    world.velX[i] = velocity(random);
+    world.velY[i] = velocity(random);
+  }
+
+  CollisionWorld collisions;
+  collisions.detect(world);
+
+  size_t pairsTested = 0, contacts = 0, started = 0;
+  double seconds = 0;
+  for (int tick = 0; tick < TICKS; tick++)
+  {
+    movementSystem(world, (float) SimConstants::DT);
+
+    auto start = std::chrono::steady_clock::now();
+    collisions.detect(world);
+    damageSystem(world, collisions.started());
+    seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    pairsTested += collisions.stats().pairsTested;
+    contacts += collisions.stats().contacts;
+    started += collisions.stats().started;
+  }
+
+  std::cout << BODIES << " bodies, " << collisions.stats().cells << " cells: "
+            << seconds * 1e3 / TICKS << " ms/tick, "
+            << pairsTested / TICKS << " pairs tested/tick, "
+            << contacts / TICKS << " contacts/tick, "
+            << started / TICKS << " new contacts/tick" << std::endl;
+
+  return 0;
+}
+
+// Whole ticks of 1M entities on 1 thread up to every core, and batch sizes
+static int benchJobs()
+{
+  static const size_t ENTITIES = 1000000;
+  static const int TICKS = 100;
+  static const size_t BATCHES[] = { 256, 1024, 4096, 16384, 65536 };
+
+  unsigned int cores = std::max(std::thread::hardware_concurrency(), 1u);
+  std::vector<unsigned int> threadCounts;
+  for (unsigned int threads = 1; threads < cores; threads *= 2)
+    threadCounts.push_back(threads);
+  threadCounts.push_back(cores);
+
+  std::printf("%zu entities, %d ticks, %u cores\n", ENTITIES, TICKS, cores);
+  std::printf("threads    ms/tick    speedup    state\n");
+
+  bool passed = true;
+  double serialMs = 0;
+  uint64_t serialHash = 0;
+  for (unsigned int threads : threadCounts)
+  {
+    SimState state;
+    populateJobs(state, ENTITIES);
+    JobSystem jobs(threads - 1);
+
+    SimInput input;
+    auto start = std::chrono::steady_clock::now();
+    for (int tick = 0; tick < TICKS; tick++)
+    {
+      input.left = tick / 20 % 2 == 0;
+      input.right = !input.left;
+      step(state, SimConstants::DT, input, &jobs);
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / TICKS;
+
+    // Splitting the work mustn't change the result
+    uint64_t hash = hashState(state);
+    if (threads == 1)
+    {
+      serialMs = ms;
+      serialHash = hash;
+    }
+    bool same = hash == serialHash;
+    passed = passed && same;
+
+    std::printf("%7u %10.3f %9.2fx    %s\n", threads, ms, serialMs / ms, same ? "same" : "DIFFERENT");
+  }
+
+  // Just the entity systems on every core, one batch size at a time
+  std::printf("\nbatch      ms/tick    (entity systems, %u threads)\n", cores);
+  SimState state;
+  populateJobs(state, ENTITIES);
+  JobSystem jobs(cores - 1);
+  EntityStore& world = state.world;
+  float dt = (float) SimConstants::DT;
+  for (size_t batch : BATCHES)
+  {
+    auto start = std::chrono::steady_clock::now();
+    for (int tick = 0; tick < TICKS; tick++)
+    {
+      jobs.parallelFor("entity systems", world.size(), batch, [&](size_t begin, size_t end)
+      {
+        snapshotSystem(world, begin, end);
+        steeringSystem(world, dt, begin, end);
+        movementSystem(world, dt, begin, end);
+      });
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / TICKS;
+    std::printf("%7zu %10.3f\n", batch, ms);
+  }
+
+  return passed ? 0 : 1;
+}
+
+// Tick times with a log line every tick, printf against the async logger.
+// The lines go to stdout, the results to stderr.
+static int benchLogging()
+{
+  static const int TICKS = 20000;
+  static const char* MODES[] = { "printf", "LOG", "LOG_EVERY(1000)" };
+
+  logger.setLevel(LogLevel::DEBUG);
+
+  for (int mode = 0; mode < 3; mode++)
+  {
+    SimState state;
+    SimInput input;
+    double totalMs = 0, worstMs = 0;
+
+    for (int tick = 0; tick < TICKS; tick++)
+    {
+      auto start = std::chrono::steady_clock::now();
+      step(state, SimConstants::DT, input);
+
+      // What update() used to do every tick, and what it does now
+      const SimLight& light = state.light;
+      if (mode == 0)
+      {
+        std::printf("light pos %f, %f, %f\n", light.x, light.y, light.z);
+        std::fflush(stdout);
+      }
+      else if (mode == 1)
+      {
+        LOG(DEBUG, LOG_SIM, "light pos %f, %f, %f", light.x, light.y, light.z);
+      }
+      else
+      {
+        LOG_EVERY(1000, DEBUG, LOG_SIM, "light pos %f, %f, %f", light.x, light.y, light.z);
+      }
+
+      double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      totalMs += ms;
+      worstMs = std::max(worstMs, ms);
+    }
+    logger.flush();
+
+    std::fprintf(stderr, "%-16s %8.3f us/tick, worst %8.3f us\n", MODES[mode], totalMs * 1e3 / TICKS,
+                 worstMs * 1e3);
+  }
+
+  LogStats stats = logger.stats();
+  std::fprintf(stderr, "logger: %llu written in %llu batches, %llu dropped, %llu suppressed\n", stats.written,
+               stats.batches, stats.dropped, stats.suppressed);
+  return 0;
+}
+
+static void usage()
+{
+  std::cout << "usage: astro_headless --simulate N | --bench-entities | --bench-collision | --check-collision | --bench-jobs | --check-jobs | --bench-logging | --replay FILE" << std::endl;
+}
+
+int main(int argc, char* args[])
+{
+  for (int i = 1; i < argc; i++)
+  {
+    if (std::strcmp(args[i], "--simulate") == 0 && i + 1 < argc)
+      return simulateHeadless(std::strtoull(args[++i], nullptr, 10));
+    if (std::strcmp(args[i], "--replay") == 0 && i + 1 < argc)
+      return replayHeadless(args[++i]);
+    if (std::strcmp(args[i], "--bench-entities") == 0)
+      return benchEntities();
+    if (std::strcmp(args[i], "--bench-collision") == 0)
+      return benchCollision();
+    if (std::strcmp(args[i], "--check-collision") == 0)
+      return checkCollision();
+    if (std::strcmp(args[i], "--bench-jobs") == 0)
+      return benchJobs();
+    if (std::strcmp(args[i], "--check-jobs") == 0)
+      return checkJobs();
+    if (std::strcmp(args[i], "--bench-logging") == 0)
+      return benchLogging();
+  }
+
+  usage();
+  return 1;
+}
@@ -0,0 +1,281 @@
+#include "jobs.h"
+#include "profiler.h"
+#include <algorithm>
+
+// Steal attempts with nothing found before a worker goes to sleep
+static const int IDLE_SPINS = 2000;
+
+/*
+ * ========================================
+ * Task Graph
+ * ========================================
+ */
+TaskId TaskGraph::add(const char* name, std::function<void()> work)
+{
+  return add(name, 1, 1, [work](size_t, size_t) { work(); });
+}
+
+TaskId TaskGraph::add(const char* name, size_t count, size_t batchSize, std::function<void(size_t, size_t)> work)
+{
+  tasks.emplace_back();
+  Task& task = tasks.back();
+  task.name = name;
+  task.count = count;
+  task.batchSize = std::max<size_t>(batchSize, 1);
+  task.work = std::move(work);
+  return (TaskId) tasks.size() - 1;
+}
+
+void TaskGraph::depend(TaskId task, TaskId on)
+{
+  tasks[on].dependents.push_back(&tasks[task]);
+  tasks[task].dependencies++;
+}
+
+/*
+ * ========================================
+ * Deque
+ * ========================================
+ * Lê, Pop, Cohen and Zappa Nardelli, "Correct and Efficient Work-Stealing
+ * for Weak Memory Models", without the growing. A full deque refuses the
+ * push and the owner runs the work itself.
+ *
+ * A thief copies the job out before claiming it. If the owner reused the
+ * slot in between, the claim fails and the copy is thrown away.
+ */
+bool JobSystem::Deque::push(const Job& job)
+{
+  int64_t b = bottom.load(std::memory_order_relaxed);
+  int64_t t = top.load(std::memory_order_acquire);
+  if (b - t >= (int64_t) JOB_DEQUE_SIZE)
+    return false;
+
+  jobs[b & (JOB_DEQUE_SIZE - 1)] = job;
+  std::atomic_thread_fence(std::memory_order_release);
+  bottom.store(b + 1, std::memory_order_relaxed);
+  return true;
+}
+
+bool JobSystem::Deque::pop(Job& job)
+{
+  int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+  bottom.store(b, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t t = top.load(std::memory_order_relaxed);
+
+  if (t > b)
+  {
+    // Empty
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return false;
+  }
+
+  job = jobs[b & (JOB_DEQUE_SIZE - 1)];
+  if (t == b)
+  {
+    // The last one, race the thieves for it
+    bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return won;
+  }
+  return true;
+}
+
+bool JobSystem::Deque::steal(Job& job)
+{
+  int64_t t = top.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t b = bottom.load(std::memory_order_acquire);
+  if (t >= b)
+    return false;
+
+  job = jobs[t & (JOB_DEQUE_SIZE - 1)];
+  return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+/*
+ * ========================================
+ * Job System
+ * ========================================
+ */
+JobSystem::JobSystem(unsigned int workerCount)
+  : unfinished(0), pushes(0), sleeping(0), stopping(false)
+{
+  for (unsigned int i = 0; i <= workerCount; i++)
+    deques.push_back(new Deque());
+  for (unsigned int i = 1; i <= workerCount; i++)
+    workers.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  wakeUp.notify_all();
+
+  for (std::thread& worker : workers)
+    worker.join();
+  for (Deque* deque : deques)
+    delete deque;
+}
+
+unsigned int JobSystem::defaultWorkers()
+{
+  return std::max(std::thread::hardware_concurrency(), 1u) - 1;
+}
+
+void JobSystem::run(TaskGraph& graph)
+{
+  if (graph.tasks.empty())
+    return;
+
+  for (TaskGraph::Task& task : graph.tasks)
+  {
+    task.waiting.store(task.dependencies, std::memory_order_relaxed);
+    task.remaining.store(task.count, std::memory_order_relaxed);
+  }
+  unfinished.store(graph.tasks.size(), std::memory_order_release);
+
+  for (TaskGraph::Task& task : graph.tasks)
+  {
+    if (task.dependencies == 0)
+      start(0, &task);
+  }
+
+  // Help out until the last task is done
+  Job job;
+  while (unfinished.load(std::memory_order_acquire) > 0)
+  {
+    if (find(0, job))
+      execute(0, job);
+    else
+      std::this_thread::yield();
+  }
+}
+
+void JobSystem::parallelFor(const char* name, size_t count, size_t batchSize, std::function<void(size_t, size_t)> work)
+{
+  TaskGraph graph;
+  graph.add(name, count, batchSize, std::move(work));
+  run(graph);
+}
+
+void JobSystem::workerLoop(unsigned int index)
+{
+  profiler.nameThread("jobs");
+
+  Job job;
+  int idle = 0;
+  while (!stopping.load(std::memory_order_relaxed))
+  {
+    if (find(index, job))
+    {
+      execute(index, job);
+      idle = 0;
+      continue;
+    }
+
+    if (++idle < IDLE_SPINS)
+    {
+      std::this_thread::yield();
+      continue;
+    }
+
+    // Nothing for a while. Check once more after saying we're asleep, so a
+    // push between the check and the wait can't be missed.
+    uint64_t epoch = pushes.load(std::memory_order_acquire);
+    sleeping.fetch_add(1, std::memory_order_seq_cst);
+    if (find(index, job))
+    {
+      sleeping.fetch_sub(1, std::memory_order_relaxed);
+      execute(index, job);
+      idle = 0;
+      continue;
+    }
+
+    std::unique_lock<std::mutex> guard(lock);
+    wakeUp.wait(guard, [&] { return stopping || pushes.load(std::memory_order_acquire) != epoch; });
+    sleeping.fetch_sub(1, std::memory_order_relaxed);
+    idle = 0;
+  }
+}
+
+bool JobSystem::find(unsigned int index, Job& job)
+{
+  if (deques[index]->pop(job))
+    return true;
+
+  // Start with the next thread along so thieves spread out
+  unsigned int count = (unsigned int) deques.size();
+  for (unsigned int i = 1; i < count; i++)
+  {
+    if (deques[(index + i) % count]->steal(job))
+      return true;
+  }
+  return false;
+}
+
+void JobSystem::execute(unsigned int index, Job job)
+{
+  TaskGraph::Task* task = job.task;
+
+  // Keep the first half and leave the rest for thieves, until what's left
+  // is one batch
+  while (job.end - job.begin > task->batchSize)
+  {
+    size_t batches = (job.end - job.begin + task->batchSize - 1) / task->batchSize;
+    size_t middle = job.begin + batches / 2 * task->batchSize;
+    if (!deques[index]->push({ task, middle, job.end }))
+      break;
+    job.end = middle;
+    wake();
+  }
+
+  {
+    ProfileScope scope(task->name);
+    task->work(job.begin, job.end);
+  }
+
+  size_t done = job.end - job.begin;
+  if (task->remaining.fetch_sub(done, std::memory_order_acq_rel) == done)
+    finished(index, task);
+}
+
+void JobSystem::start(unsigned int index, TaskGraph::Task* task)
+{
+  if (task->count == 0)
+  {
+    finished(index, task);
+    return;
+  }
+
+  if (!deques[index]->push({ task, 0, task->count }))
+  {
+    execute(index, { task, 0, task->count });
+    return;
+  }
+  wake();
+}
+
+void JobSystem::finished(unsigned int index, TaskGraph::Task* task)
+{
+  for (TaskGraph::Task* dependent : task->dependents)
+  {
+    if (dependent->waiting.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      start(index, dependent);
+  }
+  unfinished.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void JobSystem::wake()
+{
+  pushes.fetch_add(1, std::memory_order_seq_cst);
+  if (sleeping.load(std::memory_order_seq_cst) > 0)
+  {
+    // Taking the lock orders this against a worker about to wait
+    { std::lock_guard<std::mutex> guard(lock); }
+    wakeUp.notify_one();
+  }
+}
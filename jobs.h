@@ -0,0 +1,130 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * ========================================
+ * Job System
+ * ========================================
+ * One worker per core, plus the thread that calls run(), which works too
+ * instead of waiting. Every thread has its own work-stealing deque: it
+ * pushes and pops at the bottom, idle threads steal the oldest (biggest)
+ * job off the top of someone else's.
+ *
+ * Work comes in as a TaskGraph. A task is either one call or a parallel
+ * for over [0, count), split in half again and again down to batchSize so
+ * thieves pick up large pieces first. Each task counts the items it has
+ * left and the tasks it's waiting on; the last piece of a task to finish
+ * starts every task whose count that drops to zero.
+ *
+ * Only the thread that made the JobSystem may call run(). Task bodies
+ * must not call back into the JobSystem.
+ */
+static const size_t JOB_DEQUE_SIZE = 4096; // Power of two
+
+typedef int TaskId;
+
+class TaskGraph
+{
+public:
+  // Runs work() once
+  TaskId add(const char* name, std::function<void()> work);
+  // Runs work(begin, end) over [0, count), no range longer than batchSize.
+  // Bigger batches cost less to hand out, smaller ones balance better.
+  TaskId add(const char* name, size_t count, size_t batchSize, std::function<void(size_t, size_t)> work);
+  // task doesn't start before on has finished
+  void depend(TaskId task, TaskId on);
+
+  size_t size() const { return tasks.size(); }
+  void clear() { tasks.clear(); }
+
+private:
+  friend class JobSystem;
+
+  struct Task
+  {
+    const char* name; // Profiler scope, must live forever
+    size_t count;
+    size_t batchSize;
+    std::function<void(size_t, size_t)> work;
+    std::vector<Task*> dependents;
+    int dependencies = 0;
+    // Reset by every run
+    std::atomic<int> waiting { 0 };
+    std::atomic<size_t> remaining { 0 };
+  };
+
+  std::deque<Task> tasks; // Stable addresses
+};
+
+class JobSystem
+{
+public:
+  // Zero workers runs everything on the calling thread
+  explicit JobSystem(unsigned int workers);
+  ~JobSystem();
+  JobSystem(const JobSystem&) = delete;
+  JobSystem& operator=(const JobSystem&) = delete;
+
+  // Runs the whole graph, returns once every task has finished
+  void run(TaskGraph& graph);
+  // One task graph of a single parallel for
+  void parallelFor(const char* name, size_t count, size_t batchSize, std::function<void(size_t, size_t)> work);
+
+  // Including the calling thread
+  unsigned int threads() const { return (unsigned int) deques.size(); }
+  // A worker per core, the calling thread being one of them
+  static unsigned int defaultWorkers();
+
+private:
+  struct Job
+  {
+    TaskGraph::Task* task;
+    size_t begin;
+    size_t end;
+  };
+
+  // Chase-Lev, fixed size. The owner pushes and pops the bottom, anyone
+  // steals from the top.
+  struct alignas(64) Deque
+  {
+    std::atomic<int64_t> top { 0 };
+    alignas(64) std::atomic<int64_t> bottom { 0 };
+    Job jobs[JOB_DEQUE_SIZE];
+
+    bool push(const Job& job);
+    bool pop(Job& job);
+    bool steal(Job& job);
+  };
+
+  void workerLoop(unsigned int index);
+  // A job from our own deque, or stolen from another, false if there were none
+  bool find(unsigned int index, Job& job);
+  void execute(unsigned int index, Job job);
+  void start(unsigned int index, TaskGraph::Task* task);
+  void finished(unsigned int index, TaskGraph::Task* task);
+  void wake();
+
+  std::vector<Deque*> deques; // [0] belongs to the thread that made us
+  std::vector<std::thread> workers;
+
+  std::atomic<size_t> unfinished; // Tasks left in the running graph
+
+  // Idle workers sleep here, pushes bumps the epoch they wait on
+  std::mutex lock;
+  std::condition_variable wakeUp;
+  std::atomic<uint64_t> pushes;
+  std::atomic<int> sleeping;
+  std::atomic<bool> stopping;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#include "lighting.h"
+#include "profiler.h"
+
+std::vector<std::string> clusterDefines()
+{
+  return { "POINT_LIGHTS", "CLUSTER_X " + std::to_string(CLUSTER_X), "CLUSTER_Y " + std::to_string(CLUSTER_Y),
+           "CLUSTER_Z " + std::to_string(CLUSTER_Z) };
+}
+
+ClusterBuffers::ClusterBuffers()
+{
+  static const GLenum FORMATS[BUFFER_COUNT] = { GL_RGBA32F, GL_RG32UI, GL_R16UI };
+
+  glGenBuffers(BUFFER_COUNT, buffers);
+  glGenTextures(BUFFER_COUNT, textures);
+  for (int i = 0; i < BUFFER_COUNT; i++)
+  {
+    // Never empty, some drivers won't sample a buffer texture with no storage
+    glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+    glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+    glTexBuffer(GL_TEXTURE_BUFFER, FORMATS[i], buffers[i]);
+  }
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+ClusterBuffers::~ClusterBuffers()
+{
+  glDeleteTextures(BUFFER_COUNT, textures);
+  glDeleteBuffers(BUFFER_COUNT, buffers);
+}
+
+void ClusterBuffers::upload(const PointLight* lights, const LightClusters& clusters)
+{
+  const void* data[BUFFER_COUNT] = { lights, clusters.ranges.data(), clusters.indices.data() };
+  size_t bytes[BUFFER_COUNT] = { clusters.lights * sizeof(PointLight), clusters.ranges.size() * sizeof(uint32_t),
+                                 clusters.indices.size() * sizeof(uint16_t) };
+
+  for (int i = 0; i < BUFFER_COUNT; i++)
+  {
+    if (bytes[i] == 0)
+      continue;
+
+    // Orphans last frame's storage rather than waiting for it
+    glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+    glBufferData(GL_TEXTURE_BUFFER, bytes[i], data[i], GL_STREAM_DRAW);
+    profiler.count(COUNTER_UPLOAD_BYTES, bytes[i]);
+  }
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void ClusterBuffers::bind()
+{
+  for (int i = 0; i < BUFFER_COUNT; i++)
+  {
+    glActiveTexture(GL_TEXTURE0 + LIGHT_TEXTURE_UNIT + i);
+    glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+  }
+  glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,47 @@
+#ifndef LIGHTING_H
+#define LIGHTING_H
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+#include "clusters.h"
+
+/*
+ * ========================================
+ * Clustered Lights
+ * ========================================
+ * The GPU side of clusters.h: the lights and the cluster lists in three
+ * buffer textures that fragment.glsl reads with texelFetch, on texture
+ * units LIGHT_TEXTURE_UNIT and the two after it. All of it is rewritten
+ * every frame into fresh storage, so the driver never waits on a draw
+ * still reading last frame's.
+ */
+static const unsigned int LIGHT_TEXTURE_UNIT = 0;
+
+// fragment.glsl's #defines for shading point lights, with the cluster grid
+std::vector<std::string> clusterDefines();
+
+class ClusterBuffers
+{
+public:
+  ClusterBuffers();
+  ~ClusterBuffers();
+
+  void upload(const PointLight* lights, const LightClusters& clusters);
+  // Points the texture units at them, before drawing
+  void bind();
+
+private:
+  enum
+  {
+    LIGHTS,
+    RANGES,
+    INDICES,
+    BUFFER_COUNT
+  };
+
+  unsigned int buffers[BUFFER_COUNT];
+  unsigned int textures[BUFFER_COUNT];
+};
+
+#endif
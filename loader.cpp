@@ -0,0 +1,131 @@
+#include "loader.h"
+#include "profiler.h"
+
+/*
+ * ========================================
+ * Asset Loader
+ * ========================================
+ */
+AssetLoader::AssetLoader(unsigned int threads, Timeline* timeline)
+  : timeline(timeline), stopping(false), completed(nullptr), outstanding(0)
+{
+  for (unsigned int i = 0; i < threads; i++)
+    workers.emplace_back(&AssetLoader::workerLoop, this);
+}
+
+AssetLoader::~AssetLoader()
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread& worker : workers)
+    worker.join();
+
+  for (Job* job : queue)
+    delete job;
+  Job* job = completed.exchange(nullptr);
+  while (job)
+  {
+    Job* next = job->next;
+    delete job;
+    job = next;
+  }
+}
+
+void AssetLoader::load(const std::string& name, std::function<void()> work, std::function<void()> upload)
+{
+  Job* job = new Job { name, std::move(work), std::move(upload), nullptr };
+  outstanding++;
+
+  if (workers.empty())
+  {
+    run(job);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    queue.push_back(job);
+  }
+  wake.notify_one();
+}
+
+void AssetLoader::run(Job* job)
+{
+  double start = timeline ? timeline->now() : 0;
+  if (job->work)
+    job->work();
+  if (timeline)
+    timeline->record("load " + job->name, start, timeline->now());
+
+  // Push onto the completed stack. Only pump() pops, and it takes the whole
+  // list at once, so there's no ABA to worry about.
+  Job* head = completed.load(std::memory_order_relaxed);
+  do
+  {
+    job->next = head;
+  } while (!completed.compare_exchange_weak(head, job, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void AssetLoader::workerLoop()
+{
+  profiler.nameThread("loader");
+  while (true)
+  {
+    Job* job;
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      wake.wait(guard, [this] { return stopping || !queue.empty(); });
+      if (stopping)
+        return;
+      job = queue.front();
+      queue.pop_front();
+    }
+    run(job);
+  }
+}
+
+unsigned int AssetLoader::pump()
+{
+  Job* job = completed.exchange(nullptr, std::memory_order_acquire);
+
+  // Back into submission order
+  Job* ordered = nullptr;
+  while (job)
+  {
+    Job* next = job->next;
+    job->next = ordered;
+    ordered = job;
+    job = next;
+  }
+
+  unsigned int uploaded = 0;
+  while (ordered)
+  {
+    Job* next = ordered->next;
+
+    double start = timeline ? timeline->now() : 0;
+    if (ordered->upload)
+      ordered->upload();
+    if (timeline)
+      timeline->record("upload " + ordered->name, start, timeline->now());
+
+    delete ordered;
+    ordered = next;
+    uploaded++;
+  }
+
+  outstanding -= uploaded;
+  return uploaded;
+}
+
+void AssetLoader::finish()
+{
+  while (outstanding > 0)
+  {
+    if (pump() == 0)
+      std::this_thread::yield();
+  }
+}
@@ -0,0 +1,71 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "timeline.h"
+
+/*
+ * ========================================
+ * Asset Loader
+ * ========================================
+ * Splits loading in two. work() runs on a worker thread: file I/O,
+ * decoding, anything CPU side. upload() runs later on the thread that owns
+ * the GL context, from pump(), and should be nothing but the GL calls.
+ *
+ * Workers hand finished jobs back through a lock-free stack, so pump()
+ * never waits on a worker and a worker never waits on the frame.
+ *
+ * With zero threads load() does the work itself, which is the old strictly
+ * serial startup, kept to compare against.
+ */
+class AssetLoader
+{
+public:
+  AssetLoader(unsigned int threads, Timeline* timeline = nullptr);
+  ~AssetLoader();
+  AssetLoader(const AssetLoader&) = delete;
+  AssetLoader& operator=(const AssetLoader&) = delete;
+
+  void load(const std::string& name, std::function<void()> work, std::function<void()> upload);
+
+  // Uploads whatever has finished, on the context thread. Returns how many.
+  unsigned int pump();
+  // Pumps until every job is uploaded
+  void finish();
+
+  unsigned int pending() const { return outstanding; }
+
+private:
+  struct Job
+  {
+    std::string name;
+    std::function<void()> work;
+    std::function<void()> upload;
+    Job* next;
+  };
+
+  void run(Job* job);
+  void workerLoop();
+
+  Timeline* timeline;
+  std::vector<std::thread> workers;
+
+  // Jobs waiting for a worker
+  std::mutex lock;
+  std::condition_variable wake;
+  std::deque<Job*> queue;
+  bool stopping;
+
+  // Finished jobs, newest first
+  std::atomic<Job*> completed;
+  unsigned int outstanding; // Context thread only
+};
+
+#endif
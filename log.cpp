@@ -0,0 +1,198 @@
+#include "log.h"
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+Logger logger;
+
+// The writer sleeps this long when the ring is empty
+static const int LOG_FLUSH_MS = 5;
+
+static int64_t clockNs()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * ========================================
+ * Logger
+ * ========================================
+ */
+Logger::Logger()
+  : minimum((int) LogLevel::INFO), channels(~0u), enqueuePos(0), dequeuePos(0), dropped(0), suppressed(0),
+    written(0), batches(0), stopping(false)
+{
+  ring = new Slot[LOG_RING_MESSAGES];
+  for (size_t i = 0; i < LOG_RING_MESSAGES; i++)
+    ring[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+Logger::~Logger()
+{
+  if (writer.joinable())
+  {
+    stopping.store(true);
+    writer.join();
+  }
+  drain();
+  delete[] ring;
+}
+
+void Logger::setLevel(LogLevel level)
+{
+  minimum.store((int) level, std::memory_order_relaxed);
+}
+
+void Logger::setChannel(LogChannel channel, bool enabled)
+{
+  if (enabled)
+    channels.fetch_or(1u << channel, std::memory_order_relaxed);
+  else
+    channels.fetch_and(~(1u << channel), std::memory_order_relaxed);
+}
+
+void Logger::start()
+{
+  writer = std::thread(&Logger::writerLoop, this);
+}
+
+/*
+ * Producers, any thread. A bounded MPMC queue (Vyukov): a slot's sequence
+ * says whose turn it is, so claiming one is a single CAS and a full ring is
+ * noticed without ever waiting on the writer.
+ */
+void Logger::write(const char* format, ...)
+{
+  std::call_once(started, &Logger::start, this);
+
+  Slot* slot;
+  uint64_t pos = enqueuePos.load(std::memory_order_relaxed);
+  while (true)
+  {
+    slot = &ring[pos & (LOG_RING_MESSAGES - 1)];
+    uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+    int64_t difference = (int64_t) sequence - (int64_t) pos;
+
+    if (difference == 0)
+    {
+      if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        break;
+    }
+    else if (difference < 0)
+    {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    else
+    {
+      pos = enqueuePos.load(std::memory_order_relaxed);
+    }
+  }
+
+  va_list args;
+  va_start(args, format);
+  int length = std::vsnprintf(slot->text, LOG_MESSAGE_BYTES - 1, format, args);
+  va_end(args);
+
+  // Truncated messages keep what fit
+  if (length < 0)
+    length = 0;
+  if ((size_t) length > LOG_MESSAGE_BYTES - 2)
+    length = LOG_MESSAGE_BYTES - 2;
+  slot->text[length] = '\n';
+  slot->length = (uint32_t) length + 1;
+
+  slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+bool Logger::allow(LogSite& site, int ms, unsigned int& held)
+{
+  int64_t now = clockNs();
+  int64_t next = site.nextNs.load(std::memory_order_relaxed);
+  if (now < next || !site.nextNs.compare_exchange_strong(next, now + (int64_t) ms * 1000000))
+  {
+    site.held.fetch_add(1, std::memory_order_relaxed);
+    suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  held = site.held.exchange(0, std::memory_order_relaxed);
+  return true;
+}
+
+/*
+ * Writer thread
+ */
+bool Logger::drain()
+{
+  // One fwrite per batch instead of one per message
+  static char batch[LOG_RING_MESSAGES * LOG_MESSAGE_BYTES / 4];
+  size_t used = 0;
+  uint64_t count = 0;
+
+  while (true)
+  {
+    Slot& slot = ring[dequeuePos & (LOG_RING_MESSAGES - 1)];
+    uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != dequeuePos + 1)
+      break;
+
+    if (used + slot.length > sizeof(batch))
+    {
+      std::fwrite(batch, 1, used, stdout);
+      used = 0;
+    }
+    std::memcpy(batch + used, slot.text, slot.length);
+    used += slot.length;
+    count++;
+
+    slot.sequence.store(dequeuePos + LOG_RING_MESSAGES, std::memory_order_release);
+    dequeuePos++;
+  }
+
+  if (count == 0)
+    return false;
+
+  std::fwrite(batch, 1, used, stdout);
+  std::fflush(stdout);
+  written.fetch_add(count, std::memory_order_relaxed);
+  batches.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void Logger::writerLoop()
+{
+  while (!stopping.load())
+  {
+    if (!drain())
+    {
+      drained.notify_all();
+      std::this_thread::sleep_for(std::chrono::milliseconds(LOG_FLUSH_MS));
+    }
+  }
+}
+
+void Logger::flush()
+{
+  if (!writer.joinable())
+    return;
+
+  // Everything claimed before now, written or dropped
+  uint64_t target = enqueuePos.load();
+  std::unique_lock<std::mutex> guard(lock);
+  while (written.load() < target)
+    drained.wait_for(guard, std::chrono::milliseconds(LOG_FLUSH_MS));
+}
+
+LogStats Logger::stats() const
+{
+  LogStats taken;
+  taken.written = written.load();
+  taken.dropped = dropped.load();
+  taken.suppressed = suppressed.load();
+  taken.batches = batches.load();
+  return taken;
+}
@@ -0,0 +1,142 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+/*
+ * ========================================
+ * Logging
+ * ========================================
+ * LOG(level, channel, "format", ...) formats straight into a slot of a
+ * lock-free ring, and a background thread writes the ring out in batches,
+ * so a log call never touches the terminal or a pipe. When the writer
+ * falls behind and the ring is full, messages are dropped and counted
+ * instead of waiting or growing.
+ *
+ * Filtered out levels and channels cost a load and a compare, arguments
+ * aren't even evaluated. LOG_EVERY(ms, ...) lets one call site through at
+ * most once per ms milliseconds, and says how many it held back.
+ *
+ * Messages are printed as they are, in the ERROR::CHANNEL::WHAT style.
+ */
+static const size_t LOG_MESSAGE_BYTES = 240;
+static const size_t LOG_RING_MESSAGES = 4096; // Power of two
+
+enum class LogLevel : int
+{
+  DEBUG,
+  INFO,
+  WARN,
+  ERROR,
+  OFF
+};
+
+enum LogChannel
+{
+  LOG_GAME,
+  LOG_SIM,
+  LOG_RENDER,
+  LOG_SHADER,
+  LOG_ASSET,
+  LOG_CHANNEL_COUNT
+};
+
+struct LogStats
+{
+  unsigned long long written = 0;
+  unsigned long long dropped = 0;    // Ring was full
+  unsigned long long suppressed = 0; // Held back by LOG_EVERY
+  unsigned long long batches = 0;
+};
+
+// One per LOG_EVERY call site
+struct LogSite
+{
+  std::atomic<int64_t> nextNs { 0 };
+  std::atomic<unsigned int> held { 0 };
+};
+
+class Logger
+{
+public:
+  Logger();
+  ~Logger();
+
+  bool enabled(LogLevel level, LogChannel channel) const
+  {
+    return (int) level >= minimum.load(std::memory_order_relaxed) &&
+           (channels.load(std::memory_order_relaxed) >> channel & 1);
+  }
+
+  void setLevel(LogLevel level);
+  void setChannel(LogChannel channel, bool enabled);
+
+  // Queues one line, callers filter first (the macros do)
+  void write(const char* format, ...) __attribute__((format(printf, 2, 3)));
+  // False if this site already logged in the last ms milliseconds. When it's
+  // true, held is how many calls were turned away since the last one.
+  bool allow(LogSite& site, int ms, unsigned int& held);
+
+  // Blocks until everything logged so far is written out
+  void flush();
+  LogStats stats() const;
+
+private:
+  struct Slot
+  {
+    std::atomic<uint64_t> sequence;
+    uint32_t length;
+    char text[LOG_MESSAGE_BYTES];
+  };
+
+  void start();
+  void writerLoop();
+  // Writes out everything queued, true if there was anything
+  bool drain();
+
+  std::atomic<int> minimum;
+  std::atomic<uint32_t> channels;
+
+  Slot* ring;
+  alignas(64) std::atomic<uint64_t> enqueuePos;
+  alignas(64) uint64_t dequeuePos; // Writer thread only
+  alignas(64) std::atomic<uint64_t> dropped;
+  std::atomic<uint64_t> suppressed;
+  std::atomic<uint64_t> written;
+  std::atomic<uint64_t> batches;
+
+  std::once_flag started;
+  std::thread writer;
+  std::atomic<bool> stopping;
+  std::mutex lock; // Only for flush() to sleep on
+  std::condition_variable drained;
+};
+
+extern Logger logger;
+
+#define LOG(level, channel, ...)                  \
+  do                                              \
+  {                                               \
+    if (logger.enabled(LogLevel::level, channel)) \
+      logger.write(__VA_ARGS__);                  \
+  } while (0)
+
+#define LOG_EVERY(ms, level, channel, ...)                                              \
+  do                                                                                    \
+  {                                                                                     \
+    static LogSite logSite;                                                             \
+    unsigned int logHeld;                                                               \
+    if (logger.enabled(LogLevel::level, channel) && logger.allow(logSite, ms, logHeld)) \
+    {                                                                                   \
+      logger.write(__VA_ARGS__);                                                        \
+      if (logHeld)                                                                      \
+        logger.write("  (%u more suppressed)", logHeld);                                \
+    }                                                                                   \
+  } while (0)
+
+#endif
@@ -11,120 +11,34 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+// Game
+#include "shader.h"
+#include "shadercompiler.h"
+#include "camera.h"
+#include "simulation.h"
+#include "replay.h"
+#include "pacing.h"
+#include "renderer.h"
+#include "models.h"
+#include "loader.h"
+#include "timeline.h"
+#include "profiler.h"
+#include "gpuprofiler.h"
+#include "log.h"
+#include "scene.h"
+#include "snapshot.h"
 // STL
 #include <iostream>
 #include <vector>
-#include <fstream>
-#include <sstream>
 #include <string>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <atomic>
 
-/* 
- * ========================================
- * Class Declarations
- * ========================================
- */
-class Shader;
-
-/* 
- * ========================================
- * Shader Class
- * ========================================
- */
-class Shader
-{
-public: 
-  unsigned int id;
-
-  Shader(const char* vertexPath, const char* fragmentPath)
-  {
-    std::string vertexCode;
-    std::string fragmentCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
-    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-
-    try
-    {
-      vShaderFile.open(vertexPath);
-      fShaderFile.open(fragmentPath);
-      std::stringstream vShaderStream, fShaderStream;
-
-      vShaderStream << vShaderFile.rdbuf();
-      fShaderStream << fShaderFile.rdbuf();
-
-      vShaderFile.close();
-      fShaderFile.close();
-
-      vertexCode = vShaderStream.str();
-      fragmentCode = fShaderStream.str();
-    }
-    catch(std::ifstream::failure e)
-    {
-      std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
-    }
-
-    const char* vShaderCode = vertexCode.c_str();
-    const char* fShaderCode = fragmentCode.c_str();
-
-    /*
-     * Compile and link shaders
-     */
-    unsigned int vertex, fragment;
-    int success;
-    char infoLog[512];
-
-    // Vertex Shader
-    vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, NULL);
-    glCompileShader(vertex);
-
-    glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-      glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-      std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-    }
-
-    // Fragment Shader
-    fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, NULL);
-    glCompileShader(fragment);
-
-    glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-      glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-      std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
-    }
-
-    // Link shaders
-    id = glCreateProgram();
-    glAttachShader(id, vertex);
-    glAttachShader(id, fragment);
-    glLinkProgram(id);
-
-    glGetProgramiv(id, GL_LINK_STATUS, &success);
-    if (!success)
-    {
-      glGetProgramInfoLog(id, 512, NULL, infoLog);
-      std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-    }
-
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
-  }
-
-  void use()
-  {
-    glUseProgram(id);
-  }
-
-  void setVec3(const std::string& name, float x, float y, float z)
-  {
-    glUniform3f(glGetUniformLocation(id, name.c_str()), x, y, z);
-  }
-};
 /* 
  * ========================================
  * Constants
@@ -141,8 +55,21 @@ struct
   struct
   {
     const int FPS = 60;
-    const int FRAME_DELAY = 1000 / FPS;
+    const PacingMode PACING = PacingMode::SLEEP_SPIN;
+    const char* PROGRAM_CACHE = "cache"; // Linked shader binaries, safe to delete
+    const char* STARTUP_TIMELINE = "startup.csv";
+    const char* PROFILE_TRACE = "profile.json"; // Chrome trace, P toggles capture
   } GAME;
+  struct
+  {
+    // Behind each ship, the nose points down -z
+    const float OFFSET_Y = 0.5f;
+    const float OFFSET_Z = 3.0f;
+    const float RADIUS = 6.0f;
+    const float COLOR[3] = { 1.0f, 0.45f, 0.1f };
+    // Render thread workers for binning lights, few next to the simulation's pool
+    const unsigned int WORKERS = 2;
+  } GLOWS;
 } CONSTANTS;
 
 /* 
@@ -154,33 +81,27 @@ struct
 {
   struct
   {
-    bool running = true;
+    std::atomic<bool> running { true };
     SDL_Window* window;
+    FramePacer* pacer;
+    bool toggleProfiler; // P was pressed, acted on between frames
   } GAME;
+  SimInput INPUT; // Held keys, as the events left them
+  // Everything below but input and snapshots belongs to the simulation thread
   struct
   {
-    bool left = false;
-    bool right = false;
-    bool up = false;
-    bool down = false;
-  } INPUT;
-  struct
-  {
-    Shader* shader;
-    struct
-    {
-      Shader* shader;
-      float x = 0;
-      float y = 5;
-      float z = -20;
-    } LIGHT;
-    unsigned int VAO;
-    unsigned int lightVAO;
-  } GLOBJECTS;
+    std::thread thread;
+    std::atomic<SimInput> input { SimInput() }; // INPUT, published for the simulation
+    SnapshotBuffer snapshots;
+    FixedTimestep timestep;
+    SimState state;
+    InputRecorder recorder;
+  } SIM;
+  Scene GLOBJECTS; // Main thread only, it owns the GL context
   struct
   {
-    float PI = 3.14159;
-  } MATH;
+    JobSystem* jobs;
+  } RENDER;
 } GLOBALS;
 
 /* 
@@ -189,216 +110,16 @@ struct
  * ========================================
  */
 static void input();
-static void update();
+static void handleEvent(const SDL_Event& e);
+static void simulate();
 static void draw();
+static void engineGlows(const EntityTransforms& ships);
 
-static void findNormals(std::vector<float>&);
-
-/* 
- * ========================================
- * Player stuff
- * ========================================
- */
-struct
-{
-  // Stats
-  float x = 0;
-  float y = 0;
-  float tiltX = 0;
-  float tiltY = 0;
-  int health = 100;
-  // The model
-  // First three are positions, next three are colors, the last three are normals
-  std::vector<float> p = {
-    -1.000f,  0.000f,  0.000f, 0, 0, 0,
-     1.000f,  0.000f,  0.000f, 0, 0, 0,
-     0.000f, -0.500f, -0.250f, 0, 0, 0,
-    -0.750f,  1.000f,  0.000f, 0, 0, 0,
-     0.000f,  1.000f,  0.000f, 0, 0, 0,
-     0.750f,  1.000f,  0.000f, 0, 0, 0,
-     0.000f,  0.600f,  2.000f, 0, 0, 0,
-     0.000f,  0.250f, -6.000f, 0, 0, 0,
-    -2.000f,  0.000f,  0.000f, 0, 0, 0,
-    -1.750f,  0.750f, -1.000f, 0, 0, 0,
-    -1.500f,  4.000f,  2.000f, 0, 0, 0,
-    -1.500f, -1.000f,  0.000f, 0, 0, 0,
-    -4.000f, -1.250f,  5.000f, 0, 0, 0,
-     2.000f,  0.000f,  0.000f, 0, 0, 0,
-     1.750f,  0.750f, -1.000f, 0, 0, 0,
-     1.500f,  4.000f,  2.000f, 0, 0, 0,
-     1.500f, -1.000f,  0.000f, 0, 0, 0,
-     4.000f, -1.250f,  5.000f, 0, 0, 0
-  };
-  std::vector<float> points = {
-    -1.000f,  0.000f,  0.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-     1.000f,  0.000f,  0.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-     0.000f, -0.500f, -0.250f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-
-    -1.000f,  0.000f,  0.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-    -0.750f,  1.000f,  0.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-     0.000f,  0.600f,  2.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-    
-    -0.750f,  1.000f,  0.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-     0.000f,  1.000f,  0.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-     0.000f,  0.600f,  2.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-    
-     0.000f,  1.000f,  0.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-     0.750f,  1.000f,  0.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-     0.000f,  0.600f,  2.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-    
-     0.750f,  1.000f,  0.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-     1.000f,  0.000f,  0.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-     0.000f,  0.600f,  2.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-    
-    -1.000f,  0.000f,  0.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-    -0.750f,  1.000f,  0.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-     0.000f,  0.250f, -6.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-
-    -0.750f,  1.000f,  0.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-     0.750f,  1.000f,  0.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-     0.000f,  0.250f, -6.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-
-     0.750f,  1.000f,  0.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-     1.000f,  0.000f,  0.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-     0.000f,  0.250f, -6.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-
-    -1.000f,  0.000f,  0.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-     0.000f, -0.500f, -0.250f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-     0.000f,  0.250f, -6.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-
-     1.000f,  0.000f,  0.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-     0.000f, -0.500f, -0.250f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-     0.000f,  0.250f, -6.000f, 1.00f, 1.00f, 1.00f, 0, 0, 0,
-
-    -1.000f,  0.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-    -2.000f,  0.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-    -1.500f,  4.000f,  2.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-
-    -2.000f,  0.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-    -1.750f,  0.750f, -1.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-    -1.500f,  4.000f,  2.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-
-    -1.750f,  0.750f, -1.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-    -1.000f,  0.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-    -1.500f,  4.000f,  2.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-
-    -1.000f,  0.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-    -2.000f,  0.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-    -1.750f,  0.750f, -1.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-
-    -1.000f,  0.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-    -1.500f, -1.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-    -4.000f, -1.250f,  5.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-
-    -1.000f,  0.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-    -2.000f,  0.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-    -4.000f, -1.250f,  5.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-
-    -2.000f,  0.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-    -1.500f, -1.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-    -4.000f, -1.250f,  5.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-
-    -1.000f,  0.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-    -2.000f,  0.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-    -1.500f, -1.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-
-     1.000f,  0.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-     2.000f,  0.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-     1.500f,  4.000f,  2.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-
-     2.000f,  0.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-     1.750f,  0.750f, -1.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-     1.500f,  4.000f,  2.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-
-     1.750f,  0.750f, -1.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-     1.000f,  0.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-     1.500f,  4.000f,  2.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-
-     1.000f,  0.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-     2.000f,  0.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-     1.750f,  0.750f, -1.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-
-     1.000f,  0.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-     1.500f, -1.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-     4.000f, -1.250f,  5.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-
-     1.000f,  0.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-     2.000f,  0.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-     4.000f, -1.250f,  5.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-
-     2.000f,  0.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-     1.500f, -1.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-     4.000f, -1.250f,  5.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-
-     1.000f,  0.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-     2.000f,  0.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-     1.500f, -1.000f,  0.000f, 0.00f, 0.55f, 0.96f, 0, 0, 0,
-  };
-  // Model indices
-  std::vector<unsigned int> indices = {
-   0, 1, 2,
-   0, 3, 6,
-   3, 4, 6,
-   4, 5, 6,
-   5, 1, 6,
-   0, 3, 7,
-   3, 5, 7,
-   5, 1, 7,
-   0, 2, 7,
-   1, 2, 7,
-   0, 8, 10,
-   8, 9, 10,
-   9, 0, 10,
-   0, 8, 9,
-   0, 11, 12,
-   0, 8, 12,
-   8, 11, 12,
-    0, 8, 11,
-    1, 13, 15,
-    13, 14, 15,
-    14, 1, 15,
-    1, 13, 14,
-    1, 16, 17,
-    1, 13, 17,
-    13, 16, 17,
-    1, 13, 16
-  };
-} player;
-
-// Light source
-struct
-{
-  std::vector<float> points {
-    -1.0f, -1.0f,  1.0f,
-     1.0f, -1.0f,  1.0f,
-    -1.0f,  1.0f,  1.0f,
-     1.0f,  1.0f,  1.0f,
-    -1.0f, -1.0f, -1.0f,
-     1.0f, -1.0f, -1.0f,
-    -1.0f,  1.0f, -1.0f,
-     1.0f,  1.0f, -1.0f
-  };
-  std::vector<unsigned int> indices {
-    0, 1, 2,
-    2, 1, 3,
-
-    4, 0, 6,
-    6, 0, 2,
-
-    5, 1, 7,
-    7, 1, 3,
-
-    4, 5, 6,
-    6, 5, 7,
-
-    6, 7, 2,
-    2, 7, 3,
-
-    4, 5, 0,
-    0, 5, 1
-  };
-} light;
+static double clockSeconds();
+static double stage(const char* name, double start);
+static void toggleProfiler();
 
+static void benchInstances();
 
 /* 
  * ========================================
@@ -407,6 +128,84 @@ struct
  */
 int main(int argc, char* args[])
 {
+  PacingMode pacing = CONSTANTS.GAME.PACING;
+  bool benchmark = false;
+  bool serialLoad = false;
+  bool profile = false;
+
+  for (int i = 1; i < argc; i++)
+  {
+    // Headless load testing, no window or GL context needed
+    if (std::strcmp(args[i], "--simulate") == 0 && i + 1 < argc)
+      return simulateHeadless(std::strtoull(args[++i], nullptr, 10));
+    if (std::strcmp(args[i], "--replay") == 0 && i + 1 < argc)
+      return replayHeadless(args[++i]);
+
+    if (std::strcmp(args[i], "--pacing") == 0 && i + 1 < argc)
+    {
+      if (!parsePacingMode(args[++i], pacing))
+      {
+        LOG(ERROR, LOG_GAME, "ERROR::ARGS::UNKNOWN_PACING_MODE (vsync, sleep or wait)");
+        return -1;
+      }
+    }
+
+    // Instanced rendering throughput, needs a window
+    if (std::strcmp(args[i], "--bench-instances") == 0)
+      benchmark = true;
+    // Load everything in order on this thread, to compare startup timelines
+    if (std::strcmp(args[i], "--serial-load") == 0)
+      serialLoad = true;
+    // Every tick's input, for --replay (here or in astro_headless)
+    if (std::strcmp(args[i], "--record") == 0 && i + 1 < argc)
+    {
+      if (!GLOBALS.SIM.recorder.open(args[++i]))
+        return -1;
+    }
+    // Debug logging, the light position once a second among others
+    if (std::strcmp(args[i], "--verbose") == 0)
+      logger.setLevel(LogLevel::DEBUG);
+    // Capture from the first frame instead of waiting for P
+    if (std::strcmp(args[i], "--profile") == 0)
+      profile = true;
+  }
+
+  /* 
+   * ========================================
+   * Start loading
+   * ========================================
+   */
+  // Meshes are mapped and paged in on the loader while the window comes up,
+  // only the uploads wait for the context. Baked by assetc, see CMakeLists.txt
+  profiler.nameThread("main");
+  // Declared before the loader so they outlive it: an early return below
+  // destroys it, joining jobs that are still writing to them
+  MeshFile shipFiles[SHIP_LODS], lightFile;
+  bool shipLoaded[SHIP_LODS] = {}, lightLoaded = false;
+  unsigned int loaderThreads = std::min(std::max(std::thread::hardware_concurrency(), 2u) - 1, 4u);
+  AssetLoader loader(serialLoad ? 0 : loaderThreads, &startupTimeline);
+
+  for (int lod = 0; lod < SHIP_LODS; lod++)
+  {
+    loader.load(SHIP_MESH_FILES[lod],
+      [&, lod] { shipLoaded[lod] = shipFiles[lod].open(SHIP_MESH_FILES[lod]); },
+      [&, lod]
+      {
+        if (shipLoaded[lod])
+          addMeshLod(GLOBALS.GLOBJECTS, MESH_SHIP, lod, shipFiles[lod]);
+        shipFiles[lod].close();
+      });
+  }
+  loader.load("light.mesh",
+    [&] { lightLoaded = lightFile.open("res/meshes/light.mesh"); },
+    [&]
+    {
+      if (lightLoaded)
+        GLOBALS.GLOBJECTS.lightMesh = uploadMesh(lightFile);
+      lightFile.close();
+    });
+  double stageStart = startupTimeline.now();
+
   /* 
    * ========================================
    * Initialize SDL and OpenGL
@@ -415,108 +214,147 @@ int main(int argc, char* args[])
   // Init SDL
   if (SDL_Init(SDL_INIT_EVERYTHING != 0))
   {
-    std::cout << "ERROR::SDL::INITIALIZATION_FAILED" << std::endl;
+    LOG(ERROR, LOG_GAME, "ERROR::SDL::INITIALIZATION_FAILED");
     return -1;
   }
+  stageStart = stage("sdl init", stageStart);
 
   // Create the window, which is also the OpenGL context
   GLOBALS.GAME.window = SDL_CreateWindow(CONSTANTS.WINDOW.TITLE, 0, 0, CONSTANTS.WINDOW.WIDTH, CONSTANTS.WINDOW.HEIGHT, SDL_WINDOW_OPENGL);
   SDL_GLContext glContext = SDL_GL_CreateContext(GLOBALS.GAME.window);
+  stageStart = stage("window", stageStart);
 
   // Initialize GLEW
   if (glewInit() != GLEW_OK)
   {
-    std::cout << "ERROR::GLEW::INITIALIZATION_FAILED" << std::endl;
+    LOG(ERROR, LOG_RENDER, "ERROR::GLEW::INITIALIZATION_FAILED");
     return -1;
   }
+  stageStart = stage("glew", stageStart);
+
+  // Frame pacing, vsync needs the context to exist
+  GLOBALS.GAME.pacer = new FramePacer(CONSTANTS.GAME.FPS, pacing);
+
+  submitPrograms(GLOBALS.GLOBJECTS, CONSTANTS.GAME.PROGRAM_CACHE);
+  stageStart = stage("shader submit", stageStart);
+
+  // Only the fallbacks have to be there for the first frame, the benchmark
+  // measures the real thing
+  waitForPrograms(GLOBALS.GLOBJECTS, benchmark);
+  stageStart = stage("fallback shaders", stageStart);
 
-  // Enable/Set up some OpenGL stuff
-  //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE); // Wireframe mode
-  glEnable(GL_DEPTH_TEST);
-  GLOBALS.GLOBJECTS.shader = new Shader("res/shaders/vertex.glsl", "res/shaders/fragment.glsl");
-  GLOBALS.GLOBJECTS.LIGHT.shader = new Shader("res/shaders/light_vertex.glsl", "res/shaders/light_fragment.glsl");
-  
   /* 
    * ========================================
    * Load objects onto GPU
    * ========================================
    */
-  // Player
-  findNormals(player.points);
-  unsigned int VBO;
-  glGenVertexArrays(1, &GLOBALS.GLOBJECTS.VAO);
-  glGenBuffers(1, &VBO);
-
-  glBindVertexArray(GLOBALS.GLOBJECTS.VAO);
-
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * player.points.size(), player.points.data(), GL_STATIC_DRAW);
-
-  // Position
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void*) 0);
-  glEnableVertexAttribArray(0);
-
-  // Color
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void*)(3 * sizeof(float)));
-  glEnableVertexAttribArray(1);
-
-  // Normal
-  glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void*)(6 * sizeof(float)));
-  glEnableVertexAttribArray(2);
-
-  // Light
-  unsigned int lightVBO, lightEBO;
-  glGenVertexArrays(1, &GLOBALS.GLOBJECTS.lightVAO);
-  glGenBuffers(1, &lightVBO);
-  glGenBuffers(1, &lightEBO);
-
-  glBindVertexArray(GLOBALS.GLOBJECTS.lightVAO);
-
-  glBindBuffer(GL_ARRAY_BUFFER, lightVBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * light.points.size(), light.points.data(), GL_STATIC_DRAW);
-
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lightEBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * light.indices.size(), light.indices.data(), GL_STATIC_DRAW);
-
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*) 0);
-  glEnableVertexAttribArray(0);
+  if (!createRenderer(GLOBALS.GLOBJECTS, CONSTANTS.WINDOW.WIDTH, CONSTANTS.WINDOW.HEIGHT))
+    return -1;
+  GLOBALS.RENDER.jobs = new JobSystem(std::min(JobSystem::defaultWorkers(), CONSTANTS.GLOWS.WORKERS));
+  GLOBALS.GLOBJECTS.jobs = GLOBALS.RENDER.jobs;
+
+  // Whatever the loader hasn't finished yet
+  loader.finish();
+  stageStart = stage("renderer and meshes", stageStart);
+  bool meshesLoaded = lightLoaded;
+  for (bool loaded : shipLoaded)
+    meshesLoaded = meshesLoaded && loaded;
+  if (!meshesLoaded)
+  {
+    LOG(ERROR, LOG_ASSET, "ERROR::GAME::MESHES_NOT_BUILT");
+    return -1;
+  }
 
-  GLOBALS.GLOBJECTS.shader->use();
-  GLOBALS.GLOBJECTS.shader->setVec3("lightColor",  1.0f, 1.0f, 1.0f);
-  GLOBALS.GLOBJECTS.shader->setVec3("lightPos", GLOBALS.GLOBJECTS.LIGHT.x, GLOBALS.GLOBJECTS.LIGHT.y, GLOBALS.GLOBJECTS.LIGHT.z);
+  if (benchmark)
+  {
+    benchInstances();
+    GLOBALS.GAME.running = false;
+  }
 
   /* 
    * ========================================
    * Game Loop
    * ========================================
    */
-  Uint32 frameStart;
-  int frameTime;
+  // The simulation ticks on its own thread from here on, this one handles
+  // events and draws whatever it last published. Tick 0 goes out first so
+  // there's always a snapshot to draw.
+  profiler.enable(profile);
+  FrameSnapshot& first = GLOBALS.SIM.snapshots.back();
+  captureSnapshot(GLOBALS.SIM.state, first);
+  first.tickTime = clockSeconds();
+  GLOBALS.SIM.snapshots.publish();
+  GLOBALS.SIM.thread = std::thread(simulate);
 
   while (GLOBALS.GAME.running)
   {
-    frameStart = SDL_GetTicks();
+    GLOBALS.GAME.pacer->beginFrame();
+    // Closed before endFrame(), so the span lands in the frame it timed
+    {
+      PROFILE_SCOPE("frame");
 
-    input();
-    update();
-    draw();
+      {
+        PROFILE_SCOPE("input");
+        input();
+      }
+      {
+        PROFILE_SCOPE("draw");
+        draw();
+      }
+
+      if (stageStart >= 0)
+      {
+        glFinish();
+        stage("first frame", stageStart);
+        LOG(INFO, LOG_GAME, "Startup: first frame after %g ms", startupTimeline.now());
+        startupTimeline.write(CONSTANTS.GAME.STARTUP_TIMELINE);
+        stageStart = -1;
+      }
 
-    frameTime = SDL_GetTicks() - frameStart;
+      {
+        PROFILE_SCOPE("pacing");
+        GLOBALS.GAME.pacer->wait(handleEvent);
+      }
+    }
+    profiler.endFrame();
 
-    while (CONSTANTS.GAME.FRAME_DELAY > frameTime)
+    // Not from handleEvent, the trace would miss the frame still open
+    if (GLOBALS.GAME.toggleProfiler)
     {
-      input();
-      frameTime = SDL_GetTicks() - frameStart;
+      toggleProfiler();
+      GLOBALS.GAME.toggleProfiler = false;
     }
   }
+  GLOBALS.SIM.thread.join();
+
+  // Still capturing, keep what we have
+  if (profiler.enabled())
+    toggleProfiler();
+
+  if (!benchmark)
+  {
+    GLOBALS.GAME.pacer->report();
+
+    RenderStats stats = GLOBALS.GLOBJECTS.renderer->takeStats();
+    PacingStats pacingStats = GLOBALS.GAME.pacer->stats();
+    unsigned long long frames = pacingStats.frames > 0 ? pacingStats.frames : 1;
+    LOG(INFO, LOG_RENDER, "Streaming: %llu bytes/frame, %u fence waits (%g ms)", stats.bytesUploaded / frames,
+        stats.fenceWaits, stats.fenceWaitMs);
+
+    SnapshotStats snapshotStats = GLOBALS.SIM.snapshots.stats();
+    LOG(INFO, LOG_RENDER, "Snapshots: %llu published, %llu never drawn, %llu frames with nothing new",
+        snapshotStats.published, snapshotStats.dropped, snapshotStats.waits);
+  }
 
   /* 
    * ========================================
    * Free up memory
    * ========================================
    */
-  delete GLOBALS.GLOBJECTS.LIGHT.shader;
-  delete GLOBALS.GLOBJECTS.shader;
+  GLOBALS.SIM.recorder.close(GLOBALS.SIM.state);
+  destroyScene(GLOBALS.GLOBJECTS);
+  delete GLOBALS.RENDER.jobs;
+  delete GLOBALS.GAME.pacer;
   SDL_DestroyWindow(GLOBALS.GAME.window);
   SDL_Quit();
 
@@ -532,234 +370,257 @@ void input()
 {
   SDL_Event e;
   while (SDL_PollEvent(&e))
-  {
-    switch (e.type)
-    {
-      case SDL_QUIT:
-      {
-        GLOBALS.GAME.running = false;
-        break;
-      }
-      case SDL_KEYDOWN:
-      {
-        switch (e.key.keysym.sym)
-        {
-          case SDLK_a:
-          {
-            GLOBALS.INPUT.left = true;
-            break;
-          }
-          case SDLK_d:
-          {
-            GLOBALS.INPUT.right = true;
-            break;
-          }
-          case SDLK_w:
-          {
-            GLOBALS.INPUT.up = true;
-            break;
-          }
-          case SDLK_s:
-          {
-            GLOBALS.INPUT.down = true;
-            break;
-          }
-        }
-        break;
-      }
-      case SDL_KEYUP:
-      {
-        switch (e.key.keysym.sym)
-        {
-          case SDLK_a:
-          {
-            GLOBALS.INPUT.left = false;
-            break;
-          }
-          case SDLK_d:
-          {
-            GLOBALS.INPUT.right = false;
-            break;
-          }
-          case SDLK_w:
-          {
-            GLOBALS.INPUT.up = false;
-            break;
-          }
-          case SDLK_s:
-          {
-            GLOBALS.INPUT.down = false;
-            break;
-          }
-        }
-        break;
-      }
-    }
-  }
+    handleEvent(e);
 }
 
-void update()
+void handleEvent(const SDL_Event& e)
 {
-  if (GLOBALS.INPUT.left || GLOBALS.INPUT.right)
+  switch (e.type)
   {
-    if (GLOBALS.INPUT.left)
+    case SDL_QUIT:
     {
-      if (player.x > -5)
-      {
-        player.x -= 0.1;
-      }
-      if (player.tiltX < GLOBALS.MATH.PI / 4)
-      {
-        if (player.tiltX < 0)
-          player.tiltX += 0.05;
-        else
-          player.tiltX += 0.01;
-      }
+      GLOBALS.GAME.running = false;
+      break;
     }
-    if (GLOBALS.INPUT.right)
+    case SDL_WINDOWEVENT:
     {
-      if (player.x < 5)
-      {
-        player.x += 0.1;
-      }
-      if (player.tiltX > -GLOBALS.MATH.PI / 4)
+      if (e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
       {
-        if (player.tiltX > 0)
-          player.tiltX -= 0.05;
-        else
-          player.tiltX -= 0.01;
+        glViewport(0, 0, e.window.data1, e.window.data2);
+        GLOBALS.GLOBJECTS.camera->resize(e.window.data1, e.window.data2);
       }
+      break;
     }
-  }
-  else
-  {
-    if (player.tiltX > 0.1)
-      player.tiltX -= 0.05;
-    else if (player.tiltX < -0.1)
-      player.tiltX += 0.05;
-    else
-      player.tiltX = 0;
-  }
-
-  if (GLOBALS.INPUT.up || GLOBALS.INPUT.down)
-  {
-    if (GLOBALS.INPUT.up)
+    case SDL_KEYDOWN:
     {
-      if (player.tiltY < GLOBALS.MATH.PI / 4)
+      switch (e.key.keysym.sym)
       {
-        if (player.tiltY < 0)
-          player.tiltY += 0.05;
-        else
-          player.tiltY += 0.01;
+        case SDLK_a:
+        {
+          GLOBALS.INPUT.left = true;
+          break;
+        }
+        case SDLK_d:
+        {
+          GLOBALS.INPUT.right = true;
+          break;
+        }
+        case SDLK_w:
+        {
+          GLOBALS.INPUT.up = true;
+          break;
+        }
+        case SDLK_s:
+        {
+          GLOBALS.INPUT.down = true;
+          break;
+        }
+        case SDLK_p:
+        {
+          if (!e.key.repeat)
+            GLOBALS.GAME.toggleProfiler = true;
+          break;
+        }
       }
+      break;
     }
-    if (GLOBALS.INPUT.down)
+    case SDL_KEYUP:
     {
-      if (player.tiltY > -GLOBALS.MATH.PI / 4)
+      switch (e.key.keysym.sym)
       {
-        if (player.tiltY > 0)
-          player.tiltY -= 0.05;
-        else
-          player.tiltY -= 0.01;
+        case SDLK_a:
+        {
+          GLOBALS.INPUT.left = false;
+          break;
+        }
+        case SDLK_d:
+        {
+          GLOBALS.INPUT.right = false;
+          break;
+        }
+        case SDLK_w:
+        {
+          GLOBALS.INPUT.up = false;
+          break;
+        }
+        case SDLK_s:
+        {
+          GLOBALS.INPUT.down = false;
+          break;
+        }
       }
+      break;
     }
   }
-  else
-  {
-    if (player.tiltY > 0.1)
-      player.tiltY -= 0.05;
-    else if (player.tiltY < -0.1)
-      player.tiltY += 0.05;
-    else
-      player.tiltY = 0;
-  }
 
-  // Test: Move light
-  //GLOBALS.GLOBJECTS.LIGHT.x = std::sin(4 * SDL_GetTicks());
-  GLOBALS.GLOBJECTS.LIGHT.z = 20 * std::sin(.005 * SDL_GetTicks()) - 20;
-  GLOBALS.GLOBJECTS.shader->use();
-  GLOBALS.GLOBJECTS.shader->setVec3("lightColor",  1.0f, 1.0f, 1.0f);
-  GLOBALS.GLOBJECTS.shader->setVec3("lightPos", GLOBALS.GLOBJECTS.LIGHT.x, GLOBALS.GLOBJECTS.LIGHT.y, GLOBALS.GLOBJECTS.LIGHT.z);
-  printf("light pos %f, %f, %f\n", GLOBALS.GLOBJECTS.LIGHT.x, GLOBALS.GLOBJECTS.LIGHT.y, GLOBALS.GLOBJECTS.LIGHT.z);
+  GLOBALS.SIM.input.store(GLOBALS.INPUT, std::memory_order_relaxed);
 }
 
-void draw()
+// The simulation thread: ticks as they come due, a snapshot for the
+// renderer after each lot, then sleep until the next one
+void simulate()
 {
-  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-  // Draw the objects
-  GLOBALS.GLOBJECTS.shader->use();
+  profiler.nameThread("sim");
 
-  // 3D Stuff
-  glm::mat4 model = glm::mat4(1.0f);
-  model = glm::translate(model, glm::vec3(player.x, 0.0f, 0.0f));
-  model = glm::rotate(model, player.tiltX, glm::vec3(0.0f, 0.0f, 1.0f));
-  model = glm::rotate(model, player.tiltY, glm::vec3(1.0f, 0.0f, 0.0f));
-  
-  glm::mat4 view = glm::mat4(1.0f);
-  view = glm::translate(view, glm::vec3(0.0f, 0.0f, -20.0f));
+  // Big worlds tick on every core
+  JobSystem jobs(JobSystem::defaultWorkers());
+  FixedTimestep& timestep = GLOBALS.SIM.timestep;
+  SimState& state = GLOBALS.SIM.state;
 
-  glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float) CONSTANTS.WINDOW.WIDTH / CONSTANTS.WINDOW.HEIGHT, 0.1f, 100.0f);
-
-  // Tell shader this stuff exists
-  unsigned int modelLoc = glGetUniformLocation(GLOBALS.GLOBJECTS.shader->id, "model");
-  glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-
-  unsigned int viewLoc = glGetUniformLocation(GLOBALS.GLOBJECTS.shader->id, "view");
-  glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
+  double last = clockSeconds();
+  while (GLOBALS.GAME.running)
+  {
+    double now = clockSeconds();
+    int steps = timestep.advance(now - last);
+    last = now;
 
-  unsigned int projectionLoc = glGetUniformLocation(GLOBALS.GLOBJECTS.shader->id, "projection");
-  glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
+    if (steps > 0)
+    {
+      PROFILE_SCOPE("update");
+      SimInput input = GLOBALS.SIM.input.load(std::memory_order_relaxed);
+      for (int i = 0; i < steps; i++)
+      {
+        step(state, timestep.dt, input, &jobs);
+        GLOBALS.SIM.recorder.tick(input, state);
+      }
 
-  glBindVertexArray(GLOBALS.GLOBJECTS.VAO);
-  glDrawArrays(GL_TRIANGLES, 0, player.points.size());
+      // What's left over in the timestep is how long ago the last tick was due
+      FrameSnapshot& snapshot = GLOBALS.SIM.snapshots.back();
+      captureSnapshot(state, snapshot);
+      snapshot.tickTime = now - timestep.alpha() * timestep.dt;
+      GLOBALS.SIM.snapshots.publish();
 
-  // Draw the light
-  GLOBALS.GLOBJECTS.LIGHT.shader->use();
+      const SimLight& light = state.light;
+      LOG_EVERY(1000, DEBUG, LOG_SIM, "light pos %f, %f, %f", light.x, light.y, light.z);
+    }
 
-  // 3D Stuff
-  glm::mat4 lightModel = glm::mat4(1.0f);
-  lightModel = glm::translate(lightModel, glm::vec3(GLOBALS.GLOBJECTS.LIGHT.x, GLOBALS.GLOBJECTS.LIGHT.y, GLOBALS.GLOBJECTS.LIGHT.z));
-  
-  glm::mat4 lightView = glm::mat4(1.0f);
+    double wait = (1.0 - timestep.alpha()) * timestep.dt - (clockSeconds() - now);
+    if (wait > 0)
+      std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+  }
+}
 
-  glm::mat4 lightProjection = glm::perspective(glm::radians(45.0f), (float) CONSTANTS.WINDOW.WIDTH / CONSTANTS.WINDOW.HEIGHT, 0.1f, 100.0f);
+void draw()
+{
+  // Blend from the snapshot's previous tick towards its latest by how far
+  // we are past the latest. A snapshot that's late holds at the latest.
+  const FrameSnapshot* snapshot = GLOBALS.SIM.snapshots.acquire();
+  float alpha = (float) std::min(std::max((clockSeconds() - snapshot->tickTime) / SimConstants::DT, 0.0), 1.0);
+  blendScene(GLOBALS.GLOBJECTS, *snapshot, alpha);
+  engineGlows(GLOBALS.GLOBJECTS.blended[MESH_SHIP]);
+  drawScene(GLOBALS.GLOBJECTS, *snapshot, alpha);
+
+  PROFILE_SCOPE("swap");
+  SDL_GL_SwapWindow(GLOBALS.GAME.window); // Swap front and back buffers
+}
 
-  // Tell shader this stuff exists
-  unsigned int lightModelLoc = glGetUniformLocation(GLOBALS.GLOBJECTS.LIGHT.shader->id, "model");
-  glUniformMatrix4fv(lightModelLoc, 1, GL_FALSE, glm::value_ptr(lightModel));
+// A point light trailing every ship, as many as the clusters take
+void engineGlows(const EntityTransforms& ships)
+{
+  std::vector<PointLight>& lights = GLOBALS.GLOBJECTS.lights;
+  lights.resize(std::min(ships.x.size(), CLUSTER_MAX_LIGHTS));
+  for (size_t i = 0; i < lights.size(); i++)
+  {
+    PointLight& light = lights[i];
+    light.x = ships.x[i];
+    light.y = ships.y[i] + CONSTANTS.GLOWS.OFFSET_Y;
+    light.z = CONSTANTS.GLOWS.OFFSET_Z;
+    light.radius = CONSTANTS.GLOWS.RADIUS;
+    light.r = CONSTANTS.GLOWS.COLOR[0];
+    light.g = CONSTANTS.GLOWS.COLOR[1];
+    light.b = CONSTANTS.GLOWS.COLOR[2];
+    light.pad = 0.0f;
+  }
+}
 
-  unsigned int lightViewLoc = glGetUniformLocation(GLOBALS.GLOBJECTS.LIGHT.shader->id, "view");
-  glUniformMatrix4fv(lightViewLoc, 1, GL_FALSE, glm::value_ptr(lightView));
+// Shared by the simulation and render threads, for snapshot times
+double clockSeconds()
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
-  unsigned int lightProjectionLoc = glGetUniformLocation(GLOBALS.GLOBJECTS.LIGHT.shader->id, "projection");
-  glUniformMatrix4fv(lightProjectionLoc, 1, GL_FALSE, glm::value_ptr(lightProjection));
+// Records a startup stage that ran from start until now, returns now
+double stage(const char* name, double start)
+{
+  double end = startupTimeline.now();
+  startupTimeline.record(name, start, end);
+  return end;
+}
 
-  glBindVertexArray(GLOBALS.GLOBJECTS.lightVAO);
-  glDrawElements(GL_TRIANGLES, light.indices.size(), GL_UNSIGNED_INT, 0);
+// P starts a capture, pressing it again writes it out
+void toggleProfiler()
+{
+  if (!profiler.enabled())
+  {
+    profiler.enable(true);
+    LOG(INFO, LOG_GAME, "Profiling, P again to stop");
+    return;
+  }
 
-  SDL_GL_SwapWindow(GLOBALS.GAME.window); // Swap front and back buffers
+  profiler.enable(false);
+  profiler.report();
+  if (profiler.write(CONSTANTS.GAME.PROFILE_TRACE))
+    LOG(INFO, LOG_GAME, "Profile written to %s", CONSTANTS.GAME.PROFILE_TRACE);
 }
 
 /* 
  * ========================================
- * Find Normals Utility Function
+ * Instancing Benchmark
  * ========================================
  */
-void findNormals(std::vector<float>& data)
+void benchInstances()
 {
-  for (int i = 0; i < player.points.size(); i += 9 * 3)
-  {
-    glm::vec3 p1(player.points[i], player.points[i + 1], player.points[i + 2]);
-    glm::vec3 p2(player.points[i + 9], player.points[i + 10], player.points[i + 11]);
-    glm::vec3 p3(player.points[i + 18], player.points[i + 19], player.points[i + 20]);
+  static const unsigned int COUNTS[] = { 1, 1000, 10000, 50000, 100000 };
+  static const int FRAMES = 60;
 
-    glm::vec3 U = p2 - p1, V = p3 - p1;
-    glm::vec3 N = U * V;
+  // Don't let the display cap the numbers
+  SDL_GL_SetSwapInterval(0);
 
-    player.points[i + 24] = player.points[i + 15] = player.points[i + 6] = U.y * V.z - U.z - V.y;
-    player.points[i + 25] = player.points[i + 16] = player.points[i + 7] = U.z * V.x - U.x * V.z;
-    player.points[i + 26] = player.points[i + 17] = player.points[i + 8] = U.x * V.y - U.y * V.x;
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<float> spread(-1.0f, 1.0f);
+
+  glm::mat4 view = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -20.0f));
+  GLOBALS.GLOBJECTS.camera->update(view, glm::vec3(0.0f, 5.0f, -20.0f), glm::vec3(1.0f, 1.0f, 1.0f));
+
+  for (unsigned int count : COUNTS)
+  {
+    std::vector<glm::vec3> positions(count);
+    for (glm::vec3& p : positions)
+      p = glm::vec3(spread(random) * 30.0f, spread(random) * 20.0f, spread(random) * 40.0f - 40.0f);
+
+    // Warm up so the stream buffer's growth isn't timed
+    GLOBALS.GLOBJECTS.shader->use();
+    InstanceBatch warmup = GLOBALS.GLOBJECTS.renderer->instances(count);
+    for (unsigned int i = 0; i < warmup.count; i++)
+      warmup.transforms[i] = glm::mat4(1.0f);
+    GLOBALS.GLOBJECTS.renderer->draw(GLOBALS.GLOBJECTS.meshes[MESH_SHIP].lods[0], warmup);
+    GLOBALS.GLOBJECTS.renderer->endFrame();
+    glFinish();
+    GLOBALS.GLOBJECTS.renderer->takeStats();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+      // Spin every ship so transforms change (and stream) every frame
+      float angle = frame * 0.05f;
+      InstanceBatch batch = GLOBALS.GLOBJECTS.renderer->instances(count);
+      for (unsigned int i = 0; i < batch.count; i++)
+        batch.transforms[i] = glm::rotate(glm::translate(glm::mat4(1.0f), positions[i]), angle + i, glm::vec3(0.0f, 0.0f, 1.0f));
+
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      GLOBALS.GLOBJECTS.shader->use();
+      GLOBALS.GLOBJECTS.renderer->draw(GLOBALS.GLOBJECTS.meshes[MESH_SHIP].lods[0], batch);
+      GLOBALS.GLOBJECTS.renderer->endFrame();
+      SDL_GL_SwapWindow(GLOBALS.GAME.window);
+    }
+    glFinish();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    RenderStats stats = GLOBALS.GLOBJECTS.renderer->takeStats();
+    std::cout << count << " instances: " << FRAMES / seconds << " FPS, "
+              << seconds * 1000.0 / FRAMES << " ms/frame, "
+              << stats.drawCalls / FRAMES << " draw calls/frame, "
+              << stats.bytesUploaded / FRAMES / 1024 << " KiB streamed/frame, "
+              << stats.fenceWaits << " fence waits (" << stats.fenceWaitMs << " ms)" << std::endl;
   }
 }
@@ -0,0 +1,532 @@
+#include "mesh.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstring>
+#include <queue>
+#include <utility>
+#include <unordered_map>
+
+/*
+ * ========================================
+ * Helpers
+ * ========================================
+ */
+static glm::vec3 position(const std::vector<float>& positions, unsigned int i)
+{
+  return glm::vec3(positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2]);
+}
+
+// Cross product of two edges, length is twice the triangle's area
+static glm::vec3 faceNormal(const std::vector<float>& positions, const unsigned int* triangle)
+{
+  glm::vec3 p1 = position(positions, triangle[0]);
+  glm::vec3 p2 = position(positions, triangle[1]);
+  glm::vec3 p3 = position(positions, triangle[2]);
+  return glm::cross(p2 - p1, p3 - p1);
+}
+
+static unsigned long long edgeKey(unsigned int a, unsigned int b)
+{
+  if (a > b)
+    std::swap(a, b);
+  return ((unsigned long long) a << 32) | b;
+}
+
+// Does the triangle walk the edge from a to b?
+static bool walksEdge(const unsigned int* triangle, unsigned int a, unsigned int b)
+{
+  for (int k = 0; k < 3; k++)
+  {
+    if (triangle[k] == a && triangle[(k + 1) % 3] == b)
+      return true;
+  }
+  return false;
+}
+
+static void flip(unsigned int* triangle)
+{
+  std::swap(triangle[1], triangle[2]);
+}
+
+/*
+ * ========================================
+ * Orientation
+ * ========================================
+ */
+void orientTriangles(const std::vector<float>& positions, std::vector<unsigned int>& indices)
+{
+  size_t triangleCount = indices.size() / 3;
+
+  std::unordered_map<unsigned long long, std::vector<unsigned int>> edges;
+  for (unsigned int t = 0; t < triangleCount; t++)
+  {
+    for (int k = 0; k < 3; k++)
+      edges[edgeKey(indices[t * 3 + k], indices[t * 3 + (k + 1) % 3])].push_back(t);
+  }
+
+  std::vector<int> component(triangleCount, -1);
+  int components = 0;
+
+  for (unsigned int seed = 0; seed < triangleCount; seed++)
+  {
+    if (component[seed] >= 0)
+      continue;
+
+    /*
+     * Walk across edges shared by exactly two triangles, flipping neighbours
+     * so each shared edge is walked in opposite directions
+     */
+    std::vector<unsigned int> members;
+    std::queue<unsigned int> open;
+    component[seed] = components;
+    open.push(seed);
+
+    while (!open.empty())
+    {
+      unsigned int t = open.front();
+      open.pop();
+      members.push_back(t);
+
+      for (int k = 0; k < 3; k++)
+      {
+        unsigned int a = indices[t * 3 + k];
+        unsigned int b = indices[t * 3 + (k + 1) % 3];
+        const std::vector<unsigned int>& shared = edges[edgeKey(a, b)];
+        if (shared.size() != 2)
+          continue;
+
+        unsigned int other = shared[0] == t ? shared[1] : shared[0];
+        if (component[other] >= 0)
+          continue;
+
+        if (walksEdge(&indices[other * 3], a, b))
+          flip(&indices[other * 3]);
+
+        component[other] = components;
+        open.push(other);
+      }
+    }
+
+    /*
+     * Signed volume about the piece's centre, negative means the whole
+     * piece is wound inside out
+     */
+    glm::vec3 centre(0.0f);
+    for (unsigned int t : members)
+    {
+      for (int k = 0; k < 3; k++)
+        centre += position(positions, indices[t * 3 + k]);
+    }
+    centre /= (float) (members.size() * 3);
+
+    float volume = 0;
+    for (unsigned int t : members)
+    {
+      glm::vec3 p1 = position(positions, indices[t * 3]) - centre;
+      glm::vec3 p2 = position(positions, indices[t * 3 + 1]) - centre;
+      glm::vec3 p3 = position(positions, indices[t * 3 + 2]) - centre;
+      volume += glm::dot(p1, glm::cross(p2, p3));
+    }
+
+    if (volume < 0)
+    {
+      for (unsigned int t : members)
+        flip(&indices[t * 3]);
+    }
+
+    components++;
+  }
+}
+
+/*
+ * ========================================
+ * Welding
+ * ========================================
+ */
+struct VertexKey
+{
+  float v[MESH_STRIDE];
+
+  bool operator==(const VertexKey& other) const
+  {
+    return std::memcmp(v, other.v, sizeof(v)) == 0;
+  }
+};
+
+struct VertexKeyHash
+{
+  size_t operator()(const VertexKey& key) const
+  {
+    // FNV-1a
+    const unsigned char* bytes = (const unsigned char*) key.v;
+    unsigned long long hash = 14695981039346656037ull;
+    for (size_t i = 0; i < sizeof(key.v); i++)
+    {
+      hash ^= bytes[i];
+      hash *= 1099511628211ull;
+    }
+    return (size_t) hash;
+  }
+};
+
+MeshData buildMesh(const std::vector<float>& positions,
+                   const std::vector<unsigned int>& indices,
+                   const std::vector<float>& colors,
+                   NormalMode mode)
+{
+  std::vector<unsigned int> triangles = indices;
+  orientTriangles(positions, triangles);
+
+  size_t triangleCount = triangles.size() / 3;
+
+  MeshData mesh;
+  mesh.indices.reserve(triangles.size());
+
+  std::unordered_map<VertexKey, unsigned int, VertexKeyHash> welded;
+  std::vector<glm::vec3> normals;
+
+  for (size_t t = 0; t < triangleCount; t++)
+  {
+    glm::vec3 weighted = faceNormal(positions, &triangles[t * 3]);
+    float length = glm::length(weighted);
+    glm::vec3 unit = length > 0 ? weighted / length : glm::vec3(0.0f);
+
+    for (int k = 0; k < 3; k++)
+    {
+      glm::vec3 p = position(positions, triangles[t * 3 + k]);
+
+      // + 0.0f folds -0 into 0 so the bitwise compare treats them alike
+      VertexKey key = {};
+      key.v[0] = p.x + 0.0f;
+      key.v[1] = p.y + 0.0f;
+      key.v[2] = p.z + 0.0f;
+      key.v[3] = colors[t * 3] + 0.0f;
+      key.v[4] = colors[t * 3 + 1] + 0.0f;
+      key.v[5] = colors[t * 3 + 2] + 0.0f;
+      if (mode == NormalMode::FLAT)
+      {
+        key.v[6] = unit.x + 0.0f;
+        key.v[7] = unit.y + 0.0f;
+        key.v[8] = unit.z + 0.0f;
+      }
+
+      auto found = welded.find(key);
+      unsigned int index;
+      if (found == welded.end())
+      {
+        index = (unsigned int) normals.size();
+        welded.emplace(key, index);
+        mesh.vertices.insert(mesh.vertices.end(), key.v, key.v + MESH_STRIDE);
+        normals.push_back(glm::vec3(0.0f));
+      }
+      else
+      {
+        index = found->second;
+      }
+
+      // Bigger faces pull smooth normals harder
+      if (mode == NormalMode::FLAT)
+        normals[index] = unit;
+      else
+        normals[index] += weighted;
+
+      mesh.indices.push_back(index);
+    }
+  }
+
+  for (size_t i = 0; i < normals.size(); i++)
+  {
+    float length = glm::length(normals[i]);
+    glm::vec3 n = length > 0 ? normals[i] / length : glm::vec3(0.0f);
+    mesh.vertices[i * MESH_STRIDE + 6] = n.x;
+    mesh.vertices[i * MESH_STRIDE + 7] = n.y;
+    mesh.vertices[i * MESH_STRIDE + 8] = n.z;
+  }
+
+  return mesh;
+}
+
+/*
+ * ========================================
+ * Simplification
+ * ========================================
+ */
+// Open edges get a plane at right angles through them, weighted this much
+// against the faces, so outlines don't shrink away
+static const double BOUNDARY_WEIGHT = 10.0;
+
+// Sum of squared distances to a set of planes, as the symmetric 4x4 matrix
+// of Garland and Heckbert: the 10 distinct entries, row by row
+struct Quadric
+{
+  double q[10] = {};
+
+  Quadric& operator+=(const Quadric& other)
+  {
+    for (int i = 0; i < 10; i++)
+      q[i] += other.q[i];
+    return *this;
+  }
+};
+
+// Squared distance to the plane through point, weighted
+static Quadric planeQuadric(const glm::vec3& normal, const glm::vec3& point, double weight)
+{
+  double a = normal.x, b = normal.y, c = normal.z;
+  double d = -(a * point.x + b * point.y + c * point.z);
+
+  Quadric plane;
+  double terms[10] = { a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d };
+  for (int i = 0; i < 10; i++)
+    plane.q[i] = weight * terms[i];
+  return plane;
+}
+
+static double quadricError(const Quadric& quadric, const glm::vec3& point)
+{
+  const double* q = quadric.q;
+  double x = point.x, y = point.y, z = point.z;
+  return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x
+       + q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y
+       + q[7] * z * z + 2 * q[8] * z
+       + q[9];
+}
+
+static glm::vec3 triangleNormal(const std::vector<glm::vec3>& points, const unsigned int* triangle)
+{
+  return glm::cross(points[triangle[1]] - points[triangle[0]], points[triangle[2]] - points[triangle[0]]);
+}
+
+// Holds the open edge a-b of a triangle facing normal in place
+static void addBoundary(std::vector<Quadric>& quadrics, const std::vector<glm::vec3>& points,
+                        unsigned int a, unsigned int b, const glm::vec3& normal)
+{
+  glm::vec3 along = points[b] - points[a];
+  glm::vec3 side = glm::cross(along, normal);
+  float length = glm::length(side);
+  if (length == 0)
+    return;
+
+  Quadric plane = planeQuadric(side / length, points[a], BOUNDARY_WEIGHT * glm::dot(along, along));
+  quadrics[a] += plane;
+  quadrics[b] += plane;
+}
+
+// Would moving a and b to target turn any triangle round them over?
+static bool collapseFlips(const std::vector<glm::vec3>& points, const std::vector<unsigned int>& indices,
+                          const std::vector<bool>& live, unsigned int a, unsigned int b, const glm::vec3& target)
+{
+  for (size_t t = 0; t < live.size(); t++)
+  {
+    if (!live[t])
+      continue;
+
+    const unsigned int* triangle = &indices[t * 3];
+    int touches = 0;
+    glm::vec3 moved[3];
+    for (int k = 0; k < 3; k++)
+    {
+      bool end = triangle[k] == a || triangle[k] == b;
+      touches += end;
+      moved[k] = end ? target : points[triangle[k]];
+    }
+    // Triangles on the edge itself collapse away
+    if (touches != 1)
+      continue;
+
+    glm::vec3 before = triangleNormal(points, triangle);
+    glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+    if (glm::dot(before, after) <= 0)
+      return true;
+  }
+  return false;
+}
+
+// Area of the triangles on edge a-b, the ones a collapse removes
+static float edgeArea(const std::vector<glm::vec3>& points, const std::vector<unsigned int>& indices,
+                      const std::vector<bool>& live, unsigned int a, unsigned int b)
+{
+  float area = 0;
+  for (size_t t = 0; t < live.size(); t++)
+  {
+    const unsigned int* triangle = &indices[t * 3];
+    bool hasA = triangle[0] == a || triangle[1] == a || triangle[2] == a;
+    bool hasB = triangle[0] == b || triangle[1] == b || triangle[2] == b;
+    if (live[t] && hasA && hasB)
+      area += glm::length(triangleNormal(points, triangle)) / 2;
+  }
+  return area;
+}
+
+static bool sameTriangle(const unsigned int* t1, const unsigned int* t2)
+{
+  unsigned int a[3] = { t1[0], t1[1], t1[2] };
+  unsigned int b[3] = { t2[0], t2[1], t2[2] };
+  std::sort(a, a + 3);
+  std::sort(b, b + 3);
+  return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+}
+
+void simplifyMesh(std::vector<float>& positions, std::vector<unsigned int>& indices,
+                  std::vector<float>& colors, size_t targetTriangles)
+{
+  // The flip test needs every triangle wound the same way
+  orientTriangles(positions, indices);
+
+  size_t vertexCount = positions.size() / 3;
+  size_t triangleCount = indices.size() / 3;
+
+  std::vector<glm::vec3> points(vertexCount);
+  for (size_t i = 0; i < vertexCount; i++)
+    points[i] = position(positions, (unsigned int) i);
+
+  // Every vertex starts with the planes of its faces, bigger faces count more
+  std::vector<Quadric> quadrics(vertexCount);
+  std::unordered_map<unsigned long long, std::vector<unsigned int>> edges;
+  for (unsigned int t = 0; t < triangleCount; t++)
+  {
+    const unsigned int* triangle = &indices[t * 3];
+    glm::vec3 normal = triangleNormal(points, triangle);
+    float length = glm::length(normal);
+    if (length > 0)
+    {
+      Quadric face = planeQuadric(normal / length, points[triangle[0]], length / 2);
+      for (int k = 0; k < 3; k++)
+        quadrics[triangle[k]] += face;
+    }
+
+    for (int k = 0; k < 3; k++)
+      edges[edgeKey(triangle[k], triangle[(k + 1) % 3])].push_back(t);
+  }
+
+  for (const auto& edge : edges)
+  {
+    if (edge.second.size() == 1)
+    {
+      unsigned int a = (unsigned int) (edge.first >> 32), b = (unsigned int) edge.first;
+      addBoundary(quadrics, points, a, b, triangleNormal(points, &indices[edge.second[0] * 3]));
+    }
+  }
+
+  // Greedy, cheapest collapse first. Costs are worked out again after every
+  // collapse, fine for the few hundred triangles models.cpp has.
+  std::vector<bool> live(triangleCount, true);
+  std::vector<unsigned long long> candidates;
+  size_t remaining = triangleCount;
+  while (remaining > targetTriangles)
+  {
+    double bestCost = 0;
+    unsigned int bestA = 0, bestB = 0;
+    glm::vec3 bestTarget;
+    bool found = false;
+
+    // Each edge once, low vertex first, whichever way its triangles walk
+    // it. An open edge only has the one triangle to go by.
+    candidates.clear();
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+      if (!live[t])
+        continue;
+      for (int k = 0; k < 3; k++)
+        candidates.push_back(edgeKey(indices[t * 3 + k], indices[t * 3 + (k + 1) % 3]));
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    for (unsigned long long edge : candidates)
+    {
+      unsigned int a = (unsigned int) (edge >> 32), b = (unsigned int) edge;
+      Quadric quadric = quadrics[a];
+      quadric += quadrics[b];
+      float area = edgeArea(points, indices, live, a, b);
+      glm::vec3 targets[3] = { points[a], points[b], (points[a] + points[b]) * 0.5f };
+      for (const glm::vec3& target : targets)
+      {
+        // Planes alone miss a thin spike sliding flat along its own
+        // faces, so the area swept away is charged by how far it moves
+        glm::vec3 fromA = target - points[a], fromB = target - points[b];
+        double cost = quadricError(quadric, target) + area * (glm::dot(fromA, fromA) + glm::dot(fromB, fromB));
+        if (found && cost >= bestCost)
+          continue;
+        if (collapseFlips(points, indices, live, a, b, target))
+          continue;
+
+        bestCost = cost;
+        bestA = a;
+        bestB = b;
+        bestTarget = target;
+        found = true;
+      }
+    }
+
+    if (!found)
+      break;
+
+    points[bestA] = bestTarget;
+    quadrics[bestA] += quadrics[bestB];
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+      if (!live[t])
+        continue;
+
+      unsigned int* triangle = &indices[t * 3];
+      for (int k = 0; k < 3; k++)
+      {
+        if (triangle[k] == bestB)
+          triangle[k] = bestA;
+      }
+      if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0])
+      {
+        live[t] = false;
+        remaining--;
+      }
+    }
+
+    // A thin piece folded flat leaves two triangles back to back. One of
+    // them is enough, we don't cull back faces, but its edges are open now.
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+      for (size_t u = t + 1; live[t] && u < triangleCount; u++)
+      {
+        if (!live[u] || !sameTriangle(&indices[t * 3], &indices[u * 3]))
+          continue;
+
+        live[u] = false;
+        remaining--;
+        const unsigned int* triangle = &indices[t * 3];
+        glm::vec3 normal = triangleNormal(points, triangle);
+        for (int k = 0; k < 3; k++)
+          addBoundary(quadrics, points, triangle[k], triangle[(k + 1) % 3], normal);
+      }
+    }
+  }
+
+  // Keep what's left, positions renumbered in first use order
+  std::vector<float> keptPositions;
+  std::vector<unsigned int> keptIndices;
+  std::vector<float> keptColors;
+  std::vector<int> renumbered(vertexCount, -1);
+  for (size_t t = 0; t < triangleCount; t++)
+  {
+    if (!live[t])
+      continue;
+
+    for (int k = 0; k < 3; k++)
+    {
+      unsigned int v = indices[t * 3 + k];
+      if (renumbered[v] < 0)
+      {
+        renumbered[v] = (int) (keptPositions.size() / 3);
+        keptPositions.push_back((float) points[v].x);
+        keptPositions.push_back((float) points[v].y);
+        keptPositions.push_back((float) points[v].z);
+      }
+      keptIndices.push_back((unsigned int) renumbered[v]);
+    }
+    keptColors.insert(keptColors.end(), colors.begin() + t * 3, colors.begin() + t * 3 + 3);
+  }
+
+  positions.swap(keptPositions);
+  indices.swap(keptIndices);
+  colors.swap(keptColors);
+}
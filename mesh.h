@@ -0,0 +1,50 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <cstddef>
+#include <vector>
+
+/*
+ * ========================================
+ * Mesh Building
+ * ========================================
+ * Turns source geometry (positions, triangle indices and a colour per
+ * triangle) into an indexed vertex buffer ready for upload.
+ */
+enum class NormalMode
+{
+  FLAT,  // One normal per face, vertices only shared across coplanar faces
+  SMOOTH // Area weighted average of the faces sharing a position and colour
+};
+
+// Interleaved position, colour, normal
+static const int MESH_STRIDE = 9;
+
+struct MeshData
+{
+  std::vector<float> vertices;
+  std::vector<unsigned int> indices;
+
+  unsigned int vertexCount() const { return (unsigned int) (vertices.size() / MESH_STRIDE); }
+};
+
+// positions: 3 floats per vertex, colors: 3 floats per triangle
+MeshData buildMesh(const std::vector<float>& positions,
+                   const std::vector<unsigned int>& indices,
+                   const std::vector<float>& colors,
+                   NormalMode mode);
+
+// Makes winding consistent across shared edges, then faces each connected
+// piece outwards so the cross product gives outward normals
+void orientTriangles(const std::vector<float>& positions, std::vector<unsigned int>& indices);
+
+// Edge collapse down to at most targetTriangles, cheapest first by quadric
+// error (Garland and Heckbert) plus the area it sweeps away, so thin spikes
+// survive, for distant LODs. Each collapse keeps
+// whichever end or the midpoint moves the surface least and never turns a
+// triangle over. Triangles keep their colour, ones that collapse away go
+// with theirs. Unused positions are dropped. Stops early if nothing can go.
+void simplifyMesh(std::vector<float>& positions, std::vector<unsigned int>& indices,
+                  std::vector<float>& colors, size_t targetTriangles);
+
+#endif
@@ -0,0 +1,203 @@
+#include "meshfile.h"
+#include "log.h"
+#include "vertexformat.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * ========================================
+ * Loading
+ * ========================================
+ */
+MeshFile::MeshFile()
+  : mapping(nullptr), size(0)
+{
+}
+
+MeshFile::~MeshFile()
+{
+  close();
+}
+
+bool MeshFile::open(const char* path)
+{
+  close();
+
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    LOG(ERROR, LOG_ASSET, "ERROR::MESHFILE::FILE_NOT_FOUND %s", path);
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(MeshFileHeader))
+  {
+    LOG(ERROR, LOG_ASSET, "ERROR::MESHFILE::TOO_SMALL %s", path);
+    ::close(fd);
+    return false;
+  }
+
+  size = (size_t) info.st_size;
+  // Faulted in here rather than during the upload, which is on the GL thread
+  mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED)
+  {
+    LOG(ERROR, LOG_ASSET, "ERROR::MESHFILE::MAP_FAILED %s", path);
+    mapping = nullptr;
+    size = 0;
+    return false;
+  }
+
+  const MeshFileHeader& h = header();
+  bool valid = h.magic == MESH_FILE_MAGIC && h.version == MESH_FILE_VERSION && h.fileSize == size &&
+               h.attributeCount <= (uint32_t) MESH_MAX_ATTRIBUTES && (h.indexSize == 2 || h.indexSize == 4) &&
+               h.vertexOffset % MESH_FILE_ALIGNMENT == 0 && h.indexOffset % MESH_FILE_ALIGNMENT == 0 &&
+               h.vertexOffset + vertexBytes() <= size && h.indexOffset + indexBytes() <= size;
+  for (uint32_t i = 0; valid && i < h.attributeCount; i++)
+  {
+    const MeshAttribute& attribute = h.attributes[i];
+    MeshAttributeType type = (MeshAttributeType) attribute.type;
+    valid = attribute.type < MESH_TYPE_COUNT && attribute.components >= 1 && attribute.components <= 4 &&
+            attribute.offset + attributeBytes(type, attribute.components) <= h.vertexStride;
+    // GL only takes the packed type as all 4 components, and floats can't
+    // be normalized
+    valid = valid && (type != MESH_INT_2_10_10_10 || attribute.components == 4) &&
+            !(attribute.normalized && (type == MESH_FLOAT32 || type == MESH_FLOAT16));
+  }
+  if (!valid)
+  {
+    LOG(ERROR, LOG_ASSET, "ERROR::MESHFILE::BAD_HEADER %s", path);
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+void MeshFile::close()
+{
+  if (mapping)
+    munmap(mapping, size);
+  mapping = nullptr;
+  size = 0;
+}
+
+/*
+ * ========================================
+ * Writing
+ * ========================================
+ */
+static uint64_t alignUp(uint64_t offset)
+{
+  return (offset + MESH_FILE_ALIGNMENT - 1) / MESH_FILE_ALIGNMENT * MESH_FILE_ALIGNMENT;
+}
+
+static void pad(FILE* file, uint64_t to)
+{
+  static const char ZEROS[MESH_FILE_ALIGNMENT] = {};
+  long at = std::ftell(file);
+  if (at >= 0 && (uint64_t) at < to)
+    std::fwrite(ZEROS, 1, (size_t) (to - at), file);
+}
+
+bool writeMeshFile(const char* path, const MeshFileSource& source)
+{
+  if (source.attributeCount > (uint32_t) MESH_MAX_ATTRIBUTES)
+  {
+    LOG(ERROR, LOG_ASSET, "ERROR::MESHFILE::TOO_MANY_ATTRIBUTES %s", path);
+    return false;
+  }
+
+  MeshFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = MESH_FILE_MAGIC;
+  header.version = MESH_FILE_VERSION;
+  header.vertexCount = source.vertexCount;
+  header.vertexStride = source.vertexStride;
+  header.indexCount = source.indexCount;
+  header.indexSize = source.vertexCount <= 0xFFFF ? 2 : 4;
+  header.attributeCount = source.attributeCount;
+  std::memcpy(header.attributes, source.attributes, sizeof(MeshAttribute) * source.attributeCount);
+
+  // Bounds from the positions
+  const MeshAttribute* position = nullptr;
+  for (uint32_t i = 0; i < source.attributeCount; i++)
+  {
+    if (source.attributes[i].location == 0)
+      position = &source.attributes[i];
+  }
+  if (!position || position->components != 3)
+  {
+    LOG(ERROR, LOG_ASSET, "ERROR::MESHFILE::NO_POSITIONS %s", path);
+    return false;
+  }
+
+  const char* vertices = (const char*) source.vertices;
+  for (int k = 0; k < 3; k++)
+  {
+    header.boundsMin[k] = source.vertexCount ? INFINITY : 0;
+    header.boundsMax[k] = source.vertexCount ? -INFINITY : 0;
+  }
+  // Of the positions as stored, which is what the GPU will draw
+  std::vector<float> positions((size_t) source.vertexCount * 3);
+  for (uint32_t v = 0; v < source.vertexCount; v++)
+  {
+    float* p = &positions[(size_t) v * 3];
+    decodeAttribute((MeshAttributeType) position->type, position->normalized != 0, 3,
+                    vertices + (size_t) v * source.vertexStride + position->offset, p);
+    for (int k = 0; k < 3; k++)
+    {
+      header.boundsMin[k] = std::fmin(header.boundsMin[k], p[k]);
+      header.boundsMax[k] = std::fmax(header.boundsMax[k], p[k]);
+    }
+  }
+  for (int k = 0; k < 3; k++)
+    header.sphereCenter[k] = (header.boundsMin[k] + header.boundsMax[k]) * 0.5f;
+  for (uint32_t v = 0; v < source.vertexCount; v++)
+  {
+    const float* p = &positions[(size_t) v * 3];
+    float dx = p[0] - header.sphereCenter[0];
+    float dy = p[1] - header.sphereCenter[1];
+    float dz = p[2] - header.sphereCenter[2];
+    header.sphereRadius = std::fmax(header.sphereRadius, std::sqrt(dx * dx + dy * dy + dz * dz));
+  }
+
+  header.vertexOffset = alignUp(sizeof(MeshFileHeader));
+  header.indexOffset = alignUp(header.vertexOffset + (uint64_t) source.vertexCount * source.vertexStride);
+  header.fileSize = header.indexOffset + (uint64_t) source.indexCount * header.indexSize;
+
+  FILE* file = std::fopen(path, "wb");
+  if (!file)
+  {
+    LOG(ERROR, LOG_ASSET, "ERROR::MESHFILE::CANNOT_WRITE %s", path);
+    return false;
+  }
+
+  std::fwrite(&header, sizeof(header), 1, file);
+  pad(file, header.vertexOffset);
+  std::fwrite(source.vertices, source.vertexStride, source.vertexCount, file);
+  pad(file, header.indexOffset);
+  if (header.indexSize == 2)
+  {
+    std::vector<uint16_t> shortIndices(source.indices, source.indices + source.indexCount);
+    std::fwrite(shortIndices.data(), sizeof(uint16_t), shortIndices.size(), file);
+  }
+  else
+  {
+    std::fwrite(source.indices, sizeof(uint32_t), source.indexCount, file);
+  }
+
+  bool written = std::ferror(file) == 0;
+  written = std::fclose(file) == 0 && written;
+  if (!written)
+    LOG(ERROR, LOG_ASSET, "ERROR::MESHFILE::CANNOT_WRITE %s", path);
+  return written;
+}
@@ -0,0 +1,118 @@
+#ifndef MESHFILE_H
+#define MESHFILE_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * ========================================
+ * Mesh Files
+ * ========================================
+ * Baked meshes in res/meshes, written by assetc. The layout is exactly
+ * what glBufferData wants, so the game maps the file and uploads straight
+ * from the mapping: no parsing, no per-vertex allocation.
+ *
+ *   MeshFileHeader
+ *   vertex blob, interleaved as the attributes describe
+ *   index blob, 16 bit when the vertices fit, else 32 bit
+ *
+ * Blobs start on MESH_FILE_ALIGNMENT boundaries. Everything is little
+ * endian, the only byte order we ship on.
+ */
+static const uint32_t MESH_FILE_MAGIC = 0x48534D41; // "AMSH"
+static const uint32_t MESH_FILE_VERSION = 2;
+static const uint32_t MESH_FILE_ALIGNMENT = 64;
+static const int MESH_MAX_ATTRIBUTES = 8;
+
+// How an attribute is stored, see vertexformat.h for packing them
+enum MeshAttributeType : uint32_t
+{
+  MESH_FLOAT32 = 0,
+  MESH_FLOAT16,
+  MESH_INT16,
+  MESH_UINT8,
+  MESH_INT_2_10_10_10, // x, y, z in 10 bits each and w in 2, always 4 components
+  MESH_TYPE_COUNT
+};
+
+struct MeshAttribute
+{
+  uint32_t location;   // Shader attribute location
+  uint32_t components; // 1 to 4
+  uint32_t type;       // MeshAttributeType
+  uint32_t normalized; // Integers read as [0, 1] or [-1, 1] rather than as is
+  uint32_t offset;     // Bytes from the start of the vertex
+};
+
+struct MeshFileHeader
+{
+  uint32_t magic;
+  uint32_t version;
+
+  uint32_t vertexCount;
+  uint32_t vertexStride; // Bytes
+  uint32_t indexCount;
+  uint32_t indexSize;    // 2 or 4 bytes
+  uint32_t attributeCount;
+  uint32_t reserved;
+  MeshAttribute attributes[MESH_MAX_ATTRIBUTES];
+
+  // Bounds of the location 0 attribute, which is always the position
+  float boundsMin[3];
+  float boundsMax[3];
+  float sphereCenter[3];
+  float sphereRadius;
+
+  uint64_t vertexOffset;
+  uint64_t indexOffset;
+  uint64_t fileSize;
+};
+
+static_assert(sizeof(MeshFileHeader) % 8 == 0, "mesh file header must stay 8 byte aligned");
+
+/*
+ * A read-only mapping of one .mesh file. Pointers stay valid until close()
+ * or destruction.
+ */
+class MeshFile
+{
+public:
+  MeshFile();
+  ~MeshFile();
+  MeshFile(const MeshFile&) = delete;
+  MeshFile& operator=(const MeshFile&) = delete;
+
+  // Maps, pages in and validates the file, false (with an error printed) if
+  // it's bad. Safe on any thread.
+  bool open(const char* path);
+  void close();
+
+  const MeshFileHeader& header() const { return *(const MeshFileHeader*) mapping; }
+  const void* vertices() const { return (const char*) mapping + header().vertexOffset; }
+  const void* indices() const { return (const char*) mapping + header().indexOffset; }
+  size_t vertexBytes() const { return (size_t) header().vertexCount * header().vertexStride; }
+  size_t indexBytes() const { return (size_t) header().indexCount * header().indexSize; }
+
+private:
+  void* mapping;
+  size_t size;
+};
+
+/*
+ * What assetc hands the writer. Positions must be 3 components at
+ * location 0, of any type.
+ */
+struct MeshFileSource
+{
+  const void* vertices;
+  uint32_t vertexCount;
+  uint32_t vertexStride;
+  const MeshAttribute* attributes;
+  uint32_t attributeCount;
+  const uint32_t* indices;
+  uint32_t indexCount;
+};
+
+bool writeMeshFile(const char* path, const MeshFileSource& source);
+
+#endif
@@ -0,0 +1,145 @@
+#include "models.h"
+#include <cmath>
+
+/*
+ * ========================================
+ * Ship
+ * ========================================
+ */
+static const float SHIP_POSITIONS[] = {
+    -1.000f,  0.000f,  0.000f,
+     1.000f,  0.000f,  0.000f,
+     0.000f, -0.500f, -0.250f,
+    -0.750f,  1.000f,  0.000f,
+     0.000f,  1.000f,  0.000f,
+     0.750f,  1.000f,  0.000f,
+     0.000f,  0.600f,  2.000f,
+     0.000f,  0.250f, -6.000f,
+    -2.000f,  0.000f,  0.000f,
+    -1.750f,  0.750f, -1.000f,
+    -1.500f,  4.000f,  2.000f,
+    -1.500f, -1.000f,  0.000f,
+    -4.000f, -1.250f,  5.000f,
+     2.000f,  0.000f,  0.000f,
+     1.750f,  0.750f, -1.000f,
+     1.500f,  4.000f,  2.000f,
+     1.500f, -1.000f,  0.000f,
+     4.000f, -1.250f,  5.000f
+};
+
+static const float SHIP_COLORS[] = {
+    1.00f, 1.00f, 1.00f,
+    1.00f, 1.00f, 1.00f,
+    1.00f, 1.00f, 1.00f,
+    1.00f, 1.00f, 1.00f,
+    1.00f, 1.00f, 1.00f,
+    1.00f, 1.00f, 1.00f,
+    1.00f, 1.00f, 1.00f,
+    1.00f, 1.00f, 1.00f,
+    1.00f, 1.00f, 1.00f,
+    1.00f, 1.00f, 1.00f,
+    0.00f, 0.55f, 0.96f,
+    0.00f, 0.55f, 0.96f,
+    0.00f, 0.55f, 0.96f,
+    0.00f, 0.55f, 0.96f,
+    0.00f, 0.55f, 0.96f,
+    0.00f, 0.55f, 0.96f,
+    0.00f, 0.55f, 0.96f,
+    0.00f, 0.55f, 0.96f,
+    0.00f, 0.55f, 0.96f,
+    0.00f, 0.55f, 0.96f,
+    0.00f, 0.55f, 0.96f,
+    0.00f, 0.55f, 0.96f,
+    0.00f, 0.55f, 0.96f,
+    0.00f, 0.55f, 0.96f,
+    0.00f, 0.55f, 0.96f,
+    0.00f, 0.55f, 0.96f
+};
+
+static const unsigned int SHIP_INDICES[] = {
+    0, 1, 2,
+    0, 3, 6,
+    3, 4, 6,
+    4, 5, 6,
+    5, 1, 6,
+    0, 3, 7,
+    3, 5, 7,
+    5, 1, 7,
+    0, 2, 7,
+    1, 2, 7,
+    0, 8, 10,
+    8, 9, 10,
+    9, 0, 10,
+    0, 8, 9,
+    0, 11, 12,
+    0, 8, 12,
+    8, 11, 12,
+    0, 8, 11,
+    1, 13, 15,
+    13, 14, 15,
+    14, 1, 15,
+    1, 13, 14,
+    1, 16, 17,
+    1, 13, 17,
+    13, 16, 17,
+    1, 13, 16
+};
+
+const ModelGeometry SHIP_MODEL = {
+  SHIP_POSITIONS, sizeof(SHIP_POSITIONS) / sizeof(float),
+  SHIP_COLORS,
+  SHIP_INDICES, sizeof(SHIP_INDICES) / sizeof(unsigned int)
+};
+
+/*
+ * ========================================
+ * Light Source
+ * ========================================
+ */
+static const float LIGHT_POSITIONS[] = {
+    -1.0f, -1.0f,  1.0f,
+     1.0f, -1.0f,  1.0f,
+    -1.0f,  1.0f,  1.0f,
+     1.0f,  1.0f,  1.0f,
+    -1.0f, -1.0f, -1.0f,
+     1.0f, -1.0f, -1.0f,
+    -1.0f,  1.0f, -1.0f,
+     1.0f,  1.0f, -1.0f
+};
+
+static const unsigned int LIGHT_INDICES[] = {
+    0, 1, 2,
+    2, 1, 3,
+
+    4, 0, 6,
+    6, 0, 2,
+
+    5, 1, 7,
+    7, 1, 3,
+
+    4, 5, 6,
+    6, 5, 7,
+
+    6, 7, 2,
+    2, 7, 3,
+
+    4, 5, 0,
+    0, 5, 1
+};
+
+const ModelGeometry LIGHT_MODEL = {
+  LIGHT_POSITIONS, sizeof(LIGHT_POSITIONS) / sizeof(float),
+  nullptr,
+  LIGHT_INDICES, sizeof(LIGHT_INDICES) / sizeof(unsigned int)
+};
+
+float boundingRadius(const ModelGeometry& model)
+{
+  float radius = 0;
+  for (size_t i = 0; i + 2 < model.positionCount; i += 3)
+  {
+    const float* p = &model.positions[i];
+    radius = std::fmax(radius, std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]));
+  }
+  return radius;
+}
@@ -0,0 +1,31 @@
+#ifndef MODELS_H
+#define MODELS_H
+
+#include <cstddef>
+
+/*
+ * ========================================
+ * Models
+ * ========================================
+ * Hand made source geometry, as plain static arrays so nothing is copied
+ * at startup. assetc bakes it into res/meshes for the renderer; gameplay
+ * reads the ship's bounds straight from here.
+ */
+struct ModelGeometry
+{
+  // Positions, 3 floats each, indexed by the triangles below
+  const float* positions;
+  size_t positionCount; // In floats
+  // One colour per triangle, nullptr for uncoloured models
+  const float* colors;
+  const unsigned int* indices;
+  size_t indexCount;
+};
+
+extern const ModelGeometry SHIP_MODEL;
+extern const ModelGeometry LIGHT_MODEL;
+
+// Radius of the smallest sphere around the model origin holding every vertex
+float boundingRadius(const ModelGeometry& model);
+
+#endif
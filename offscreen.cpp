@@ -0,0 +1,293 @@
+#include <GL/glew.h>
+#include "offscreen.h"
+#include <EGL/eglext.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "log.h"
+
+/*
+ * ========================================
+ * Offscreen Context
+ * ========================================
+ */
+OffscreenContext::OffscreenContext()
+  : width(0), height(0), display(EGL_NO_DISPLAY), context(EGL_NO_CONTEXT), surface(EGL_NO_SURFACE),
+    framebuffer(0), colorBuffer(0), depthBuffer(0)
+{
+}
+
+OffscreenContext::~OffscreenContext()
+{
+  destroy();
+}
+
+// Surfaceless needs EGL_MESA_platform_surfaceless, looked up at run time so
+// this still links against an EGL 1.4 loader
+static EGLDisplay surfacelessDisplay()
+{
+  const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  if (!extensions || !std::strstr(extensions, "EGL_MESA_platform_surfaceless"))
+    return EGL_NO_DISPLAY;
+
+  auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+  if (!getPlatformDisplay)
+    return EGL_NO_DISPLAY;
+  return getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+}
+
+bool OffscreenContext::create(int w, int h)
+{
+  width = w;
+  height = h;
+
+  EGLint major, minor;
+  display = surfacelessDisplay();
+  bool surfaceless = display != EGL_NO_DISPLAY && eglInitialize(display, &major, &minor);
+  if (!surfaceless)
+  {
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+    {
+      LOG(ERROR, LOG_RENDER, "ERROR::OFFSCREEN::NO_EGL_DISPLAY");
+      display = EGL_NO_DISPLAY;
+      return false;
+    }
+  }
+
+  if (!eglBindAPI(EGL_OPENGL_API))
+  {
+    LOG(ERROR, LOG_RENDER, "ERROR::OFFSCREEN::NO_DESKTOP_GL");
+    return false;
+  }
+
+  // Nothing is drawn to the surface itself, the pbuffer only has to exist
+  const EGLint configAttributes[] = {
+    EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_NONE
+  };
+  EGLConfig config;
+  EGLint configs = 0;
+  if (!eglChooseConfig(display, configAttributes, &config, 1, &configs) || configs == 0)
+  {
+    LOG(ERROR, LOG_RENDER, "ERROR::OFFSCREEN::NO_EGL_CONFIG");
+    return false;
+  }
+
+  const EGLint contextAttributes[] = {
+    EGL_CONTEXT_MAJOR_VERSION, 3,
+    EGL_CONTEXT_MINOR_VERSION, 3,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+    EGL_NONE
+  };
+  context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+  if (context == EGL_NO_CONTEXT)
+  {
+    LOG(ERROR, LOG_RENDER, "ERROR::OFFSCREEN::CONTEXT_CREATION_FAILED 0x%x", eglGetError());
+    return false;
+  }
+
+  if (!surfaceless)
+  {
+    const EGLint surfaceAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+    surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+  }
+  if (!eglMakeCurrent(display, surface, surface, context))
+  {
+    LOG(ERROR, LOG_RENDER, "ERROR::OFFSCREEN::MAKE_CURRENT_FAILED 0x%x", eglGetError());
+    return false;
+  }
+
+  // Core profile entry points aren't all in the extension string, and GLEW
+  // built for GLX complains there's no X display after loading them anyway
+  glewExperimental = GL_TRUE;
+  GLenum glew = glewInit();
+  if (glew != GLEW_OK && glew != GLEW_ERROR_NO_GLX_DISPLAY)
+  {
+    LOG(ERROR, LOG_RENDER, "ERROR::GLEW::INITIALIZATION_FAILED %s", glewGetErrorString(glew));
+    return false;
+  }
+  glGetError(); // glewExperimental leaves GL_INVALID_ENUM behind
+
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+  glGenRenderbuffers(1, &colorBuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+
+  glGenRenderbuffers(1, &depthBuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+  {
+    LOG(ERROR, LOG_RENDER, "ERROR::OFFSCREEN::FRAMEBUFFER_INCOMPLETE");
+    return false;
+  }
+
+  glViewport(0, 0, width, height);
+  return true;
+}
+
+void OffscreenContext::destroy()
+{
+  if (display == EGL_NO_DISPLAY)
+    return;
+
+  // Only made once GLEW is loaded and the context current, create() can
+  // fail before either
+  if (depthBuffer)
+    glDeleteRenderbuffers(1, &depthBuffer);
+  if (colorBuffer)
+    glDeleteRenderbuffers(1, &colorBuffer);
+  if (framebuffer)
+    glDeleteFramebuffers(1, &framebuffer);
+  depthBuffer = colorBuffer = framebuffer = 0;
+
+  if (context != EGL_NO_CONTEXT)
+  {
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(display, context);
+  }
+  if (surface != EGL_NO_SURFACE)
+    eglDestroySurface(display, surface);
+  eglTerminate(display);
+
+  display = EGL_NO_DISPLAY;
+  context = EGL_NO_CONTEXT;
+  surface = EGL_NO_SURFACE;
+}
+
+const char* OffscreenContext::renderer() const
+{
+  const char* name = (const char*) glGetString(GL_RENDERER);
+  return name ? name : "unknown";
+}
+
+void OffscreenContext::readPixels(std::vector<uint8_t>& rgba)
+{
+  size_t row = (size_t) width * 4;
+  rgba.resize(row * height);
+
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+
+  // GL's first row is the bottom one
+  std::vector<uint8_t> swap(row);
+  for (int y = 0; y < height / 2; y++)
+  {
+    uint8_t* top = &rgba[y * row];
+    uint8_t* bottom = &rgba[(height - 1 - y) * row];
+    std::memcpy(swap.data(), top, row);
+    std::memcpy(top, bottom, row);
+    std::memcpy(bottom, swap.data(), row);
+  }
+}
+
+/*
+ * ========================================
+ * PNG
+ * ========================================
+ * Just enough of the format for readbacks: one IDAT of zlib stored
+ * (uncompressed) deflate blocks, every row with filter type 0.
+ */
+static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size)
+{
+  static uint32_t table[256];
+  if (!table[1])
+  {
+    for (uint32_t n = 0; n < 256; n++)
+    {
+      uint32_t c = n;
+      for (int k = 0; k < 8; k++)
+        c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      table[n] = c;
+    }
+  }
+
+  crc = ~crc;
+  for (size_t i = 0; i < size; i++)
+    crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+static void putBigEndian(std::vector<uint8_t>& out, uint32_t value)
+{
+  out.push_back(value >> 24);
+  out.push_back(value >> 16);
+  out.push_back(value >> 8);
+  out.push_back(value);
+}
+
+static void putChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data)
+{
+  putBigEndian(out, (uint32_t) data.size());
+  size_t start = out.size();
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), data.begin(), data.end());
+  putBigEndian(out, crc32(0, &out[start], out.size() - start));
+}
+
+bool writePng(const char* path, int width, int height, const uint8_t* rgba)
+{
+  static const size_t STORED_BLOCK = 65535;
+
+  // Filter byte then the row, for every row
+  size_t row = (size_t) width * 4;
+  std::vector<uint8_t> raw;
+  raw.reserve((row + 1) * height);
+  for (int y = 0; y < height; y++)
+  {
+    raw.push_back(0);
+    raw.insert(raw.end(), rgba + y * row, rgba + (y + 1) * row);
+  }
+
+  std::vector<uint8_t> header;
+  putBigEndian(header, width);
+  putBigEndian(header, height);
+  header.push_back(8); // Bit depth
+  header.push_back(6); // RGBA
+  header.push_back(0); // Deflate
+  header.push_back(0); // Adaptive filtering
+  header.push_back(0); // Not interlaced
+
+  std::vector<uint8_t> zlib = { 0x78, 0x01 };
+  uint32_t a = 1, b = 0; // Adler-32
+  for (size_t offset = 0; offset < raw.size(); offset += STORED_BLOCK)
+  {
+    size_t size = std::min(STORED_BLOCK, raw.size() - offset);
+    zlib.push_back(offset + size == raw.size() ? 1 : 0);
+    zlib.push_back(size & 0xFF);
+    zlib.push_back(size >> 8);
+    zlib.push_back(~size & 0xFF);
+    zlib.push_back((~size >> 8) & 0xFF);
+    zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+
+    for (size_t i = offset; i < offset + size; i++)
+    {
+      a = (a + raw[i]) % 65521;
+      b = (b + a) % 65521;
+    }
+  }
+  putBigEndian(zlib, b << 16 | a);
+
+  static const uint8_t SIGNATURE[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+  std::vector<uint8_t> png(SIGNATURE, SIGNATURE + sizeof(SIGNATURE));
+  putChunk(png, "IHDR", header);
+  putChunk(png, "IDAT", zlib);
+  putChunk(png, "IEND", {});
+
+  FILE* file = std::fopen(path, "wb");
+  if (!file)
+  {
+    LOG(ERROR, LOG_RENDER, "ERROR::PNG::CANNOT_WRITE %s", path);
+    return false;
+  }
+  bool written = std::fwrite(png.data(), 1, png.size(), file) == png.size();
+  return std::fclose(file) == 0 && written;
+}
@@ -0,0 +1,49 @@
+#ifndef OFFSCREEN_H
+#define OFFSCREEN_H
+
+#include <EGL/egl.h>
+#include <cstdint>
+#include <vector>
+
+/*
+ * ========================================
+ * Offscreen Context
+ * ========================================
+ * A GL 3.3 core context without a window or display, for build servers.
+ * Asks EGL for a surfaceless display first (Mesa, llvmpipe does fine) and
+ * falls back to a pbuffer on the default one. Either way everything is
+ * drawn into an FBO of the requested size, which create() leaves bound
+ * with the viewport set, so the game's draw code runs unchanged.
+ */
+class OffscreenContext
+{
+public:
+  OffscreenContext();
+  ~OffscreenContext();
+
+  // Makes the context current and loads GL through GLEW, false on failure
+  bool create(int width, int height);
+  void destroy();
+
+  // What the driver calls itself, "llvmpipe (LLVM ...)" on the CPU
+  const char* renderer() const;
+
+  // Top row first, width * height RGBA bytes
+  void readPixels(std::vector<uint8_t>& rgba);
+
+  int width;
+  int height;
+
+private:
+  EGLDisplay display;
+  EGLContext context;
+  EGLSurface surface; // Only for the pbuffer fallback
+  unsigned int framebuffer;
+  unsigned int colorBuffer;
+  unsigned int depthBuffer;
+};
+
+// 8-bit RGBA, top row first. Stored uncompressed, it's for checking frames.
+bool writePng(const char* path, int width, int height, const uint8_t* rgba);
+
+#endif
@@ -0,0 +1,169 @@
+#include "pacing.h"
+#include "log.h"
+#include <cmath>
+#include <cstring>
+#include <ctime>
+
+// SDL_Delay only has millisecond resolution and the OS may oversleep, so
+// stop sleeping this long before the deadline and spin the rest
+static const double SPIN_MS = 1.5;
+
+static double cpuMs(clockid_t clock)
+{
+  timespec time;
+  clock_gettime(clock, &time);
+  return time.tv_sec * 1e3 + time.tv_nsec / 1e6;
+}
+
+FramePacer::FramePacer(double fps, PacingMode mode)
+  : currentMode(mode),
+    frequency((double) SDL_GetPerformanceFrequency()),
+    period(frequency / fps),
+    deadline(0),
+    lastFrame(0),
+    lastCpu(0),
+    lastProcessCpu(0),
+    frames(0),
+    mean(0),
+    m2(0),
+    worst(0),
+    cpuTotal(0),
+    processCpuTotal(0)
+{
+  // Needs the GL context to exist already
+  if (currentMode == PacingMode::VSYNC)
+  {
+    if (SDL_GL_SetSwapInterval(1) != 0)
+    {
+      LOG(WARN, LOG_GAME, "WARNING::PACING::VSYNC_UNAVAILABLE, falling back to sleep");
+      currentMode = PacingMode::SLEEP_SPIN;
+    }
+  }
+
+  if (currentMode != PacingMode::VSYNC)
+    SDL_GL_SetSwapInterval(0);
+}
+
+void FramePacer::beginFrame()
+{
+  Uint64 now = SDL_GetPerformanceCounter();
+  double cpu = cpuMs(CLOCK_THREAD_CPUTIME_ID);
+  double processCpu = cpuMs(CLOCK_PROCESS_CPUTIME_ID);
+
+  if (lastFrame == 0)
+  {
+    deadline = (double) now;
+  }
+  else
+  {
+    double ms = toMs(now - lastFrame);
+
+    frames++;
+    double delta = ms - mean;
+    mean += delta / frames;
+    m2 += delta * (ms - mean);
+    if (ms > worst)
+      worst = ms;
+
+    cpuTotal += cpu - lastCpu;
+    processCpuTotal += processCpu - lastProcessCpu;
+  }
+
+  lastFrame = now;
+  lastCpu = cpu;
+  lastProcessCpu = processCpu;
+}
+
+void FramePacer::wait(void (*handleEvent)(const SDL_Event&))
+{
+  // The swap already waited for the display
+  if (currentMode == PacingMode::VSYNC)
+    return;
+
+  deadline += period;
+
+  double now = (double) SDL_GetPerformanceCounter();
+  if (now - deadline > period)
+  {
+    // More than a frame late, start a fresh schedule instead of rushing
+    deadline = now;
+    return;
+  }
+
+  if (currentMode == PacingMode::SLEEP_SPIN)
+  {
+    double remaining = (deadline - now) * 1000.0 / frequency;
+    if (remaining > SPIN_MS)
+      SDL_Delay((Uint32) (remaining - SPIN_MS));
+
+    while ((double) SDL_GetPerformanceCounter() < deadline)
+    {
+    }
+  }
+  else
+  {
+    SDL_Event e;
+    while ((now = (double) SDL_GetPerformanceCounter()) < deadline)
+    {
+      int timeout = (int) ((deadline - now) * 1000.0 / frequency);
+
+      // Under a millisecond left, WaitEventTimeout can't express that
+      if (timeout <= 0)
+      {
+        if (SDL_PollEvent(&e))
+          handleEvent(e);
+        continue;
+      }
+
+      if (SDL_WaitEventTimeout(&e, timeout))
+        handleEvent(e);
+    }
+  }
+}
+
+PacingMode FramePacer::mode() const
+{
+  return currentMode;
+}
+
+PacingStats FramePacer::stats() const
+{
+  PacingStats stats;
+  stats.frames = frames;
+  stats.frameMs = mean;
+  stats.jitterMs = frames > 1 ? std::sqrt(m2 / (frames - 1)) : 0;
+  stats.worstMs = worst;
+  stats.cpuMs = frames > 0 ? cpuTotal / frames : 0;
+  stats.cpuLoad = mean > 0 ? stats.cpuMs / mean : 0;
+  stats.processCpuMs = frames > 0 ? processCpuTotal / frames : 0;
+  return stats;
+}
+
+void FramePacer::report() const
+{
+  static const char* names[] = { "vsync", "sleep", "wait" };
+
+  PacingStats s = stats();
+  LOG(INFO, LOG_GAME, "Pacing (%s): %llu frames, %g ms/frame, jitter %g ms, worst %g ms, "
+      "render thread CPU %g ms/frame (%g%% of a core), process CPU %g ms/frame",
+      names[(int) currentMode], s.frames, s.frameMs, s.jitterMs, s.worstMs, s.cpuMs, s.cpuLoad * 100,
+      s.processCpuMs);
+}
+
+double FramePacer::toMs(Uint64 ticks) const
+{
+  return (double) ticks * 1000.0 / frequency;
+}
+
+bool parsePacingMode(const char* name, PacingMode& mode)
+{
+  if (std::strcmp(name, "vsync") == 0)
+    mode = PacingMode::VSYNC;
+  else if (std::strcmp(name, "sleep") == 0)
+    mode = PacingMode::SLEEP_SPIN;
+  else if (std::strcmp(name, "wait") == 0)
+    mode = PacingMode::WAIT_EVENT;
+  else
+    return false;
+  return true;
+}
@@ -0,0 +1,72 @@
+#ifndef PACING_H
+#define PACING_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * ========================================
+ * Frame Pacing
+ * ========================================
+ * Waits out the rest of each frame without burning a core, using absolute
+ * deadlines from the performance counter so frames don't drift.
+ */
+enum class PacingMode
+{
+  VSYNC,      // Let SDL_GL_SwapWindow block on the display
+  SLEEP_SPIN, // SDL_Delay most of the wait, spin the last bit
+  WAIT_EVENT  // Sleep in SDL_WaitEventTimeout, handling input as it arrives
+};
+
+struct PacingStats
+{
+  unsigned long long frames = 0;
+  double frameMs = 0;  // Mean time between frames
+  double jitterMs = 0; // Standard deviation of the time between frames
+  double worstMs = 0;  // Longest frame
+  // Mean CPU time per frame of the thread calling beginFrame(), the one
+  // that renders and waits. The simulation ticks on threads of its own.
+  double cpuMs = 0;
+  double cpuLoad = 0; // cpuMs / frameMs, how busy it keeps its core
+  // Every thread of the process, simulation and job workers included
+  double processCpuMs = 0;
+};
+
+class FramePacer
+{
+public:
+  FramePacer(double fps, PacingMode mode);
+
+  // Call once at the top of every frame
+  void beginFrame();
+  // Wait for the next frame deadline. Events that arrive while waiting are
+  // passed to handleEvent (only WAIT_EVENT delivers them here).
+  void wait(void (*handleEvent)(const SDL_Event&));
+
+  PacingMode mode() const;
+  PacingStats stats() const;
+  void report() const;
+
+private:
+  double toMs(Uint64 ticks) const;
+
+  PacingMode currentMode;
+  double frequency;
+  double period; // In performance counter ticks
+  double deadline;
+
+  Uint64 lastFrame;
+  double lastCpu;
+  double lastProcessCpu;
+
+  // Running frame time statistics (Welford)
+  unsigned long long frames;
+  double mean;
+  double m2;
+  double worst;
+  double cpuTotal;
+  double processCpuTotal;
+};
+
+bool parsePacingMode(const char* name, PacingMode& mode);
+
+#endif
@@ -0,0 +1,250 @@
+#include "profiler.h"
+#include "log.h"
+#include <chrono>
+#include <cstdio>
+
+Profiler profiler;
+
+static const int GPU_TRACK = 1000;
+
+static int64_t clockNs()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static const char* counterName(int counter)
+{
+  switch (counter)
+  {
+  case COUNTER_DRAW_CALLS:
+    return "draw calls";
+  case COUNTER_UNIFORMS:
+    return "uniforms";
+  case COUNTER_SNAPSHOT_WAITS:
+    return "snapshot waits";
+  case COUNTER_VISIBLE:
+    return "visible";
+  case COUNTER_CULLED:
+    return "culled";
+  case COUNTER_STATE_CHANGES:
+    return "state changes";
+  case COUNTER_STATE_SKIPPED:
+    return "state changes avoided";
+  case COUNTER_LIGHTS:
+    return "lights";
+  case COUNTER_LIGHT_ENTRIES:
+    return "cluster light entries";
+  case COUNTER_UPLOAD_BYTES:
+  default:
+    return "upload bytes";
+  }
+}
+
+/*
+ * ========================================
+ * Profiler
+ * ========================================
+ */
+Profiler::Profiler()
+  : on(false), capture(0), zero(clockNs()), frameStart(0)
+{
+  gpu = new Ring();
+  gpu->name = "GPU";
+  gpu->id = GPU_TRACK;
+  gpu->capture = 0;
+  gpu->written = 0;
+
+  for (int i = 0; i < COUNTER_COUNT; i++)
+    counters[i] = 0;
+}
+
+Profiler::~Profiler()
+{
+  for (Ring* ring : rings)
+    delete ring;
+  delete gpu;
+}
+
+int64_t Profiler::now() const
+{
+  return clockNs() - zero;
+}
+
+void Profiler::enable(bool enable)
+{
+  if (enable == enabled())
+    return;
+
+  if (enable)
+  {
+    // Other threads may still be pushing, each ring resets itself
+    capture.fetch_add(1, std::memory_order_relaxed);
+    for (int i = 0; i < COUNTER_COUNT; i++)
+      counters[i] = 0;
+    frames.clear();
+    frameStart = now();
+  }
+
+  on.store(enable, std::memory_order_relaxed);
+}
+
+Profiler::Ring* Profiler::makeRing(const std::string& name)
+{
+  Ring* ring = new Ring();
+  ring->name = name;
+  ring->capture = 0;
+  ring->written = 0;
+
+  std::lock_guard<std::mutex> guard(lock);
+  ring->id = (int) rings.size();
+  rings.push_back(ring);
+  return ring;
+}
+
+Profiler::Ring* Profiler::ring()
+{
+  thread_local Ring* local = nullptr;
+  if (!local)
+    local = makeRing("thread");
+  return local;
+}
+
+void Profiler::push(Ring* ring, const ProfileEvent& event)
+{
+  // Only the owning thread writes. Starting over is published by the
+  // release on capture, the events by the release on written.
+  uint64_t current = capture.load(std::memory_order_relaxed);
+  if (ring->capture.load(std::memory_order_relaxed) != current)
+  {
+    ring->written.store(0, std::memory_order_relaxed);
+    ring->capture.store(current, std::memory_order_release);
+  }
+
+  uint64_t index = ring->written.load(std::memory_order_relaxed);
+  ring->events[index % PROFILE_RING_EVENTS] = event;
+  ring->written.store(index + 1, std::memory_order_release);
+}
+
+uint64_t Profiler::captured(const Ring* ring) const
+{
+  if (ring->capture.load(std::memory_order_acquire) != capture.load(std::memory_order_relaxed))
+    return 0;
+  return ring->written.load(std::memory_order_acquire);
+}
+
+void Profiler::record(const char* name, int64_t startNs, int64_t endNs)
+{
+  push(ring(), { name, startNs, endNs });
+}
+
+void Profiler::recordGpu(const char* name, int64_t startNs, int64_t endNs)
+{
+  push(gpu, { name, startNs, endNs });
+}
+
+void Profiler::nameThread(const char* name)
+{
+  ring()->name = name;
+}
+
+void Profiler::endFrame()
+{
+  if (!enabled())
+    return;
+
+  ProfileFrame frame;
+  frame.startNs = frameStart;
+  frame.endNs = now();
+  for (int i = 0; i < COUNTER_COUNT; i++)
+    frame.counters[i] = counters[i].exchange(0, std::memory_order_relaxed);
+
+  if (frames.size() == PROFILE_HISTORY_FRAMES)
+    frames.pop_front();
+  frames.push_back(frame);
+  frameStart = frame.endNs;
+}
+
+/*
+ * ========================================
+ * Export
+ * ========================================
+ */
+bool Profiler::write(const char* path)
+{
+  FILE* file = std::fopen(path, "w");
+  if (!file)
+  {
+    LOG(ERROR, LOG_GAME, "ERROR::PROFILER::CANNOT_WRITE %s", path);
+    return false;
+  }
+
+  std::vector<Ring*> all;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    all = rings;
+  }
+  all.push_back(gpu);
+
+  std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  const char* separator = "";
+  for (Ring* ring : all)
+  {
+    std::fprintf(file, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                 separator, ring->id, ring->name.c_str());
+    separator = ",\n";
+
+    uint64_t written = captured(ring);
+    uint64_t first = written > PROFILE_RING_EVENTS ? written - PROFILE_RING_EVENTS : 0;
+    for (uint64_t i = first; i < written; i++)
+    {
+      const ProfileEvent& event = ring->events[i % PROFILE_RING_EVENTS];
+      std::fprintf(file, "%s{\"ph\":\"X\",\"name\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                   separator, event.name, ring->id, event.startNs / 1000.0, (event.endNs - event.startNs) / 1000.0);
+    }
+  }
+
+  for (const ProfileFrame& frame : frames)
+  {
+    std::fprintf(file, "%s{\"ph\":\"C\",\"name\":\"frame\",\"pid\":1,\"ts\":%.3f,\"args\":{", separator,
+                 frame.startNs / 1000.0);
+    for (int i = 0; i < COUNTER_COUNT; i++)
+      std::fprintf(file, "%s\"%s\":%llu", i ? "," : "", counterName(i), (unsigned long long) frame.counters[i]);
+    std::fprintf(file, "}}");
+  }
+
+  std::fprintf(file, "\n]}\n");
+  return std::fclose(file) == 0;
+}
+
+void Profiler::report() const
+{
+  if (frames.empty())
+    return;
+
+  double frameMs = 0;
+  double totals[COUNTER_COUNT] = {};
+  for (const ProfileFrame& frame : frames)
+  {
+    frameMs += (frame.endNs - frame.startNs) / 1e6;
+    for (int i = 0; i < COUNTER_COUNT; i++)
+      totals[i] += frame.counters[i];
+  }
+
+  // GPU spans still in the ring, which may be fewer frames than the counters
+  double gpuMs = 0;
+  uint64_t written = captured(gpu);
+  uint64_t first = written > PROFILE_RING_EVENTS ? written - PROFILE_RING_EVENTS : 0;
+  int64_t since = frames.front().startNs;
+  for (uint64_t i = first; i < written; i++)
+  {
+    const ProfileEvent& event = gpu->events[i % PROFILE_RING_EVENTS];
+    if (event.startNs >= since)
+      gpuMs += (event.endNs - event.startNs) / 1e6;
+  }
+
+  double count = (double) frames.size();
+  LOG(INFO, LOG_GAME, "Profile: %zu frames, %g ms/frame, GPU %g ms/frame, per frame %g draw calls, %g uniforms, "
+      "%g bytes uploaded", frames.size(), frameMs / count, gpuMs / count, totals[COUNTER_DRAW_CALLS] / count,
+      totals[COUNTER_UNIFORMS] / count, totals[COUNTER_UPLOAD_BYTES] / count);
+}
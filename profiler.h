@@ -0,0 +1,150 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * ========================================
+ * Profiler
+ * ========================================
+ * PROFILE_SCOPE("name") times the rest of the enclosing block. Each thread
+ * writes into its own ring of the last PROFILE_RING_EVENTS scopes, so
+ * recording never takes a lock, and while the profiler is off a scope is
+ * one relaxed load.
+ *
+ * Turning the profiler on starts a new capture. Rings from an older one
+ * are skipped by write() and reset by their own thread on its next push.
+ *
+ * Counters are summed per frame between endFrame() calls. write() exports
+ * everything still in the rings as Chrome trace_event JSON (load it in
+ * chrome://tracing or Perfetto), GPU times included, see GpuProfiler.
+ *
+ * Names must be string literals or otherwise live forever, only the
+ * pointer is stored.
+ */
+static const size_t PROFILE_RING_EVENTS = 1 << 16;
+// Closed frames kept for history() and the trace, 5 minutes at 60 FPS
+static const size_t PROFILE_HISTORY_FRAMES = 18000;
+
+enum ProfileCounter
+{
+  COUNTER_DRAW_CALLS,
+  COUNTER_UNIFORMS,       // glUniform* calls that reached the driver
+  COUNTER_UPLOAD_BYTES,   // Buffer data written for the GPU
+  COUNTER_SNAPSHOT_WAITS, // Frames drawn with no new snapshot from the simulation
+  COUNTER_VISIBLE,        // Instances that passed frustum culling
+  COUNTER_CULLED,         // Instances outside the view, never sent to the GPU
+  COUNTER_STATE_CHANGES,  // Program and vertex array binds that reached the driver
+  COUNTER_STATE_SKIPPED,  // Binds the state cache dropped, already bound
+  COUNTER_LIGHTS,         // Point lights binned into clusters
+  COUNTER_LIGHT_ENTRIES,  // Light list entries summed over every cluster
+  COUNTER_COUNT
+};
+
+struct ProfileEvent
+{
+  const char* name;
+  int64_t startNs;
+  int64_t endNs;
+};
+
+struct ProfileFrame
+{
+  int64_t startNs;
+  int64_t endNs;
+  uint64_t counters[COUNTER_COUNT];
+};
+
+class Profiler
+{
+public:
+  Profiler();
+  ~Profiler();
+
+  bool enabled() const { return on.load(std::memory_order_relaxed); }
+  // Turning it on starts a fresh capture
+  void enable(bool enable);
+
+  // Nanoseconds since the profiler was made
+  int64_t now() const;
+
+  void record(const char* name, int64_t startNs, int64_t endNs);
+  // Spans measured on the GPU, from the thread that owns the context
+  void recordGpu(const char* name, int64_t startNs, int64_t endNs);
+  void count(ProfileCounter counter, uint64_t amount = 1)
+  {
+    if (enabled())
+      counters[counter].fetch_add(amount, std::memory_order_relaxed);
+  }
+  // Shows up as the thread's name in the trace
+  void nameThread(const char* name);
+
+  // Closes the frame's counters, once per frame on the main thread
+  void endFrame();
+
+  bool write(const char* path);
+  void report() const;
+  // Closed frames of the current capture, oldest first
+  const std::deque<ProfileFrame>& history() const { return frames; }
+
+private:
+  struct Ring
+  {
+    std::string name;
+    int id;
+    std::atomic<uint64_t> capture; // Which capture written counts for
+    std::atomic<uint64_t> written;
+    ProfileEvent events[PROFILE_RING_EVENTS];
+  };
+
+  Ring* ring();
+  Ring* makeRing(const std::string& name);
+  void push(Ring* ring, const ProfileEvent& event);
+  // Events the ring holds from the current capture
+  uint64_t captured(const Ring* ring) const;
+
+  std::atomic<bool> on;
+  std::atomic<uint64_t> capture; // Bumped by every enable(true)
+  int64_t zero;
+
+  std::mutex lock; // Guards rings
+  std::vector<Ring*> rings;
+  Ring* gpu;
+
+  std::atomic<uint64_t> counters[COUNTER_COUNT];
+  int64_t frameStart;
+  std::deque<ProfileFrame> frames; // Last PROFILE_HISTORY_FRAMES of them
+};
+
+extern Profiler profiler;
+
+class ProfileScope
+{
+public:
+  explicit ProfileScope(const char* name)
+    : name(name), start(profiler.enabled() ? profiler.now() : -1)
+  {
+  }
+
+  ~ProfileScope()
+  {
+    if (start >= 0)
+      profiler.record(name, start, profiler.now());
+  }
+
+private:
+  const char* name;
+  int64_t start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+#endif
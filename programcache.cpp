@@ -0,0 +1,173 @@
+#include "programcache.h"
+#include "log.h"
+#include <cerrno>
+#include <cstdio>
+#include <vector>
+#include <sys/stat.h>
+
+// In front of every binary, the format is whatever the driver gave us
+struct ProgramFileHeader
+{
+  uint32_t magic;
+  uint32_t format;
+  uint32_t length;
+  uint32_t reserved;
+  uint64_t key;
+};
+
+static const uint32_t PROGRAM_FILE_MAGIC = 0x47525041; // "APRG"
+
+// FNV-1a, folded over each string including its terminator
+static uint64_t hashString(uint64_t hash, const std::string& text)
+{
+  for (size_t i = 0; i <= text.size(); i++)
+  {
+    hash ^= (unsigned char) text.c_str()[i];
+    hash *= 0x100000001B3ull;
+  }
+  return hash;
+}
+
+static uint64_t programKey(const std::string& driver, const std::string& vertexCode, const std::string& fragmentCode)
+{
+  uint64_t hash = 0xCBF29CE484222325ull;
+  hash = hashString(hash, driver);
+  hash = hashString(hash, vertexCode);
+  return hashString(hash, fragmentCode);
+}
+
+static std::string glString(GLenum name)
+{
+  const GLubyte* value = glGetString(name);
+  return value ? (const char*) value : "";
+}
+
+/*
+ * ========================================
+ * Program Cache
+ * ========================================
+ */
+ProgramCache::ProgramCache(const std::string& directory)
+  : directory(directory), available(false)
+{
+  driver = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION);
+
+  if (GLEW_ARB_get_program_binary)
+  {
+    int formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    available = formats > 0;
+  }
+
+  if (available && mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+  {
+    LOG(ERROR, LOG_SHADER, "ERROR::PROGRAM_CACHE::CANNOT_CREATE_DIRECTORY %s", directory.c_str());
+    available = false;
+  }
+}
+
+std::string ProgramCache::path(const std::string& vertexCode, const std::string& fragmentCode) const
+{
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.bin",
+                (unsigned long long) programKey(driver, vertexCode, fragmentCode));
+  return directory + "/" + name;
+}
+
+bool ProgramCache::load(unsigned int program, const std::string& vertexCode, const std::string& fragmentCode)
+{
+  if (!available)
+  {
+    stats.misses++;
+    return false;
+  }
+
+  FILE* file = std::fopen(path(vertexCode, fragmentCode).c_str(), "rb");
+  if (!file)
+  {
+    stats.misses++;
+    return false;
+  }
+
+  ProgramFileHeader header;
+  std::vector<char> binary;
+  bool read = std::fread(&header, sizeof(header), 1, file) == 1 && header.magic == PROGRAM_FILE_MAGIC &&
+              header.key == programKey(driver, vertexCode, fragmentCode);
+  if (read)
+  {
+    binary.resize(header.length);
+    read = std::fread(binary.data(), 1, binary.size(), file) == binary.size();
+  }
+  std::fclose(file);
+
+  if (!read)
+  {
+    stats.misses++;
+    return false;
+  }
+
+  glProgramBinary(program, header.format, binary.data(), (GLsizei) binary.size());
+
+  int success = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success)
+  {
+    // Not an error, the caller recompiles and store() replaces the file
+    stats.rejected++;
+    stats.misses++;
+    return false;
+  }
+
+  stats.hits++;
+  return true;
+}
+
+void ProgramCache::store(unsigned int program, const std::string& vertexCode, const std::string& fragmentCode)
+{
+  if (!available)
+    return;
+
+  int length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0)
+    return;
+
+  ProgramFileHeader header = {};
+  header.magic = PROGRAM_FILE_MAGIC;
+  header.key = programKey(driver, vertexCode, fragmentCode);
+
+  std::vector<char> binary(length);
+  GLenum format = 0;
+  glGetProgramBinary(program, length, &length, &format, binary.data());
+  header.format = format;
+  header.length = (uint32_t) length;
+
+  // Written aside and renamed so a crash never leaves half a binary behind
+  std::string target = path(vertexCode, fragmentCode);
+  std::string temporary = target + ".tmp";
+  FILE* file = std::fopen(temporary.c_str(), "wb");
+  if (!file)
+  {
+    LOG(ERROR, LOG_SHADER, "ERROR::PROGRAM_CACHE::CANNOT_WRITE %s", temporary.c_str());
+    return;
+  }
+
+  bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                 std::fwrite(binary.data(), 1, header.length, file) == header.length;
+  written = std::fclose(file) == 0 && written;
+  if (!written || std::rename(temporary.c_str(), target.c_str()) != 0)
+  {
+    LOG(ERROR, LOG_SHADER, "ERROR::PROGRAM_CACHE::CANNOT_WRITE %s", target.c_str());
+    std::remove(temporary.c_str());
+    return;
+  }
+
+  stats.stored++;
+}
+
+ProgramCacheStats ProgramCache::takeStats()
+{
+  ProgramCacheStats taken = stats;
+  stats = ProgramCacheStats();
+  return taken;
+}
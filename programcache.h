@@ -0,0 +1,56 @@
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <string>
+
+/*
+ * ========================================
+ * Program Cache
+ * ========================================
+ * Linked program binaries on disk, one file per program. The key hashes
+ * both shader sources together with the GL vendor, renderer and version
+ * strings, so editing a shader or updating the driver simply misses.
+ *
+ * Drivers may still refuse a binary they wrote (a different build with the
+ * same version string, say). load() reports that as a miss and the caller
+ * compiles from source as if there was no cache.
+ *
+ * Needs a current context, and GL_ARB_get_program_binary with at least one
+ * binary format. Without that every load misses and store does nothing.
+ */
+struct ProgramCacheStats
+{
+  unsigned int hits = 0;
+  unsigned int misses = 0;
+  // Files found but refused by glProgramBinary
+  unsigned int rejected = 0;
+  unsigned int stored = 0;
+};
+
+class ProgramCache
+{
+public:
+  explicit ProgramCache(const std::string& directory);
+
+  bool supported() const { return available; }
+
+  // Links program from the cached binary, false if the caller has to compile
+  bool load(unsigned int program, const std::string& vertexCode, const std::string& fragmentCode);
+  // Saves a freshly linked program, which must have been linked with
+  // GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+  void store(unsigned int program, const std::string& vertexCode, const std::string& fragmentCode);
+
+  ProgramCacheStats takeStats();
+
+private:
+  std::string path(const std::string& vertexCode, const std::string& fragmentCode) const;
+
+  std::string directory;
+  std::string driver; // Vendor, renderer and version, part of every key
+  bool available;
+  ProgramCacheStats stats;
+};
+
+#endif
@@ -0,0 +1,523 @@
+/*
+ * ========================================
+ * Render Benchmark
+ * ========================================
+ * Draws the game's scene offscreen, no window, display or GPU needed, so
+ * render path changes can be measured on build machines (Mesa's llvmpipe
+ * does fine). Scripted scenes of more and more ships, each reported as
+ * frames/s, CPU time and GL calls per frame.
+ *
+ * The grid scenes fill the view. The field scene is the other extreme:
+ * ships scattered far past the edges of a camera looking out across them,
+ * drawn with culling and LODs off and then on to show what they save.
+ * The mixed scenes are thousands of separate draws of different programs
+ * and meshes, issued straight to GL and then through the render queue.
+ * The light scenes put hundreds of point lights among the grid's ships,
+ * shaded first the plain forward way, every light for every pixel, then
+ * through the light clusters.
+ *
+ * First of all, the stream growth check draws a frame that outgrows the
+ * instance stream ring across several batches, and fails if it doesn't
+ * match the frame after.
+ *
+ * --png DIR writes the last frame of every scene out for checking by eye,
+ * or by diffing against an earlier run: the scenes are deterministic.
+ */
+#include <GL/glew.h>
+#include "offscreen.h"
+#include "scene.h"
+#include "profiler.h"
+#include "log.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+static const int WIDTH = 480;
+static const int HEIGHT = 360;
+static const unsigned int SHIPS[] = { 1, 10, 100, 1000, 10000 };
+static const int WARMUP_FRAMES = 10;
+static const unsigned int FIELD_SHIPS = 100000;
+static const float FIELD_SIZE = 400.0f;
+static const unsigned int LIGHT_SHIPS = 1000;
+static const unsigned int LIGHTS[] = { 64, 256, 1024 };
+static const unsigned int MIXED_DRAWS[] = { 1000, 4000 };
+// Instances over all batches, more than the stream ring starts with room for
+static const unsigned int GROWTH_INSTANCES = 30000;
+
+static void usage()
+{
+  std::printf("usage: astro_renderbench [--frames N] [--png DIR]\n");
+}
+
+static double threadCpuMs()
+{
+  timespec time;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+  return time.tv_sec * 1e3 + time.tv_nsec / 1e6;
+}
+
+static double wallMs()
+{
+  timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1e3 + time.tv_nsec / 1e6;
+}
+
+// Ships on a grid filling the view, each nodding up and down out of step
+// with its neighbours. The player is the first of them. Packed this tight
+// they'd all touch, so no radius: collision would swamp the frame.
+static void populate(SimState& state, unsigned int ships)
+{
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<float> jitter(-0.2f, 0.2f);
+
+  unsigned int columns = (unsigned int) std::ceil(std::sqrt(ships * 4.0 / 3.0));
+  unsigned int rows = (ships + columns - 1) / columns;
+
+  for (unsigned int i = 1; i < ships; i++)
+  {
+    float x = columns > 1 ? -10.0f + 20.0f * (i % columns) / (columns - 1) : 0.0f;
+    float y = rows > 1 ? -7.0f + 14.0f * (i / columns) / (rows - 1) : 0.0f;
+    state.world.create(x + jitter(random), y + jitter(random), MESH_SHIP);
+  }
+}
+
+// Ships scattered over a square well past what the camera sees, which
+// looks out across them from behind the near edge
+static void populateField(SimState& state, unsigned int ships)
+{
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<float> spread(-FIELD_SIZE / 2, FIELD_SIZE / 2);
+
+  for (unsigned int i = 1; i < ships; i++)
+    state.world.create(spread(random), spread(random) + FIELD_SIZE / 2 - 50.0f, MESH_SHIP);
+}
+
+static glm::mat4 fieldView()
+{
+  return glm::lookAt(glm::vec3(0.0f, -50.0f, 20.0f), glm::vec3(0.0f, 20.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+}
+
+// Lights of every colour scattered through the grid, just in front of the
+// ships so they land on them
+static std::vector<PointLight> scatterLights(unsigned int count)
+{
+  std::mt19937 random(4321);
+  std::uniform_real_distribution<float> x(-11.0f, 11.0f), y(-8.0f, 8.0f), z(0.0f, 4.0f);
+  std::uniform_real_distribution<float> radius(2.0f, 5.0f), color(0.2f, 1.0f);
+
+  std::vector<PointLight> lights(count);
+  for (PointLight& light : lights)
+    light = { x(random), y(random), z(random), radius(random), color(random), color(random), color(random), 0.0f };
+  return lights;
+}
+
+static void steer(SimState& state, int frame)
+{
+  EntityStore& world = state.world;
+  for (size_t i = 0; i < world.size(); i++)
+    world.steer[i] = (i + frame / 30) & 1 ? STEER_UP : STEER_DOWN;
+}
+
+struct SceneResult
+{
+  double wallMs;
+  double cpuMs;
+  double counters[COUNTER_COUNT];
+};
+
+// Warms up, then times draw over frames frames. prepare runs before each,
+// untimed.
+static SceneResult timeFrames(int frames, const std::function<void(int)>& prepare, const std::function<void()>& draw)
+{
+  // Fills the stream buffer and settles the driver before timing
+  for (int frame = 0; frame < WARMUP_FRAMES; frame++)
+  {
+    prepare(frame);
+    draw();
+  }
+  glFinish();
+
+  profiler.enable(true);
+  SceneResult result = {};
+  for (int frame = 0; frame < frames; frame++)
+  {
+    prepare(WARMUP_FRAMES + frame);
+
+    double wallStart = wallMs(), cpuStart = threadCpuMs();
+    draw();
+    glFinish();
+    result.wallMs += wallMs() - wallStart;
+    result.cpuMs += threadCpuMs() - cpuStart;
+    profiler.endFrame();
+  }
+  profiler.enable(false);
+
+  for (const ProfileFrame& frame : profiler.history())
+  {
+    for (int i = 0; i < COUNTER_COUNT; i++)
+      result.counters[i] += frame.counters[i];
+  }
+
+  result.wallMs /= frames;
+  result.cpuMs /= frames;
+  for (double& counter : result.counters)
+    counter /= frames;
+  return result;
+}
+
+// Draws state, stepping it between frames. The simulation isn't what's
+// being measured.
+static SceneResult measure(Scene& scene, SimState& state, int frames)
+{
+  FrameSnapshot snapshot;
+  auto prepare = [&](int frame)
+  {
+    steer(state, frame);
+    step(state, SimConstants::DT, SimInput());
+    captureSnapshot(state, snapshot);
+  };
+  return timeFrames(frames, prepare, [&]
+  {
+    blendScene(scene, snapshot, 0.5f);
+    drawScene(scene, snapshot, 0.5f);
+  });
+}
+
+// One object in the mixed scene, its own draw call
+struct MixedDraw
+{
+  int mesh; // Renderer mesh of a ship LOD, or -1 for a light cube
+  glm::mat4 model;
+  float depth;
+};
+
+// Small ships of every LOD and light cubes, shuffled, so consecutive draws
+// rarely share a program or mesh
+static std::vector<MixedDraw> mixedDraws(const Scene& scene, unsigned int count)
+{
+  std::mt19937 random(1234);
+  std::uniform_int_distribution<int> kind(0, SHIP_LODS);
+  std::uniform_real_distribution<float> x(-10.0f, 10.0f), y(-7.0f, 7.0f), z(-5.0f, 5.0f);
+
+  std::vector<MixedDraw> draws(count);
+  for (MixedDraw& draw : draws)
+  {
+    int k = kind(random);
+    draw.mesh = k < SHIP_LODS ? scene.meshes[MESH_SHIP].lods[k] : -1;
+    glm::vec3 position(x(random), y(random), z(random));
+    draw.model = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.1f));
+    draw.depth = -(scene.view * glm::vec4(position, 1.0f)).z / CAMERA_FAR;
+  }
+  return draws;
+}
+
+// Each draw goes to GL as it comes, binding everything, the way drawScene
+// used to. Or queued, sorted and replayed through the state cache.
+static void drawMixed(Scene& scene, const std::vector<MixedDraw>& draws, bool queued)
+{
+  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  scene.camera->update(scene.view, glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(1.0f, 1.0f, 1.0f));
+
+  BatchRenderer& renderer = *scene.renderer;
+  RenderQueue& queue = *scene.queue;
+  renderer.reserve((unsigned int) draws.size());
+  for (const MixedDraw& draw : draws)
+  {
+    bool light = draw.mesh < 0;
+    Shader* shader = light ? scene.LIGHT.shader : scene.shader;
+    const GpuMesh& mesh = light ? scene.lightMesh : renderer.mesh(draw.mesh);
+
+    InstanceBatch batch = {};
+    if (!light)
+    {
+      batch = renderer.instances(1);
+      if (!batch.transforms)
+        continue;
+      batch.transforms[0] = draw.model;
+    }
+
+    if (queued)
+    {
+      DrawCommand& command = queue.submit(sortKey(shader->Id, mesh.VAO, 0, draw.depth));
+      command.shader = shader;
+      command.mesh = mesh;
+      command.instances = batch;
+      command.pass = light ? "light" : "ships";
+      if (light)
+      {
+        command.model = scene.LIGHT.UNIFORMS.model;
+        command.modelValue = draw.model;
+      }
+      continue;
+    }
+
+    renderer.state().useProgram(shader->Id);
+    if (light)
+    {
+      shader->set(scene.LIGHT.UNIFORMS.model, draw.model);
+      renderer.draw(mesh);
+    }
+    else
+    {
+      renderer.draw(mesh, batch);
+    }
+  }
+
+  if (queued)
+  {
+    queue.sort();
+    queue.execute(renderer, *scene.gpuProfiler);
+    queue.reset();
+  }
+  renderer.endFrame();
+}
+
+static void printResult(const std::string& name, const SceneResult& result)
+{
+  const double* counters = result.counters;
+  std::printf("%-24s %-10.1f %-10.3f %-14.3f %-12g %-10g %-10g %-10g %g\n", name.c_str(), 1000.0 / result.wallMs,
+              result.wallMs, result.cpuMs, counters[COUNTER_DRAW_CALLS], counters[COUNTER_VISIBLE],
+              counters[COUNTER_CULLED], counters[COUNTER_UNIFORMS], counters[COUNTER_UPLOAD_BYTES] / 1024);
+  std::fflush(stdout); // Big scenes take a while on llvmpipe, show progress
+}
+
+// Checks for GL errors and writes the frame out if asked, false on failure
+static bool finishScene(OffscreenContext& context, const char* pngDirectory, const std::string& name)
+{
+  bool passed = true;
+  GLenum error = glGetError();
+  if (error != GL_NO_ERROR)
+  {
+    LOG(ERROR, LOG_RENDER, "ERROR::RENDERBENCH::GL_ERROR 0x%x in %s", error, name.c_str());
+    passed = false;
+  }
+
+  if (pngDirectory)
+  {
+    std::vector<uint8_t> pixels;
+    std::string path = std::string(pngDirectory) + "/" + name + ".png";
+    context.readPixels(pixels);
+    if (!writePng(path.c_str(), WIDTH, HEIGHT, pixels.data()))
+      passed = false;
+  }
+  return passed;
+}
+
+// A band of small ships per LOD, each LOD one queued batch
+static void drawBatches(Scene& scene, unsigned int perBatch)
+{
+  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  scene.camera->update(scene.view, glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(1.0f, 1.0f, 1.0f));
+
+  BatchRenderer& renderer = *scene.renderer;
+  RenderQueue& queue = *scene.queue;
+  renderer.reserve(perBatch * SHIP_LODS);
+
+  unsigned int columns = (unsigned int) std::ceil(std::sqrt(perBatch * 4.0));
+  unsigned int rows = (perBatch + columns - 1) / columns;
+  float band = 14.0f / SHIP_LODS;
+  for (int lod = 0; lod < SHIP_LODS; lod++)
+  {
+    InstanceBatch batch = renderer.instances(perBatch);
+    if (!batch.transforms)
+      continue;
+    for (unsigned int i = 0; i < batch.count; i++)
+    {
+      glm::vec3 position(-10.0f + 20.0f * (i % columns) / (columns - 1),
+                         7.0f - band * lod - band * (i / columns) / rows, 0.0f);
+      batch.transforms[i] = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.03f));
+    }
+
+    const GpuMesh& mesh = renderer.mesh(scene.meshes[MESH_SHIP].lods[lod]);
+    DrawCommand& command = queue.submit(sortKey(scene.shader->Id, mesh.VAO, 0, 0.0f));
+    command.shader = scene.shader;
+    command.mesh = mesh;
+    command.instances = batch;
+    command.pass = "ships";
+  }
+
+  queue.sort();
+  queue.execute(renderer, *scene.gpuProfiler);
+  queue.reset();
+  renderer.endFrame();
+}
+
+/*
+ * A frame of batches that only outgrow the stream ring together, drawn
+ * while the ring is still its starting size, so it has to grow before the
+ * first of them is written. Every instance has to make it, and the frame
+ * has to match the next, drawn with the ring already big enough.
+ */
+static bool checkStreamGrowth(OffscreenContext& context, Scene& scene, const char* pngDirectory)
+{
+  std::vector<uint8_t> frames[2];
+  RenderStats stats[2];
+  for (int frame = 0; frame < 2; frame++)
+  {
+    drawBatches(scene, GROWTH_INSTANCES / SHIP_LODS);
+    context.readPixels(frames[frame]);
+    stats[frame] = scene.renderer->takeStats();
+  }
+
+  unsigned int expected = GROWTH_INSTANCES / SHIP_LODS * SHIP_LODS;
+  bool same = frames[0] == frames[1] && stats[0].instances == expected;
+  std::printf("stream growth: %u of %u instances in %u draws, first frame %s\n", stats[0].instances, expected,
+              stats[0].drawCalls, same ? "same" : "DIFFERENT");
+  if (!same)
+    LOG(ERROR, LOG_RENDER, "ERROR::RENDERBENCH::STREAM_GROWTH the frame the ring grew on is wrong");
+  return finishScene(context, pngDirectory, "stream_growth") && same;
+}
+
+int main(int argc, char* args[])
+{
+  int frames = 60;
+  const char* pngDirectory = nullptr;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (std::strcmp(args[i], "--frames") == 0 && i + 1 < argc)
+      frames = std::max(1, std::atoi(args[++i]));
+    else if (std::strcmp(args[i], "--png") == 0 && i + 1 < argc)
+      pngDirectory = args[++i];
+    else
+    {
+      usage();
+      return 1;
+    }
+  }
+
+  OffscreenContext context;
+  if (!context.create(WIDTH, HEIGHT))
+    return 1;
+
+  Scene scene = {};
+  submitPrograms(scene, "cache");
+  waitForPrograms(scene, true);
+  if (!createRenderer(scene, WIDTH, HEIGHT))
+    return 1;
+
+  MeshFile lightFile;
+  if (!lightFile.open("res/meshes/light.mesh"))
+  {
+    LOG(ERROR, LOG_ASSET, "ERROR::RENDERBENCH::MESHES_NOT_BUILT");
+    return 1;
+  }
+  scene.lightMesh = uploadMesh(lightFile);
+  lightFile.close();
+  for (int lod = 0; lod < SHIP_LODS; lod++)
+  {
+    MeshFile shipFile;
+    if (!shipFile.open(SHIP_MESH_FILES[lod]))
+    {
+      LOG(ERROR, LOG_ASSET, "ERROR::RENDERBENCH::MESHES_NOT_BUILT");
+      return 1;
+    }
+    addMeshLod(scene, MESH_SHIP, lod, shipFile);
+  }
+
+  std::printf("%s, %dx%d, %d frames per scene\n", context.renderer(), WIDTH, HEIGHT, frames);
+
+  // Before anything else has grown the ring
+  bool passed = checkStreamGrowth(context, scene, pngDirectory);
+  scene.view = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -20.0f));
+
+  std::printf("scene                    frames/s   ms/frame   cpu ms/frame   draw calls   visible    culled     "
+              "uniforms   KiB uploaded\n");
+  for (unsigned int ships : SHIPS)
+  {
+    SimState state;
+    populate(state, ships);
+    std::string name = "ships_" + std::to_string(ships);
+    printResult(name, measure(scene, state, frames));
+    passed = finishScene(context, pngDirectory, name) && passed;
+  }
+
+  // The same field without and with culling
+  scene.view = fieldView();
+  SceneResult fieldResults[2];
+  for (int culling = 0; culling < 2; culling++)
+  {
+    SimState state;
+    populateField(state, FIELD_SHIPS);
+    scene.culling = culling == 1;
+    std::string name = std::string("field_") + (culling ? "culled" : "all");
+    fieldResults[culling] = measure(scene, state, frames);
+    printResult(name, fieldResults[culling]);
+    passed = finishScene(context, pngDirectory, name) && passed;
+  }
+  std::printf("\nculling and LODs: %.3f ms/frame saved on %u ships, %.1fx faster\n",
+              fieldResults[0].wallMs - fieldResults[1].wallMs, FIELD_SHIPS,
+              fieldResults[0].wallMs / fieldResults[1].wallMs);
+
+  // Thousands of separate draws, issued one by one and then through the
+  // render queue. Submission cost is CPU time per draw.
+  scene.view = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -20.0f));
+  std::printf("\nscene                    frames/s   ms/frame   us/draw    draw calls   state changes   avoided\n");
+  for (unsigned int count : MIXED_DRAWS)
+  {
+    std::vector<MixedDraw> draws = mixedDraws(scene, count);
+    SceneResult mixedResults[2];
+    for (int queued = 0; queued < 2; queued++)
+    {
+      // Immediate draws bind everything, as if there were no cache
+      scene.renderer->state().enabled = queued == 1;
+      SceneResult& result = mixedResults[queued];
+      result = timeFrames(frames, [](int) {}, [&] { drawMixed(scene, draws, queued == 1); });
+
+      std::string name = "mixed_" + std::to_string(count) + (queued ? "_queued" : "_immediate");
+      const double* counters = result.counters;
+      std::printf("%-24s %-10.1f %-10.3f %-10.3f %-12g %-15g %g\n", name.c_str(), 1000.0 / result.wallMs,
+                  result.wallMs, result.cpuMs * 1000.0 / count, counters[COUNTER_DRAW_CALLS],
+                  counters[COUNTER_STATE_CHANGES], counters[COUNTER_STATE_SKIPPED]);
+      std::fflush(stdout);
+      passed = finishScene(context, pngDirectory, name) && passed;
+    }
+    std::printf("render queue on %u mixed draws: %.3f -> %.3f us/draw\n", count,
+                mixedResults[0].cpuMs * 1000.0 / count, mixedResults[1].cpuMs * 1000.0 / count);
+  }
+  scene.renderer->state().enabled = true;
+
+  // Every light for every pixel, then only the ones each cluster reaches
+  JobSystem jobs(JobSystem::defaultWorkers());
+  scene.jobs = &jobs;
+  std::printf("\nscene                    frames/s   ms/frame   cpu ms/frame   lights     lights/cluster\n");
+  for (unsigned int count : LIGHTS)
+  {
+    scene.lights = scatterLights(count);
+    SceneResult lightResults[2];
+    for (int clustered = 0; clustered < 2; clustered++)
+    {
+      SimState state;
+      populate(state, LIGHT_SHIPS);
+      scene.clusterLights = clustered == 1;
+      SceneResult& result = lightResults[clustered];
+      result = measure(scene, state, frames);
+
+      std::string name = "lights_" + std::to_string(count) + (clustered ? "_clustered" : "_all");
+      const double* counters = result.counters;
+      std::printf("%-24s %-10.1f %-10.3f %-14.3f %-10g %g\n", name.c_str(), 1000.0 / result.wallMs, result.wallMs,
+                  result.cpuMs, counters[COUNTER_LIGHTS], counters[COUNTER_LIGHT_ENTRIES] / CLUSTER_COUNT);
+      std::fflush(stdout);
+      passed = finishScene(context, pngDirectory, name) && passed;
+    }
+    std::printf("clustered lighting on %u lights: %.3f -> %.3f ms/frame\n", count, lightResults[0].wallMs,
+                lightResults[1].wallMs);
+  }
+  scene.jobs = nullptr;
+
+  destroyScene(scene);
+  context.destroy();
+  logger.flush();
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,221 @@
+#include "renderer.h"
+#include <cstring>
+#include "profiler.h"
+
+// Room for 16K instances a frame before the ring has to grow
+static const size_t STREAM_FRAME_BYTES = 1 << 20;
+
+BatchRenderer::BatchRenderer()
+  : stream(new StreamBuffer(GL_ARRAY_BUFFER, STREAM_FRAME_BYTES))
+{
+}
+
+BatchRenderer::~BatchRenderer()
+{
+  for (GpuMesh& mesh : meshes)
+    deleteMesh(mesh);
+  delete stream;
+}
+
+/*
+ * ========================================
+ * Mesh Upload
+ * ========================================
+ */
+static GLenum attributeType(uint32_t type)
+{
+  switch (type)
+  {
+  case MESH_FLOAT16:
+    return GL_HALF_FLOAT;
+  case MESH_INT16:
+    return GL_SHORT;
+  case MESH_UINT8:
+    return GL_UNSIGNED_BYTE;
+  case MESH_INT_2_10_10_10:
+    return GL_INT_2_10_10_10_REV;
+  case MESH_FLOAT32:
+  default:
+    return GL_FLOAT;
+  }
+}
+
+GpuMesh uploadMesh(const MeshFile& file)
+{
+  const MeshFileHeader& header = file.header();
+
+  GpuMesh mesh;
+  mesh.indexCount = header.indexCount;
+  mesh.indexType = header.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+  glGenVertexArrays(1, &mesh.VAO);
+  glGenBuffers(1, &mesh.VBO);
+  glGenBuffers(1, &mesh.EBO);
+
+  glBindVertexArray(mesh.VAO);
+
+  // Straight from the file mapping, the driver makes the only copy
+  glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+  glBufferData(GL_ARRAY_BUFFER, file.vertexBytes(), file.vertices(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, file.indexBytes(), file.indices(), GL_STATIC_DRAW);
+
+  for (uint32_t i = 0; i < header.attributeCount; i++)
+  {
+    const MeshAttribute& attribute = header.attributes[i];
+    glVertexAttribPointer(attribute.location, attribute.components, attributeType(attribute.type),
+                          attribute.normalized ? GL_TRUE : GL_FALSE, header.vertexStride,
+                          (void*)(size_t) attribute.offset);
+    glEnableVertexAttribArray(attribute.location);
+  }
+
+  glBindVertexArray(0);
+  return mesh;
+}
+
+void deleteMesh(GpuMesh& mesh)
+{
+  glDeleteVertexArrays(1, &mesh.VAO);
+  glDeleteBuffers(1, &mesh.VBO);
+  glDeleteBuffers(1, &mesh.EBO);
+}
+
+/*
+ * ========================================
+ * GL State Cache
+ * ========================================
+ */
+void GlStateCache::useProgram(unsigned int id)
+{
+  if (enabled && id == program)
+  {
+    profiler.count(COUNTER_STATE_SKIPPED);
+    return;
+  }
+  glUseProgram(id);
+  program = id;
+  profiler.count(COUNTER_STATE_CHANGES);
+}
+
+void GlStateCache::bindVertexArray(unsigned int id)
+{
+  if (enabled && id == vao)
+  {
+    profiler.count(COUNTER_STATE_SKIPPED);
+    return;
+  }
+  glBindVertexArray(id);
+  vao = id;
+  profiler.count(COUNTER_STATE_CHANGES);
+}
+
+void GlStateCache::invalidate()
+{
+  program = UNKNOWN;
+  vao = UNKNOWN;
+}
+
+/*
+ * ========================================
+ * Batch Renderer
+ * ========================================
+ */
+int BatchRenderer::addMesh(const MeshFile& file)
+{
+  GpuMesh mesh = uploadMesh(file);
+
+  // Model matrix, one column per attribute, advancing once per instance.
+  // Pointed into the stream buffer at draw time.
+  glBindVertexArray(mesh.VAO);
+  for (unsigned int i = 0; i < 4; i++)
+  {
+    glEnableVertexAttribArray(INSTANCE_LOCATION + i);
+    glVertexAttribDivisor(INSTANCE_LOCATION + i, 1);
+  }
+  glBindVertexArray(0);
+  glState.invalidate();
+
+  meshes.push_back(mesh);
+  return (int) meshes.size() - 1;
+}
+
+InstanceBatch BatchRenderer::instances(unsigned int count)
+{
+  StreamAllocation allocation = stream->allocate(sizeof(glm::mat4) * count, sizeof(glm::mat4));
+  if (allocation.data)
+    profiler.count(COUNTER_UPLOAD_BYTES, sizeof(glm::mat4) * count);
+
+  InstanceBatch batch;
+  batch.transforms = (glm::mat4*) allocation.data;
+  batch.count = allocation.data ? count : 0;
+  batch.offset = allocation.offset;
+  return batch;
+}
+
+void BatchRenderer::reserve(unsigned int count)
+{
+  stream->reserve(sizeof(glm::mat4) * count);
+}
+
+void BatchRenderer::draw(int id, const InstanceBatch& batch)
+{
+  draw(meshes[id], batch);
+}
+
+void BatchRenderer::draw(const GpuMesh& mesh, const InstanceBatch& batch)
+{
+  if (batch.count == 0)
+    return;
+
+  stream->flush();
+
+  glState.bindVertexArray(mesh.VAO);
+  glBindBuffer(GL_ARRAY_BUFFER, stream->buffer());
+  for (unsigned int i = 0; i < 4; i++)
+  {
+    glVertexAttribPointer(INSTANCE_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                          (void*)(batch.offset + i * sizeof(glm::vec4)));
+  }
+  glDrawElementsInstanced(GL_TRIANGLES, mesh.indexCount, mesh.indexType, 0, batch.count);
+
+  stats.drawCalls++;
+  profiler.count(COUNTER_DRAW_CALLS);
+  stats.instances += batch.count;
+}
+
+void BatchRenderer::draw(int id, const glm::mat4* transforms, unsigned int count)
+{
+  if (count == 0)
+    return;
+
+  InstanceBatch batch = instances(count);
+  if (batch.transforms)
+    std::memcpy(batch.transforms, transforms, sizeof(glm::mat4) * batch.count);
+  draw(id, batch);
+}
+
+void BatchRenderer::draw(const GpuMesh& mesh)
+{
+  glState.bindVertexArray(mesh.VAO);
+  glDrawElements(GL_TRIANGLES, mesh.indexCount, mesh.indexType, 0);
+
+  stats.drawCalls++;
+  profiler.count(COUNTER_DRAW_CALLS);
+}
+
+void BatchRenderer::endFrame()
+{
+  stream->endFrame();
+}
+
+RenderStats BatchRenderer::takeStats()
+{
+  StreamStats streamed = stream->takeStats();
+  stats.bytesUploaded = streamed.bytesStreamed;
+  stats.fenceWaits = streamed.fenceWaits;
+  stats.fenceWaitMs = streamed.waitMs;
+
+  RenderStats taken = stats;
+  stats = RenderStats();
+  return taken;
+}
@@ -0,0 +1,116 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "meshfile.h"
+#include "streaming.h"
+
+/*
+ * ========================================
+ * Batch Renderer
+ * ========================================
+ * Draws every instance of a mesh with one glDrawElementsInstanced. Model
+ * matrices go in a per-instance attribute (locations 3-6 in vertex.glsl)
+ * instead of a uniform per draw, streamed through one StreamBuffer that
+ * all meshes share.
+ */
+static const unsigned int INSTANCE_LOCATION = 3;
+
+struct GpuMesh
+{
+  unsigned int VAO;
+  unsigned int VBO;
+  unsigned int EBO;
+  int indexCount;
+  GLenum indexType;
+};
+
+// Plain upload of a baked mesh: buffers, VAO and its vertex attributes
+GpuMesh uploadMesh(const MeshFile& file);
+void deleteMesh(GpuMesh& mesh);
+
+struct RenderStats
+{
+  unsigned int drawCalls = 0;
+  unsigned int instances = 0;
+  unsigned long long bytesUploaded = 0;
+  unsigned int fenceWaits = 0;
+  double fenceWaitMs = 0;
+};
+
+/*
+ * ========================================
+ * GL State Cache
+ * ========================================
+ * Drops glUseProgram and glBindVertexArray calls that would bind what's
+ * already bound. It only knows about binds that go through it, so code
+ * binding behind its back has to invalidate() it after.
+ */
+class GlStateCache
+{
+public:
+  void useProgram(unsigned int program);
+  void bindVertexArray(unsigned int vao);
+  // Forgets what's bound, the next of each goes to the driver
+  void invalidate();
+
+  bool enabled = true; // Off passes every call through, to compare against
+
+private:
+  static const unsigned int UNKNOWN = ~0u;
+
+  unsigned int program = UNKNOWN;
+  unsigned int vao = UNKNOWN;
+};
+
+// Instance matrices living in the stream buffer, write them then draw
+struct InstanceBatch
+{
+  glm::mat4* transforms;
+  unsigned int count;
+  size_t offset;
+};
+
+class BatchRenderer
+{
+public:
+  BatchRenderer();
+  ~BatchRenderer();
+
+  // Uploads the mesh and returns its id, the file can be closed after
+  int addMesh(const MeshFile& file);
+
+  // Room for count model matrices straight in GPU visible memory
+  InstanceBatch instances(unsigned int count);
+  // Makes room for count matrices over the whole frame, before its first
+  // instances(). Without it only the first batch can grow the stream ring,
+  // later ones that don't fit come back empty.
+  void reserve(unsigned int count);
+  const GpuMesh& mesh(int id) const { return meshes[id]; }
+
+  // One draw for all instances, the mesh's program must already be in use
+  void draw(int mesh, const InstanceBatch& batch);
+  void draw(const GpuMesh& mesh, const InstanceBatch& batch);
+  // Same, copying transforms into the stream buffer first
+  void draw(int mesh, const glm::mat4* transforms, unsigned int count);
+  // One plain draw, for meshes without the instance attributes
+  void draw(const GpuMesh& mesh);
+  // Fences this frame's instance data, once per frame after the last draw
+  void endFrame();
+
+  // Counters since the last call
+  RenderStats takeStats();
+
+  // Every bind the renderer makes goes through here
+  GlStateCache& state() { return glState; }
+
+private:
+  std::vector<GpuMesh> meshes;
+  GlStateCache glState;
+  StreamBuffer* stream;
+  RenderStats stats;
+};
+
+#endif
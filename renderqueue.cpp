@@ -0,0 +1,172 @@
+#include "renderqueue.h"
+#include <algorithm>
+#include <cstring>
+
+// A few thousand draws a frame without chaining
+static const size_t PAYLOAD_BLOCK_BYTES = 256 * 1024;
+
+/*
+ * ========================================
+ * Frame Allocator
+ * ========================================
+ */
+FrameAllocator::FrameAllocator(size_t blockBytes)
+  : blockBytes(blockBytes), offset(0), usedBytes(0)
+{
+  blocks.push_back(new char[blockBytes]);
+}
+
+FrameAllocator::~FrameAllocator()
+{
+  for (char* block : blocks)
+    delete[] block;
+}
+
+void* FrameAllocator::allocate(size_t bytes, size_t alignment)
+{
+  size_t start = (offset + alignment - 1) & ~(alignment - 1);
+  if (start + bytes > blockBytes)
+  {
+    // new[] aligns for anything, so a fresh block starts at 0
+    blocks.push_back(new char[std::max(bytes, blockBytes)]);
+    start = 0;
+  }
+  else
+  {
+    usedBytes += start - offset;
+  }
+
+  usedBytes += bytes;
+  offset = start + bytes;
+  return blocks.back() + start;
+}
+
+void FrameAllocator::reset()
+{
+  if (blocks.size() > 1)
+  {
+    for (char* block : blocks)
+      delete[] block;
+    blocks.clear();
+
+    blockBytes = std::max(blockBytes * 2, usedBytes);
+    blocks.push_back(new char[blockBytes]);
+  }
+
+  offset = 0;
+  usedBytes = 0;
+}
+
+/*
+ * ========================================
+ * Sort Keys
+ * ========================================
+ */
+uint64_t sortKey(unsigned int program, unsigned int vao, unsigned int material, float depth)
+{
+  const uint64_t depthMax = (1ull << SORT_DEPTH_BITS) - 1;
+  depth = std::min(std::max(depth, 0.0f), 1.0f);
+
+  uint64_t key = program & ((1u << SORT_PROGRAM_BITS) - 1);
+  key = (key << SORT_MESH_BITS) | (vao & ((1u << SORT_MESH_BITS) - 1));
+  key = (key << SORT_MATERIAL_BITS) | (material & ((1u << SORT_MATERIAL_BITS) - 1));
+  key = (key << SORT_DEPTH_BITS) | (uint64_t) (depth * depthMax);
+  return key;
+}
+
+static_assert(SORT_PROGRAM_BITS + SORT_MESH_BITS + SORT_MATERIAL_BITS + SORT_DEPTH_BITS == 64,
+              "Sort key fields must fill 64 bits");
+
+/*
+ * ========================================
+ * Render Queue
+ * ========================================
+ */
+RenderQueue::RenderQueue()
+  : payloads(PAYLOAD_BLOCK_BYTES)
+{
+}
+
+DrawCommand& RenderQueue::submit(uint64_t key)
+{
+  DrawCommand* command = payloads.make<DrawCommand>();
+  entries.push_back({ key, command });
+  return *command;
+}
+
+void RenderQueue::sort()
+{
+  // Least significant byte first, stable, so each pass keeps the order of
+  // the ones before. All eight histograms come out of one read.
+  size_t count = entries.size();
+  if (count < 2)
+    return;
+
+  size_t histograms[8][256];
+  std::memset(histograms, 0, sizeof(histograms));
+  for (const Entry& entry : entries)
+  {
+    for (int pass = 0; pass < 8; pass++)
+      histograms[pass][(entry.key >> (pass * 8)) & 0xff]++;
+  }
+
+  scratch.resize(count);
+  for (int pass = 0; pass < 8; pass++)
+  {
+    size_t* histogram = histograms[pass];
+    int shift = pass * 8;
+
+    // A byte every key shares wouldn't move anything. Depth is often all
+    // zero and GL names are small, so most passes go.
+    if (histogram[(entries[0].key >> shift) & 0xff] == count)
+      continue;
+
+    size_t offsets[256];
+    size_t total = 0;
+    for (int digit = 0; digit < 256; digit++)
+    {
+      offsets[digit] = total;
+      total += histogram[digit];
+    }
+
+    for (const Entry& entry : entries)
+      scratch[offsets[(entry.key >> shift) & 0xff]++] = entry;
+    entries.swap(scratch);
+  }
+}
+
+void RenderQueue::execute(BatchRenderer& renderer, GpuProfiler& gpu)
+{
+  // Anything outside the queue may have bound since last frame
+  GlStateCache& state = renderer.state();
+  state.invalidate();
+
+  size_t begin = 0;
+  while (begin < entries.size())
+  {
+    Shader* shader = entries[begin].command->shader;
+    size_t end = begin + 1;
+    while (end < entries.size() && entries[end].command->shader == shader)
+      end++;
+
+    GpuProfileScope span(gpu, entries[begin].command->pass);
+    state.useProgram(shader->Id);
+    for (size_t i = begin; i < end; i++)
+    {
+      DrawCommand& command = *entries[i].command;
+      shader->set(command.model, command.modelValue);
+
+      if (command.instances.count > 0)
+        renderer.draw(command.mesh, command.instances);
+      else
+        renderer.draw(command.mesh);
+    }
+    begin = end;
+  }
+}
+
+void RenderQueue::reset()
+{
+  entries.clear();
+  payloads.reset();
+}
@@ -0,0 +1,106 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include "gpuprofiler.h"
+#include "renderer.h"
+#include "shader.h"
+
+/*
+ * ========================================
+ * Frame Allocator
+ * ========================================
+ * Bump allocation out of big blocks, all freed at once by reset(). Nothing
+ * moves until then. A frame that outgrows the first block chains more on,
+ * and the next reset() swaps them for one block big enough for the lot.
+ */
+class FrameAllocator
+{
+public:
+  explicit FrameAllocator(size_t blockBytes);
+  ~FrameAllocator();
+
+  void* allocate(size_t bytes, size_t alignment);
+  // Destructors never run, so only for types that don't need them
+  template <typename T>
+  T* make()
+  {
+    static_assert(std::is_trivially_destructible<T>::value, "reset() would leak what T owns");
+    return new (allocate(sizeof(T), alignof(T))) T();
+  }
+
+  void reset();
+  size_t used() const { return usedBytes; }
+
+private:
+  std::vector<char*> blocks;
+  size_t blockBytes; // Size of every block but the last when one allocation was bigger
+  size_t offset;     // Into the last block
+  size_t usedBytes;  // This frame, padding included
+};
+
+/*
+ * ========================================
+ * Render Queue
+ * ========================================
+ * Draws are recorded instead of issued: a 64-bit sort key and a payload in
+ * the frame allocator. Once the frame's draws are in they're radix sorted
+ * by key and replayed through the renderer's state cache, so every draw
+ * with the same program and mesh lands back to back and binds once.
+ *
+ * Keys from the top bit down: program, vertex array, material, depth. GL
+ * names are masked to fit, so two colliding only costs a bind, never the
+ * wrong one; the payload has the whole thing.
+ */
+static const int SORT_PROGRAM_BITS = 14;
+static const int SORT_MESH_BITS = 14;
+static const int SORT_MATERIAL_BITS = 12;
+static const int SORT_DEPTH_BITS = 24;
+
+// depth runs 0 at the camera to 1 at the far plane, nearest first so the
+// depth test throws away more of what's behind
+uint64_t sortKey(unsigned int program, unsigned int vao, unsigned int material, float depth);
+
+struct DrawCommand
+{
+  Shader* shader;
+  GpuMesh mesh;
+  InstanceBatch instances;  // count 0 draws the mesh once, without instance attributes
+  Uniform<glm::mat4> model; // Set first when the program has one
+  glm::mat4 modelValue;
+  const char* pass = "draws"; // GPU timer span, the first of a program's run names it
+};
+
+class RenderQueue
+{
+public:
+  RenderQueue();
+
+  // Payload for one draw, filled in by the caller, valid until reset()
+  DrawCommand& submit(uint64_t key);
+  void sort();
+  // Issues every draw in key order, or in submission order if not sorted,
+  // timing each run of draws with the same program on the GPU
+  void execute(BatchRenderer& renderer, GpuProfiler& gpu);
+  // Drops the frame's draws, after execute()
+  void reset();
+
+  size_t size() const { return entries.size(); }
+
+private:
+  struct Entry
+  {
+    uint64_t key;
+    DrawCommand* command;
+  };
+
+  FrameAllocator payloads;
+  std::vector<Entry> entries;
+  std::vector<Entry> scratch; // The other half of each radix pass
+};
+
+#endif
@@ -0,0 +1,272 @@
+#include "replay.h"
+#include "log.h"
+#include <chrono>
+#include <cstring>
+
+static void putVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+  while (value >= 0x80)
+  {
+    out.push_back((uint8_t) (value | 0x80));
+    value >>= 7;
+  }
+  out.push_back((uint8_t) value);
+}
+
+static bool getVarint(const std::vector<uint8_t>& in, size_t& at, uint64_t& value)
+{
+  value = 0;
+  for (int shift = 0; shift < 64 && at < in.size(); shift += 7)
+  {
+    uint8_t byte = in[at++];
+    value |= (uint64_t) (byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+/*
+ * ========================================
+ * State
+ * ========================================
+ */
+uint8_t packInput(const SimInput& input)
+{
+  return (uint8_t) (input.left | input.right << 1 | input.up << 2 | input.down << 3);
+}
+
+SimInput unpackInput(uint8_t bits)
+{
+  SimInput input;
+  input.left = bits & 1;
+  input.right = bits & 2;
+  input.up = bits & 4;
+  input.down = bits & 8;
+  return input;
+}
+
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t bytes)
+{
+  const uint8_t* p = (const uint8_t*) data;
+  for (size_t i = 0; i < bytes; i++)
+  {
+    hash ^= p[i];
+    hash *= 0x100000001B3ull;
+  }
+  return hash;
+}
+
+uint64_t hashState(const SimState& state)
+{
+  const EntityStore& world = state.world;
+  size_t count = world.size();
+
+  uint64_t hash = 0xCBF29CE484222325ull;
+  hash = hashBytes(hash, &state.tick, sizeof(state.tick));
+  hash = hashBytes(hash, &count, sizeof(count));
+  hash = hashBytes(hash, world.x.data(), count * sizeof(float));
+  hash = hashBytes(hash, world.y.data(), count * sizeof(float));
+  hash = hashBytes(hash, world.tiltX.data(), count * sizeof(float));
+  hash = hashBytes(hash, world.tiltY.data(), count * sizeof(float));
+  hash = hashBytes(hash, world.velX.data(), count * sizeof(float));
+  hash = hashBytes(hash, world.velY.data(), count * sizeof(float));
+  hash = hashBytes(hash, world.health.data(), count * sizeof(int32_t));
+  hash = hashBytes(hash, &state.light.x, sizeof(float));
+  hash = hashBytes(hash, &state.light.y, sizeof(float));
+  return hashBytes(hash, &state.light.z, sizeof(float));
+}
+
+/*
+ * ========================================
+ * Recording
+ * ========================================
+ */
+InputRecorder::InputRecorder()
+  : file(nullptr), previous(0), current(0), runTicks(0)
+{
+}
+
+InputRecorder::~InputRecorder()
+{
+  close();
+}
+
+bool InputRecorder::open(const char* path)
+{
+  close();
+
+  file = std::fopen(path, "wb");
+  if (!file)
+  {
+    LOG(ERROR, LOG_SIM, "ERROR::REPLAY::CANNOT_WRITE %s", path);
+    return false;
+  }
+
+  ReplayHeader header = { REPLAY_MAGIC, REPLAY_VERSION, SimConstants::DT };
+  std::fwrite(&header, sizeof(header), 1, file);
+
+  buffer.clear();
+  previous = current = 0;
+  runTicks = 0;
+  return true;
+}
+
+void InputRecorder::flushRun()
+{
+  if (runTicks == 0)
+    return;
+
+  buffer.push_back(REPLAY_RUN | (previous ^ current));
+  putVarint(buffer, runTicks);
+  previous = current;
+  runTicks = 0;
+}
+
+void InputRecorder::tick(const SimInput& input, const SimState& state)
+{
+  if (!file)
+    return;
+
+  uint8_t bits = packInput(input);
+  if (bits != current)
+  {
+    flushRun();
+    current = bits;
+  }
+  runTicks++;
+
+  if (state.tick % REPLAY_CHECKPOINT_TICKS == 0)
+    checkpoint(state);
+}
+
+void InputRecorder::checkpoint(const SimState& state)
+{
+  flushRun();
+  buffer.push_back(REPLAY_CHECKPOINT);
+  putVarint(buffer, state.tick);
+  uint64_t hash = hashState(state);
+  const uint8_t* bytes = (const uint8_t*) &hash;
+  buffer.insert(buffer.end(), bytes, bytes + sizeof(hash));
+
+  // A checkpoint is a good moment to get what we have onto disk
+  std::fwrite(buffer.data(), 1, buffer.size(), file);
+  buffer.clear();
+}
+
+void InputRecorder::close(const SimState& state)
+{
+  // tick() already wrote one if the last tick was on the interval
+  if (file && state.tick % REPLAY_CHECKPOINT_TICKS != 0)
+    checkpoint(state);
+  close();
+}
+
+void InputRecorder::close()
+{
+  if (!file)
+    return;
+
+  flushRun();
+  buffer.push_back(REPLAY_END);
+  std::fwrite(buffer.data(), 1, buffer.size(), file);
+  buffer.clear();
+
+  if (std::fclose(file) != 0)
+    LOG(ERROR, LOG_SIM, "ERROR::REPLAY::CANNOT_WRITE");
+  file = nullptr;
+}
+
+/*
+ * ========================================
+ * Replay
+ * ========================================
+ */
+int replayHeadless(const char* path)
+{
+  FILE* file = std::fopen(path, "rb");
+  if (!file)
+  {
+    LOG(ERROR, LOG_SIM, "ERROR::REPLAY::FILE_NOT_FOUND %s", path);
+    return 1;
+  }
+
+  ReplayHeader header;
+  bool valid = std::fread(&header, sizeof(header), 1, file) == 1 && header.magic == REPLAY_MAGIC &&
+               header.version == REPLAY_VERSION && header.dt == SimConstants::DT;
+
+  std::vector<uint8_t> stream;
+  uint8_t chunk[4096];
+  size_t read;
+  while ((read = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+    stream.insert(stream.end(), chunk, chunk + read);
+  std::fclose(file);
+
+  if (!valid)
+  {
+    LOG(ERROR, LOG_SIM, "ERROR::REPLAY::BAD_HEADER %s", path);
+    return 1;
+  }
+
+  SimState state;
+  uint8_t bits = 0;
+  unsigned int checkpoints = 0, mismatches = 0;
+  bool ended = false;
+  auto start = std::chrono::steady_clock::now();
+
+  size_t at = 0;
+  while (at < stream.size() && !ended)
+  {
+    uint8_t tag = stream[at++];
+    if (tag == REPLAY_END)
+    {
+      ended = true;
+    }
+    else if (tag == REPLAY_CHECKPOINT)
+    {
+      uint64_t tick, expected;
+      if (!getVarint(stream, at, tick) || at + sizeof(expected) > stream.size())
+        break;
+      std::memcpy(&expected, &stream[at], sizeof(expected));
+      at += sizeof(expected);
+
+      uint64_t actual = hashState(state);
+      checkpoints++;
+      if (tick != state.tick || actual != expected)
+      {
+        mismatches++;
+        std::printf("MISMATCH at tick %llu (replay at %llu): expected %016llx, got %016llx\n",
+                    (unsigned long long) tick, (unsigned long long) state.tick, (unsigned long long) expected,
+                    (unsigned long long) actual);
+      }
+    }
+    else if ((tag & 0xF0) == REPLAY_RUN)
+    {
+      uint64_t ticks;
+      if (!getVarint(stream, at, ticks))
+        break;
+
+      bits ^= tag & 0x0F;
+      SimInput input = unpackInput(bits);
+      for (uint64_t i = 0; i < ticks; i++)
+        step(state, SimConstants::DT, input);
+    }
+    else
+    {
+      break;
+    }
+  }
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  if (!ended)
+    LOG(WARN, LOG_SIM, "WARNING::REPLAY::TRUNCATED, recording stopped without an end marker");
+
+  std::printf("Replayed %llu ticks (%.1f s game time) in %.3f s, %.0f ticks/s\n", (unsigned long long) state.tick,
+              state.time, seconds, seconds > 0 ? state.tick / seconds : 0.0);
+  // A recording cut short, or with nothing to check, proves nothing
+  bool passed = mismatches == 0 && checkpoints > 0 && ended;
+  std::printf("%u checkpoints, %u mismatches: %s\n", checkpoints, mismatches,
+              passed ? "PASS" : mismatches ? "FAIL" : !ended ? "TRUNCATED" : "NO CHECKPOINTS");
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "simulation.h"
+
+/*
+ * ========================================
+ * Input Replays
+ * ========================================
+ * A recording is the input of every tick plus a hash of the simulation
+ * state every REPLAY_CHECKPOINT_TICKS and at the end. Since step() is deterministic for a
+ * given build, replaying the input reproduces the session exactly, and the
+ * hashes prove it did.
+ *
+ * The stream is tiny. Input only changes when a key does, so it's stored as
+ * runs: one byte of changed bits (XOR with the previous state) and a varint
+ * tick count.
+ *
+ *   header
+ *   REPLAY_RUN | changed bits, varint ticks
+ *   REPLAY_CHECKPOINT, varint tick, 8 byte state hash
+ *   ...
+ *   REPLAY_END
+ */
+static const uint32_t REPLAY_MAGIC = 0x43455241; // "AREC"
+static const uint32_t REPLAY_VERSION = 1;
+static const uint32_t REPLAY_CHECKPOINT_TICKS = 600; // 10 s
+
+enum ReplayTag : uint8_t
+{
+  REPLAY_RUN = 0x00, // Low four bits are the changed inputs
+  REPLAY_CHECKPOINT = 0x10,
+  REPLAY_END = 0xFF
+};
+
+struct ReplayHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  double dt;
+};
+
+uint8_t packInput(const SimInput& input);
+SimInput unpackInput(uint8_t bits);
+// FNV-1a over every live entity and the light, bit exact
+uint64_t hashState(const SimState& state);
+
+class InputRecorder
+{
+public:
+  InputRecorder();
+  ~InputRecorder();
+
+  bool open(const char* path);
+  // After each step(), with the input that step used
+  void tick(const SimInput& input, const SimState& state);
+  // Writes out the last run, a checkpoint of the final state and the end
+  // tag, so recordings shorter than a checkpoint interval can be checked too
+  void close(const SimState& state);
+  // Without the final checkpoint, done on destruction
+  void close();
+
+  bool recording() const { return file != nullptr; }
+
+private:
+  void flushRun();
+  void checkpoint(const SimState& state);
+
+  FILE* file;
+  std::vector<uint8_t> buffer;
+  uint8_t previous; // Input before the current run
+  uint8_t current;
+  uint64_t runTicks;
+};
+
+// Replays a recording with no window at full speed, checking every
+// checkpoint. Returns 0 if the recording ran to its end marker, had
+// checkpoints and they all matched.
+int replayHeadless(const char* path);
+
+#endif
@@ -0,0 +1,31 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+#ifdef INSTANCED
+layout (location = 1) in vec3 aColor;
+layout (location = 3) in mat4 aModel; // Per instance, takes locations 3-6
+#else
+uniform mat4 model;
+#endif
+
+out vec3 color;
+
+layout (std140) uniform Camera
+{
+  mat4 view;
+  mat4 projection;
+  vec3 lightPos;
+  vec3 lightColor;
+  vec4 clusters; // Tile size in pixels, slices per log depth, near plane
+};
+
+// Unlit stand-in while the real programs compile
+void main()
+{
+#ifdef INSTANCED
+  gl_Position = projection * view * aModel * vec4(aPos, 1.0);
+  color = aColor;
+#else
+  gl_Position = projection * view * model * vec4(aPos, 1.0);
+  color = vec3(1.0);
+#endif
+}
@@ -4,8 +4,22 @@ in vec3 FragPos;
 in vec3 color;
 in vec3 normal;
 
-uniform vec3 lightColor;
-uniform vec3 lightPos;
+layout (std140) uniform Camera
+{
+  mat4 view;
+  mat4 projection;
+  vec3 lightPos;
+  vec3 lightColor;
+  vec4 clusters; // Tile size in pixels, slices per log depth, near plane
+};
+
+#ifdef POINT_LIGHTS
+// Point lights, binned into clusters on the CPU (clusters.h). lighting.h
+// defines CLUSTER_X, CLUSTER_Y and CLUSTER_Z with it.
+uniform samplerBuffer lights;         // Two texels each: position and radius, colour
+uniform usamplerBuffer clusterRanges; // Per cluster: offset into clusterLights, count
+uniform usamplerBuffer clusterLights; // Light numbers
+#endif
 
 void main()
 {
@@ -17,6 +31,24 @@ void main()
   float diff = max(dot(norm, lightDir), 0.0);
   vec3 diffuse = diff * lightColor;
 
+#ifdef POINT_LIGHTS
+  // Only the lights whose range reaches this fragment's cluster
+  float depth = -(view * vec4(FragPos, 1.0)).z;
+  int slice = clamp(int(log(depth / clusters.w) * clusters.z), 0, CLUSTER_Z - 1);
+  ivec2 tile = min(ivec2(gl_FragCoord.xy / clusters.xy), ivec2(CLUSTER_X - 1, CLUSTER_Y - 1));
+  uvec2 range = texelFetch(clusterRanges, (slice * CLUSTER_Y + tile.y) * CLUSTER_X + tile.x).xy;
+  for (uint i = 0u; i < range.y; i++)
+  {
+    int light = int(texelFetch(clusterLights, int(range.x + i)).x);
+    vec4 sphere = texelFetch(lights, light * 2);
+    vec3 toLight = sphere.xyz - FragPos;
+    float distance = length(toLight);
+    float falloff = clamp(1.0 - distance / sphere.w, 0.0, 1.0);
+    float pointDiff = max(dot(norm, toLight / max(distance, 0.0001)), 0.0);
+    diffuse += pointDiff * falloff * falloff * texelFetch(lights, light * 2 + 1).rgb;
+  }
+#endif
+
   vec3 result = (ambient + diffuse) * color;
   FragColor = vec4(result, 1.0f);
 }
@@ -2,8 +2,15 @@
 layout (location = 0) in vec3 aPos;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+layout (std140) uniform Camera
+{
+  mat4 view;
+  mat4 projection;
+  vec3 lightPos;
+  vec3 lightColor;
+  vec4 clusters; // Tile size in pixels, slices per log depth, near plane
+};
 
 void main()
 {
@@ -1,20 +1,32 @@
 #version 330 core
+// Stored packed (vertexformat.h), GL unpacks them to floats: half float
+// positions, unsigned byte colours and normals in 2_10_10_10, whose unused
+// w is 0
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aColor;
-layout (location = 2) in vec3 aNormal;
+layout (location = 2) in vec4 aNormal;
+layout (location = 3) in mat4 aModel; // Per instance, takes locations 3-6
 
 out vec3 FragPos;
 out vec3 color;
 out vec3 normal;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Camera
+{
+  mat4 view;
+  mat4 projection;
+  vec3 lightPos;
+  vec3 lightColor;
+  vec4 clusters; // Tile size in pixels, slices per log depth, near plane
+};
 
 void main()
 {
-  gl_Position = projection * view * model * vec4(aPos.x, aPos.y, aPos.z, 1.0);
-  FragPos = vec3(model * vec4(aPos, 1.0));
+  vec4 worldPos = aModel * vec4(aPos, 1.0);
+  gl_Position = projection * view * worldPos;
+  FragPos = vec3(worldPos);
   color = aColor;
-  normal = aNormal;
+  // Models are only ever rotated and translated, so no inverse transpose.
+  // 10 bit normals aren't quite unit length, the fragment shader fixes that.
+  normal = mat3(aModel) * aNormal.xyz;
 }
@@ -0,0 +1,289 @@
+#include "scene.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include "log.h"
+#include "profiler.h"
+#include "transforms.h"
+
+/*
+ * ========================================
+ * Setup
+ * ========================================
+ */
+void submitPrograms(Scene& scene, const char* cacheDirectory)
+{
+  // Everything is submitted at once so the driver compiles it side by side,
+  // and through the program cache when the driver still takes its binaries
+  scene.programCache = new ProgramCache(cacheDirectory);
+  scene.shaders = new ShaderCompiler(scene.programCache);
+  ShaderCompiler* shaders = scene.shaders;
+
+  scene.fallback = shaders->submit("res/shaders/fallback_vertex.glsl", "res/shaders/fallback_fragment.glsl", { "INSTANCED" });
+  scene.LIGHT.fallback = shaders->submit("res/shaders/fallback_vertex.glsl", "res/shaders/fallback_fragment.glsl");
+  scene.program = shaders->submit("res/shaders/vertex.glsl", "res/shaders/fragment.glsl", {}, scene.fallback);
+  scene.LIT.program = shaders->submit("res/shaders/vertex.glsl", "res/shaders/fragment.glsl", clusterDefines(),
+                                      scene.fallback);
+  scene.LIGHT.program = shaders->submit("res/shaders/light_vertex.glsl", "res/shaders/light_fragment.glsl", {}, scene.LIGHT.fallback);
+  shaders->poll();
+}
+
+void waitForPrograms(Scene& scene, bool all)
+{
+  scene.shaders->wait(scene.fallback);
+  scene.shaders->wait(scene.LIGHT.fallback);
+  if (all)
+  {
+    scene.shaders->wait(scene.program);
+    scene.shaders->wait(scene.LIT.program);
+    scene.shaders->wait(scene.LIGHT.program);
+  }
+}
+
+bool resolveShaders(Scene& scene)
+{
+  ShaderCompiler* shaders = scene.shaders;
+  Shader* shader = shaders->get(scene.program);
+  Shader* litShader = shaders->get(scene.LIT.program);
+  Shader* lightShader = shaders->get(scene.LIGHT.program);
+
+  // Only when a program and its fallback both failed. The scene keeps
+  // whatever it had, which at startup is nothing to draw with.
+  if (!shader || !litShader || !lightShader)
+  {
+    LOG(ERROR, LOG_SHADER, "ERROR::SHADER::NO_PROGRAM%s%s%s", shader ? "" : " ships", litShader ? "" : " lit ships",
+        lightShader ? "" : " light");
+    return false;
+  }
+  scene.shader = shader;
+  scene.LIT.shader = litShader;
+  scene.LIGHT.shader = lightShader;
+
+  // Uniform handles belong to one program, look them up again
+  scene.LIGHT.UNIFORMS.model = scene.LIGHT.shader->uniform<glm::mat4>("model");
+  scene.LIT.UNIFORMS.lights = scene.LIT.shader->uniform<int>("lights");
+  scene.LIT.UNIFORMS.clusterRanges = scene.LIT.shader->uniform<int>("clusterRanges");
+  scene.LIT.UNIFORMS.clusterLights = scene.LIT.shader->uniform<int>("clusterLights");
+
+  // The light buffers' texture units never change
+  scene.LIT.shader->use();
+  scene.LIT.shader->set(scene.LIT.UNIFORMS.lights, (int) LIGHT_TEXTURE_UNIT);
+  scene.LIT.shader->set(scene.LIT.UNIFORMS.clusterRanges, (int) LIGHT_TEXTURE_UNIT + 1);
+  scene.LIT.shader->set(scene.LIT.UNIFORMS.clusterLights, (int) LIGHT_TEXTURE_UNIT + 2);
+
+  // View, projection and light are shared by every program
+  scene.shader->bindBlock("Camera", CAMERA_BINDING);
+  scene.LIT.shader->bindBlock("Camera", CAMERA_BINDING);
+  scene.LIGHT.shader->bindBlock("Camera", CAMERA_BINDING);
+  return true;
+}
+
+// Radius on screen, in pixels, a mesh needs to be drawn with each LOD but
+// the last, one for every ship LOD after the first. Against the bounding
+// sphere, which is generous for the ship.
+static const float LOD_PIXELS[SHIP_LODS - 1] = { 32.0f, 12.0f };
+
+bool createRenderer(Scene& scene, int width, int height)
+{
+  // Enable/Set up some OpenGL stuff
+  //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE); // Wireframe mode
+  glEnable(GL_DEPTH_TEST);
+
+  scene.camera = new Camera(width, height);
+  scene.view = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -20.0f));
+  scene.culling = true;
+  if (!resolveShaders(scene))
+    return false;
+
+  scene.renderer = new BatchRenderer();
+  scene.queue = new RenderQueue();
+  scene.clusterLights = true;
+  scene.clusterBuffers = new ClusterBuffers();
+  scene.gpuProfiler = new GpuProfiler();
+  return true;
+}
+
+void addMeshLod(Scene& scene, MeshId mesh, int lod, const MeshFile& file)
+{
+  SceneMesh& sceneMesh = scene.meshes[mesh];
+  sceneMesh.lods[lod] = scene.renderer->addMesh(file);
+  sceneMesh.lodCount = std::max(sceneMesh.lodCount, lod + 1);
+
+  // Entities turn about their origin, so the sphere has to hold the model
+  // whichever way it faces
+  if (lod == 0)
+  {
+    const MeshFileHeader& header = file.header();
+    const float* center = header.sphereCenter;
+    sceneMesh.radius = std::sqrt(center[0] * center[0] + center[1] * center[1] + center[2] * center[2]) +
+                       header.sphereRadius;
+  }
+}
+
+/*
+ * ========================================
+ * Draw
+ * ========================================
+ */
+static void gatherTransforms(const EntityTransforms& from, const std::vector<uint32_t>& indices, EntityTransforms& out)
+{
+  size_t count = indices.size();
+  out.x.resize(count);
+  out.y.resize(count);
+  out.tiltX.resize(count);
+  out.tiltY.resize(count);
+  for (size_t i = 0; i < count; i++)
+  {
+    uint32_t index = indices[i];
+    out.x[i] = from.x[index];
+    out.y[i] = from.y[index];
+    out.tiltX[i] = from.tiltX[index];
+    out.tiltY[i] = from.tiltY[index];
+  }
+}
+
+// Queues one instanced draw of these transforms. The batch spans the
+// whole view, so it sorts as if at the camera.
+static void drawInstances(Scene& scene, Shader* shader, int mesh, const EntityTransforms& transforms)
+{
+  InstanceBatch batch = scene.renderer->instances(transforms.x.size());
+  if (!batch.transforms)
+    return;
+  buildModelMatrices(transforms.x.data(), transforms.y.data(), transforms.tiltX.data(), transforms.tiltY.data(),
+                     batch.count, (float*) batch.transforms);
+
+  const GpuMesh& gpuMesh = scene.renderer->mesh(mesh);
+  DrawCommand& draw = scene.queue->submit(sortKey(shader->Id, gpuMesh.VAO, 0, 0.0f));
+  draw.shader = shader;
+  draw.mesh = gpuMesh;
+  draw.instances = batch;
+  draw.pass = "ships";
+}
+
+void blendScene(Scene& scene, const FrameSnapshot& snapshot, float alpha)
+{
+  for (int m = 0; m < MESH_COUNT; m++)
+    interpolate(snapshot, alpha, m, scene.blended[m]);
+}
+
+void drawScene(Scene& scene, const FrameSnapshot& snapshot, float alpha)
+{
+  // Swap in programs as they finish compiling
+  ShaderCompiler* shaders = scene.shaders;
+  if (shaders->pending())
+  {
+    if (shaders->poll())
+      resolveShaders(scene);
+
+    if (!shaders->pending())
+    {
+      ShaderCompilerStats stats = shaders->stats();
+      ProgramCacheStats cacheStats = scene.programCache->takeStats();
+      LOG(INFO, LOG_SHADER, "Shaders: %u programs done %g ms after startup, %u cached, %u rejected, %u failed%s",
+          stats.programs, stats.readyMs, cacheStats.hits, cacheStats.rejected, stats.failed,
+          shaders->parallel() ? " (parallel)" : "");
+    }
+  }
+
+  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+  // Render between the last two ticks so motion stays smooth at any frame rate
+  SimLight lightPos = interpolate(snapshot, alpha);
+
+  // Camera and light for every program
+  scene.camera->update(scene.view, glm::vec3(lightPos.x, lightPos.y, lightPos.z), glm::vec3(1.0f, 1.0f, 1.0f));
+
+  // Each point light into the clusters it reaches, for the fragment shader
+  ClusterView clusterView = makeClusterView(glm::value_ptr(scene.view), glm::value_ptr(scene.camera->projection()),
+                                            CAMERA_NEAR, CAMERA_FAR);
+  LightClusters& clusters = scene.clusters;
+  assignLights(clusterView, scene.lights.data(), scene.lights.size(), clusters, scene.jobs, !scene.clusterLights);
+  profiler.count(COUNTER_LIGHTS, clusters.lights);
+  profiler.count(COUNTER_LIGHT_ENTRIES, clusters.indices.size() * (scene.clusterLights ? 1 : CLUSTER_COUNT));
+
+  // Without any, the ships keep the program that doesn't look for them
+  Shader* shipShader = scene.shader;
+  if (clusters.lights > 0)
+  {
+    scene.clusterBuffers->upload(scene.lights.data(), clusters);
+    scene.clusterBuffers->bind();
+    shipShader = scene.LIT.shader;
+  }
+
+  // What the camera can't see is dropped here, the rest is sorted into LODs
+  // by how big it comes out on screen
+  glm::mat4 viewProjection = scene.camera->projection() * scene.view;
+  CullView cullView = makeCullView(glm::value_ptr(viewProjection), scene.camera->pixelScale(), LOD_PIXELS,
+                                   SHIP_LODS);
+
+  // 3D Stuff, one batch per mesh and LOD, matrices built straight into GPU
+  // memory. Nothing reaches GL until the queue is replayed, so the stream
+  // ring makes room for every ship before the first batch.
+  size_t ships = 0;
+  for (int m = 0; m < MESH_COUNT; m++)
+    ships += scene.blended[m].x.size();
+  scene.renderer->reserve((unsigned int) ships);
+
+  for (int m = 0; m < MESH_COUNT; m++)
+  {
+    const EntityTransforms& blended = scene.blended[m];
+    if (blended.x.empty())
+      continue;
+
+    const SceneMesh& mesh = scene.meshes[m];
+    if (!scene.culling)
+    {
+      drawInstances(scene, shipShader, mesh.lods[0], blended);
+      profiler.count(COUNTER_VISIBLE, blended.x.size());
+      continue;
+    }
+
+    VisibleSet& visible = scene.visible;
+    cullSpheres(cullView, blended.x.data(), blended.y.data(), blended.x.size(), mesh.radius, mesh.lodCount, visible);
+    size_t drawn = visible.visible();
+    profiler.count(COUNTER_VISIBLE, drawn);
+    profiler.count(COUNTER_CULLED, blended.x.size() - drawn);
+
+    for (int lod = 0; lod < mesh.lodCount; lod++)
+    {
+      if (visible.lods[lod].empty())
+        continue;
+      gatherTransforms(blended, visible.lods[lod], scene.lodTransforms);
+      drawInstances(scene, shipShader, mesh.lods[lod], scene.lodTransforms);
+    }
+  }
+
+  // The light
+  glm::vec3 lightCenter(lightPos.x, lightPos.y, lightPos.z);
+  float lightDepth = -(scene.view * glm::vec4(lightCenter, 1.0f)).z / CAMERA_FAR;
+  Shader* lightShader = scene.LIGHT.shader;
+  DrawCommand& light = scene.queue->submit(sortKey(lightShader->Id, scene.lightMesh.VAO, 0, lightDepth));
+  light.shader = lightShader;
+  light.mesh = scene.lightMesh;
+  light.model = scene.LIGHT.UNIFORMS.model;
+  light.modelValue = glm::translate(glm::mat4(1.0f), lightCenter);
+  light.pass = "light";
+
+  // Grouped by program and mesh, then drawn, a GPU span per program
+  RenderQueue& queue = *scene.queue;
+  queue.sort();
+  queue.execute(*scene.renderer, *scene.gpuProfiler);
+  queue.reset();
+
+  scene.renderer->endFrame();
+  scene.gpuProfiler->endFrame();
+}
+
+void destroyScene(Scene& scene)
+{
+  delete scene.shaders;
+  delete scene.programCache;
+  delete scene.camera;
+  delete scene.gpuProfiler;
+  deleteMesh(scene.lightMesh);
+  delete scene.clusterBuffers;
+  delete scene.queue;
+  delete scene.renderer;
+}
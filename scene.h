@@ -0,0 +1,110 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "camera.h"
+#include "clusters.h"
+#include "culling.h"
+#include "gpuprofiler.h"
+#include "jobs.h"
+#include "lighting.h"
+#include "programcache.h"
+#include "renderer.h"
+#include "renderqueue.h"
+#include "shader.h"
+#include "shadercompiler.h"
+#include "shipmeshes.h"
+#include "meshfile.h"
+#include "snapshot.h"
+
+/*
+ * ========================================
+ * Scene
+ * ========================================
+ * Everything on the GPU that draws the simulation, and the draw itself.
+ * Knows nothing about where the frame ends up, the game swaps it to a
+ * window and astro_renderbench reads it back from an offscreen FBO.
+ *
+ * Needs a current GL context for all of it.
+ */
+static_assert(SHIP_LODS <= CULL_MAX_LODS, "culling picks from at most CULL_MAX_LODS LODs");
+
+// One sim MeshId on the GPU
+struct SceneMesh
+{
+  int lods[CULL_MAX_LODS]; // Renderer meshes, most detailed first
+  int lodCount;
+  float radius; // Bounding sphere around the model origin, from LOD 0
+};
+
+struct Scene
+{
+  Camera* camera;
+  BatchRenderer* renderer;
+  RenderQueue* queue; // Every draw of a frame goes through it
+  GpuProfiler* gpuProfiler;
+  glm::mat4 view;
+  SceneMesh meshes[MESH_COUNT];
+  bool culling; // Off draws everything at full detail, to compare with
+  EntityTransforms blended[MESH_COUNT]; // This frame's entities, see blendScene
+  VisibleSet visible;
+  EntityTransforms lodTransforms; // blended, just the ones drawn with one LOD
+  // Point lights besides the main one, refilled by the caller every frame
+  std::vector<PointLight> lights;
+  bool clusterLights; // Off shades every light everywhere, to compare with
+  LightClusters clusters;
+  ClusterBuffers* clusterBuffers;
+  JobSystem* jobs; // Bins lights across cores when set
+  ProgramCache* programCache;
+  ShaderCompiler* shaders;
+  ProgramId program;
+  ProgramId fallback;
+  Shader* shader; // program, or its fallback until it's compiled
+  // program with point lights, for frames that have any. Same fallback.
+  struct
+  {
+    ProgramId program;
+    Shader* shader;
+    struct
+    {
+      Uniform<int> lights;
+      Uniform<int> clusterRanges;
+      Uniform<int> clusterLights;
+    } UNIFORMS;
+  } LIT;
+  struct
+  {
+    ProgramId program;
+    ProgramId fallback;
+    Shader* shader;
+    struct
+    {
+      Uniform<glm::mat4> model;
+    } UNIFORMS;
+  } LIGHT;
+  GpuMesh lightMesh;
+};
+
+// Starts every program compiling, through the cache in cacheDirectory
+void submitPrograms(Scene& scene, const char* cacheDirectory);
+// Blocks on the fallbacks, or on the real programs too
+void waitForPrograms(Scene& scene, bool all);
+// Points the draw code at the best program each has so far, false if one
+// has neither it nor its fallback
+bool resolveShaders(Scene& scene);
+// Camera, renderer and GPU timers, meshes are added after. False without
+// programs to draw with, see resolveShaders.
+bool createRenderer(Scene& scene, int width, int height);
+// Uploads one LOD of a mesh, they can come in any order
+void addMeshLod(Scene& scene, MeshId mesh, int lod, const MeshFile& file);
+
+// Blends every entity alpha of the way from the snapshot's previous tick to
+// its latest, into scene.blended. Once per frame, before drawScene, so
+// whatever else follows the ships can read them from there.
+void blendScene(Scene& scene, const FrameSnapshot& snapshot, float alpha);
+// One frame of what blendScene left, the main light blended the same alpha.
+// Leaves presenting it to the caller.
+void drawScene(Scene& scene, const FrameSnapshot& snapshot, float alpha);
+
+void destroyScene(Scene& scene);
+
+#endif
@@ -1,40 +1,41 @@
 #include "shader.h"
-#include <fstream>
-#include <sstream>
-#include <iostream>
+#include <glm/gtc/type_ptr.hpp>
+#include <cstring>
+#include "log.h"
+#include "profiler.h"
+#include "shadersource.h"
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath)
+Shader::Shader(const char* vertexPath, const char* fragmentPath, ProgramCache* cache)
 {
-  /*
-   * Get the shaders from the files into strings
-   */
-  std::string vertexCode;
-  std::string fragmentCode;
-  std::ifstream vShaderFile;
-  std::ifstream fShaderFile;
-  vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-  fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-
-  try
-  {
-    vShaderFile.open(vertexPath);
-    fShaderFile.open(fragmentPath);
-    std::stringstream vShaderStream, fShaderStream;
-
-    vShaderStream << vShaderFile.rdbuf();
-    fShaderStream << fShaderFile.rdbuf();
+  std::string vertexCode = readShaderFile(vertexPath);
+  std::string fragmentCode = readShaderFile(fragmentPath);
 
-    vShaderFile.close();
-    fShaderFile.close();
-
-    vertexCode = vShaderStream.str();
-    fragmentCode = fShaderStream.str();
-  }
-  catch(std::ifstream::failure e)
+  Id = glCreateProgram();
+  if (!cache || !cache->load(Id, vertexCode, fragmentCode))
   {
-    std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
+    if (cache)
+    {
+      // A rejected binary can leave state behind, start from a clean program
+      glDeleteProgram(Id);
+      Id = glCreateProgram();
+      glProgramParameteri(Id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    if (compile(vertexCode, fragmentCode) && cache)
+      cache->store(Id, vertexCode, fragmentCode);
   }
 
+  findUniforms();
+}
+
+Shader::Shader(unsigned int program)
+  : Id(program)
+{
+  findUniforms();
+}
+
+bool Shader::compile(const std::string& vertexCode, const std::string& fragmentCode)
+{
   const char* vShaderCode = vertexCode.c_str();
   const char* fShaderCode = fragmentCode.c_str();
 
@@ -54,7 +55,7 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
   if (!success)
   {
     glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-    std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+    LOG(ERROR, LOG_SHADER, "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n%s", infoLog);
   }
 
   // Fragment Shader
@@ -66,11 +67,10 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
   if (!success)
   {
     glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-    std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+    LOG(ERROR, LOG_SHADER, "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n%s", infoLog);
   }
 
   // Link shaders
-  Id = glCreateProgram();
   glAttachShader(Id, vertex);
   glAttachShader(Id, fragment);
   glLinkProgram(Id);
@@ -79,11 +79,19 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
   if (!success)
   {
     glGetProgramInfoLog(Id, 512, NULL, infoLog);
-    std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    LOG(ERROR, LOG_SHADER, "ERROR::SHADER::PROGRAM::LINKING_FAILED\n%s", infoLog);
   }
 
+  glDetachShader(Id, vertex);
+  glDetachShader(Id, fragment);
   glDeleteShader(vertex);
   glDeleteShader(fragment);
+  return success;
+}
+
+Shader::~Shader()
+{
+  glDeleteProgram(Id);
 }
 
 void Shader::use()
@@ -91,17 +99,120 @@ void Shader::use()
   glUseProgram(Id);
 }
 
-void Shader::setBool(const std::string& name, bool value) const
+void Shader::bindBlock(const std::string& name, unsigned int binding)
+{
+  unsigned int index = glGetUniformBlockIndex(Id, name.c_str());
+  if (index == GL_INVALID_INDEX)
+  {
+    LOG(ERROR, LOG_SHADER, "ERROR::SHADER::UNIFORM_BLOCK_NOT_FOUND %s", name.c_str());
+    return;
+  }
+  glUniformBlockBinding(Id, index, binding);
+}
+
+/*
+ * Uniforms
+ */
+void Shader::findUniforms()
+{
+  int count = 0;
+  glGetProgramiv(Id, GL_ACTIVE_UNIFORMS, &count);
+
+  char name[256];
+  for (int i = 0; i < count; i++)
+  {
+    int length, size;
+    GLenum type;
+    glGetActiveUniform(Id, i, sizeof(name), &length, &size, &type, name);
+
+    // Members of uniform blocks have no location
+    int location = glGetUniformLocation(Id, name);
+    if (location < 0)
+      continue;
+
+    Slot slot;
+    slot.location = location;
+    slot.cached = false;
+
+    // Arrays are reported as "name[0]", make "name" work too
+    std::string key(name, length);
+    if (size > 1 && key.size() > 3 && key.compare(key.size() - 3, 3, "[0]") == 0)
+      slotNames[key.substr(0, key.size() - 3)] = (int) slots.size();
+
+    slotNames[key] = (int) slots.size();
+    slots.push_back(slot);
+  }
+}
+
+bool Shader::changed(int slot, const void* value, size_t size)
+{
+  Slot& s = slots[slot];
+  if (s.cached && std::memcmp(s.value, value, size) == 0)
+    return false;
+
+  std::memcpy(s.value, value, size);
+  s.cached = true;
+  return true;
+}
+
+void Shader::set(Uniform<bool> uniform, bool value)
+{
+  set(Uniform<int> { uniform.slot }, (int) value);
+}
+
+void Shader::set(Uniform<int> uniform, int value)
+{
+  if (uniform.slot < 0 || !changed(uniform.slot, &value, sizeof(value)))
+    return;
+  profiler.count(COUNTER_UNIFORMS);
+  glUniform1i(slots[uniform.slot].location, value);
+}
+
+void Shader::set(Uniform<float> uniform, float value)
+{
+  if (uniform.slot < 0 || !changed(uniform.slot, &value, sizeof(value)))
+    return;
+  profiler.count(COUNTER_UNIFORMS);
+  glUniform1f(slots[uniform.slot].location, value);
+}
+
+void Shader::set(Uniform<glm::vec3> uniform, const glm::vec3& value)
+{
+  if (uniform.slot < 0 || !changed(uniform.slot, glm::value_ptr(value), sizeof(float) * 3))
+    return;
+  profiler.count(COUNTER_UNIFORMS);
+  glUniform3fv(slots[uniform.slot].location, 1, glm::value_ptr(value));
+}
+
+void Shader::set(Uniform<glm::mat4> uniform, const glm::mat4& value)
+{
+  if (uniform.slot < 0 || !changed(uniform.slot, glm::value_ptr(value), sizeof(float) * 16))
+    return;
+  profiler.count(COUNTER_UNIFORMS);
+  glUniformMatrix4fv(slots[uniform.slot].location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Shader::setBool(const std::string& name, bool value)
+{
+  set(uniform<bool>(name), value);
+}
+
+void Shader::setInt(const std::string& name, int value)
+{
+  set(uniform<int>(name), value);
+}
+
+void Shader::setFloat(const std::string& name, float value)
 {
-  glUniform1i(glGetUniformLocation(Id, name.c_str()), (int) value);
+  set(uniform<float>(name), value);
 }
 
-void Shader::setInt(const std::string& name, int value) const
+void Shader::setVec3(const std::string& name, float x, float y, float z)
 {
-  glUniform1i(glGetUniformLocation(Id, name.c_str()), value);
+  set(uniform<glm::vec3>(name), glm::vec3(x, y, z));
 }
 
-void Shader::setFloat(const std::string& name, float value) const
+void Shader::setMat4(const std::string& name, const glm::mat4& value)
 {
-  glUniform1f(glGetUniformLocation(Id, name.c_str()), value);
+  set(uniform<glm::mat4>(name), value);
 }
@@ -0,0 +1,88 @@
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "programcache.h"
+
+/*
+ * ========================================
+ * Shader Class
+ * ========================================
+ * Active uniforms are looked up once at link time. Grab a typed handle with
+ * uniform<T>("name") at load time and set through it every frame; sets that
+ * don't change the value never reach the driver.
+ *
+ * Like glUniform*, every set goes to the currently bound program, so use()
+ * this shader first.
+ *
+ * Given a ProgramCache the linked binary is loaded from disk when it can
+ * be, and compiled from source and saved for next time when it can't.
+ */
+template <typename T>
+struct Uniform
+{
+  int slot = -1; // -1 when the program has no such active uniform
+};
+
+class Shader
+{
+public:
+  unsigned int Id;
+
+  Shader(const char* vertexPath, const char* fragmentPath, ProgramCache* cache = nullptr);
+  // Takes over an already linked program, see ShaderCompiler
+  explicit Shader(unsigned int program);
+  ~Shader();
+  Shader(const Shader&) = delete;
+  Shader& operator=(const Shader&) = delete;
+
+  void use();
+  // Points a uniform block at a buffer binding point, once after linking
+  void bindBlock(const std::string& name, unsigned int binding);
+
+  template <typename T>
+  Uniform<T> uniform(const std::string& name) const
+  {
+    Uniform<T> handle;
+    auto found = slotNames.find(name);
+    if (found != slotNames.end())
+      handle.slot = found->second;
+    return handle;
+  }
+
+  void set(Uniform<bool> uniform, bool value);
+  void set(Uniform<int> uniform, int value);
+  void set(Uniform<float> uniform, float value);
+  void set(Uniform<glm::vec3> uniform, const glm::vec3& value);
+  void set(Uniform<glm::mat4> uniform, const glm::mat4& value);
+
+  // By name, for one-off sets. Still cached, but pays a hash lookup.
+  void setBool(const std::string& name, bool value);
+  void setInt(const std::string& name, int value);
+  void setFloat(const std::string& name, float value);
+  void setVec3(const std::string& name, float x, float y, float z);
+  void setMat4(const std::string& name, const glm::mat4& value);
+
+private:
+  struct Slot
+  {
+    int location;
+    bool cached;
+    float value[16]; // Last value sent, big enough for a mat4
+  };
+
+  // Compiles and links the sources into Id, false if anything failed
+  bool compile(const std::string& vertexCode, const std::string& fragmentCode);
+  void findUniforms();
+  // Copies value into the slot, false if it was already there
+  bool changed(int slot, const void* value, size_t size);
+
+  std::vector<Slot> slots;
+  std::unordered_map<std::string, int> slotNames;
+};
+
+#endif
@@ -0,0 +1,245 @@
+#include "shadercompiler.h"
+#include "log.h"
+#include "shadersource.h"
+#include <thread>
+
+static unsigned int compileShader(GLenum type, const std::string& code)
+{
+  const char* source = code.c_str();
+  unsigned int shader = glCreateShader(type);
+  glShaderSource(shader, 1, &source, NULL);
+  glCompileShader(shader);
+  return shader;
+}
+
+static void printShaderErrors(unsigned int shader, const char* stage)
+{
+  int success;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+  if (success)
+    return;
+
+  char infoLog[512];
+  glGetShaderInfoLog(shader, 512, NULL, infoLog);
+  LOG(ERROR, LOG_SHADER, "ERROR::SHADER::%s::COMPILATION_FAILED\n%s", stage, infoLog);
+}
+
+/*
+ * ========================================
+ * Shader Compiler
+ * ========================================
+ */
+ShaderCompiler::ShaderCompiler(ProgramCache* cache)
+  : cache(cache), threaded(false), busy(0), start(std::chrono::steady_clock::now())
+{
+  // As many driver threads as it's willing to give us
+  if (GLEW_KHR_parallel_shader_compile)
+  {
+    glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    threaded = true;
+  }
+  else if (GLEW_ARB_parallel_shader_compile)
+  {
+    glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+    threaded = true;
+  }
+}
+
+ShaderCompiler::~ShaderCompiler()
+{
+  for (Program& program : programs)
+  {
+    if (program.shader)
+    {
+      delete program.shader;
+      continue;
+    }
+
+    // Never finished, the futures are joined by their destructors
+    if (program.id)
+      glDeleteProgram(program.id);
+    if (program.vertex)
+      glDeleteShader(program.vertex);
+    if (program.fragment)
+      glDeleteShader(program.fragment);
+  }
+}
+
+std::shared_future<std::string> ShaderCompiler::read(const std::string& path)
+{
+  auto found = files.find(path);
+  if (found != files.end())
+    return found->second;
+
+  std::shared_future<std::string> file = std::async(std::launch::async, readShaderFile, path).share();
+  files[path] = file;
+  return file;
+}
+
+ProgramId ShaderCompiler::submit(const std::string& vertexPath, const std::string& fragmentPath,
+                                 const std::vector<std::string>& defines, ProgramId fallback)
+{
+  Program program;
+  program.stage = Stage::READING;
+  program.vertexFile = read(vertexPath);
+  program.fragmentFile = read(fragmentPath);
+  program.defines = defines;
+  program.fallback = fallback;
+  program.id = 0;
+  program.vertex = 0;
+  program.fragment = 0;
+  program.shader = nullptr;
+  program.announced = false;
+
+  programs.push_back(program);
+  busy++;
+  counters.programs++;
+  return (ProgramId) programs.size() - 1;
+}
+
+bool ShaderCompiler::startLink(Program& program)
+{
+  auto now = std::chrono::seconds(0);
+  if (program.vertexFile.wait_for(now) != std::future_status::ready ||
+      program.fragmentFile.wait_for(now) != std::future_status::ready)
+    return false;
+
+  program.vertexCode = withDefines(program.vertexFile.get(), program.defines);
+  program.fragmentCode = withDefines(program.fragmentFile.get(), program.defines);
+  // Done with the files, drop our hold on them
+  program.vertexFile = std::shared_future<std::string>();
+  program.fragmentFile = std::shared_future<std::string>();
+
+  program.id = glCreateProgram();
+  if (cache && cache->load(program.id, program.vertexCode, program.fragmentCode))
+  {
+    program.stage = Stage::READY;
+    finished(program);
+    return true;
+  }
+
+  if (cache)
+  {
+    // A rejected binary can leave state behind, start from a clean program
+    glDeleteProgram(program.id);
+    program.id = glCreateProgram();
+    glProgramParameteri(program.id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+
+  // With parallel compile these only queue work, the link waits on the
+  // compiles driver side
+  program.vertex = compileShader(GL_VERTEX_SHADER, program.vertexCode);
+  program.fragment = compileShader(GL_FRAGMENT_SHADER, program.fragmentCode);
+  glAttachShader(program.id, program.vertex);
+  glAttachShader(program.id, program.fragment);
+  glLinkProgram(program.id);
+
+  program.stage = Stage::LINKING;
+  return true;
+}
+
+bool ShaderCompiler::finishLink(Program& program)
+{
+  if (threaded)
+  {
+    int complete = GL_FALSE;
+    glGetProgramiv(program.id, GL_COMPLETION_STATUS_KHR, &complete);
+    if (!complete)
+      return false;
+  }
+
+  int success;
+  glGetProgramiv(program.id, GL_LINK_STATUS, &success);
+  if (!success)
+  {
+    printShaderErrors(program.vertex, "VERTEX");
+    printShaderErrors(program.fragment, "FRAGMENT");
+
+    char infoLog[512];
+    glGetProgramInfoLog(program.id, 512, NULL, infoLog);
+    LOG(ERROR, LOG_SHADER, "ERROR::SHADER::PROGRAM::LINKING_FAILED\n%s", infoLog);
+  }
+  else if (cache)
+  {
+    cache->store(program.id, program.vertexCode, program.fragmentCode);
+  }
+
+  glDetachShader(program.id, program.vertex);
+  glDetachShader(program.id, program.fragment);
+  glDeleteShader(program.vertex);
+  glDeleteShader(program.fragment);
+  program.vertex = 0;
+  program.fragment = 0;
+
+  program.stage = success ? Stage::READY : Stage::FAILED;
+  finished(program);
+  return true;
+}
+
+void ShaderCompiler::finished(Program& program)
+{
+  if (program.stage == Stage::READY)
+  {
+    program.shader = new Shader(program.id);
+  }
+  else
+  {
+    // Stays on its fallback for good
+    glDeleteProgram(program.id);
+    counters.failed++;
+  }
+  program.id = 0;
+  program.vertexCode.clear();
+  program.fragmentCode.clear();
+
+  busy--;
+  if (busy == 0)
+    counters.readyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool ShaderCompiler::poll()
+{
+  bool changed = false;
+  for (Program& program : programs)
+  {
+    if (program.stage == Stage::READING)
+      startLink(program);
+    if (program.stage == Stage::LINKING)
+      finishLink(program);
+
+    changed = changed || (program.shader && !program.announced);
+    program.announced = program.shader != nullptr;
+  }
+  return changed;
+}
+
+void ShaderCompiler::wait(ProgramId program)
+{
+  while (programs[program].stage == Stage::READING || programs[program].stage == Stage::LINKING)
+  {
+    if (programs[program].stage == Stage::READING)
+    {
+      programs[program].vertexFile.wait();
+      programs[program].fragmentFile.wait();
+      startLink(programs[program]);
+    }
+    if (programs[program].stage == Stage::LINKING && !finishLink(programs[program]))
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+}
+
+Shader* ShaderCompiler::get(ProgramId program) const
+{
+  while (program != NO_PROGRAM)
+  {
+    if (programs[program].shader)
+      return programs[program].shader;
+    program = programs[program].fallback;
+  }
+  return nullptr;
+}
+
+bool ShaderCompiler::ready(ProgramId program) const
+{
+  return programs[program].stage == Stage::READY;
+}
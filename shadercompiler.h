@@ -0,0 +1,110 @@
+#ifndef SHADERCOMPILER_H
+#define SHADERCOMPILER_H
+
+#include <GL/glew.h>
+#include <chrono>
+#include <future>
+#include <map>
+#include <string>
+#include <vector>
+#include "programcache.h"
+#include "shader.h"
+
+/*
+ * ========================================
+ * Shader Compiler
+ * ========================================
+ * Builds every program in the background. submit() everything up front,
+ * then poll() once a frame: sources are read on worker threads, compiles
+ * and links are queued on the driver's compiler threads
+ * (GL_KHR_parallel_shader_compile) and checked with
+ * GL_COMPLETION_STATUS_KHR, so nothing waits on a compile.
+ *
+ * Until a program is ready get() hands out its fallback instead, a cheap
+ * program built the same way that the caller waits for once at startup.
+ *
+ * Defines make variants of one pair of files, each an "#define <define>"
+ * line after #version. Files are only read once however many variants use
+ * them.
+ *
+ * Without the extension the driver compiles on our thread anyway, so
+ * poll() then finishes each program as soon as its sources are in.
+ */
+typedef int ProgramId;
+static const ProgramId NO_PROGRAM = -1;
+
+struct ShaderCompilerStats
+{
+  unsigned int programs = 0;
+  unsigned int failed = 0;
+  // From construction until the last submitted program was done
+  double readyMs = 0;
+};
+
+class ShaderCompiler
+{
+public:
+  explicit ShaderCompiler(ProgramCache* cache = nullptr);
+  ~ShaderCompiler();
+  ShaderCompiler(const ShaderCompiler&) = delete;
+  ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+
+  bool parallel() const { return threaded; }
+
+  ProgramId submit(const std::string& vertexPath, const std::string& fragmentPath,
+                   const std::vector<std::string>& defines = {}, ProgramId fallback = NO_PROGRAM);
+
+  // Moves every program along without blocking, true if any became ready
+  bool poll();
+  // Blocks until the program is ready or failed, for fallbacks at startup
+  void wait(ProgramId program);
+
+  // The program if it's ready, else its fallback's, else nullptr
+  Shader* get(ProgramId program) const;
+  bool ready(ProgramId program) const;
+  unsigned int pending() const { return busy; }
+
+  ShaderCompilerStats stats() const { return counters; }
+
+private:
+  enum class Stage
+  {
+    READING,
+    LINKING,
+    READY,
+    FAILED
+  };
+
+  struct Program
+  {
+    Stage stage;
+    std::shared_future<std::string> vertexFile;
+    std::shared_future<std::string> fragmentFile;
+    std::vector<std::string> defines;
+    ProgramId fallback;
+
+    std::string vertexCode;
+    std::string fragmentCode;
+    unsigned int id;
+    unsigned int vertex;
+    unsigned int fragment;
+    Shader* shader;
+    bool announced; // poll() already reported it ready
+  };
+
+  std::shared_future<std::string> read(const std::string& path);
+  // Each returns true when the program moved on to another stage
+  bool startLink(Program& program);
+  bool finishLink(Program& program);
+  void finished(Program& program);
+
+  ProgramCache* cache;
+  bool threaded;
+  std::map<std::string, std::shared_future<std::string>> files;
+  std::vector<Program> programs;
+  unsigned int busy;
+  std::chrono::steady_clock::time_point start;
+  ShaderCompilerStats counters;
+};
+
+#endif
@@ -0,0 +1,35 @@
+#include "shadersource.h"
+#include "log.h"
+#include <fstream>
+#include <sstream>
+
+std::string readShaderFile(const std::string& path)
+{
+  std::ifstream file(path);
+  if (!file)
+  {
+    LOG(ERROR, LOG_SHADER, "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ %s", path.c_str());
+    return "";
+  }
+
+  std::stringstream stream;
+  stream << file.rdbuf();
+  return stream.str();
+}
+
+std::string withDefines(const std::string& code, const std::vector<std::string>& defines)
+{
+  if (defines.empty())
+    return code;
+
+  size_t line = code.compare(0, 8, "#version") == 0 ? code.find('\n') : std::string::npos;
+  size_t split = line == std::string::npos ? 0 : line + 1;
+
+  std::string result = code.substr(0, split);
+  for (const std::string& define : defines)
+    result += "#define " + define + "\n";
+  // Keep error line numbers pointing into the file
+  result += "#line " + std::to_string(split ? 2 : 1) + "\n";
+  result += code.substr(split);
+  return result;
+}
@@ -0,0 +1,20 @@
+#ifndef SHADERSOURCE_H
+#define SHADERSOURCE_H
+
+#include <string>
+#include <vector>
+
+/*
+ * ========================================
+ * Shader Source
+ * ========================================
+ * Reading GLSL off disk, no GL needed so it can be benchmarked headless.
+ */
+
+// Whole file, empty (with an error logged) if it can't be read
+std::string readShaderFile(const std::string& path);
+
+// Defines go right after #version, which has to stay the first line
+std::string withDefines(const std::string& code, const std::vector<std::string>& defines);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef SHIPMESHES_H
+#define SHIPMESHES_H
+
+/*
+ * ========================================
+ * Ship Meshes
+ * ========================================
+ * The ship's LODs, baked by assetc and loaded by the game, most detailed
+ * first. CMakeLists.txt lists the same files in MESHES.
+ */
+static const char* const SHIP_MESH_FILES[] = {
+  "res/meshes/ship.mesh", "res/meshes/ship_lod1.mesh", "res/meshes/ship_lod2.mesh"
+};
+static const int SHIP_LODS = sizeof(SHIP_MESH_FILES) / sizeof(SHIP_MESH_FILES[0]);
+
+#endif
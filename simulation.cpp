@@ -0,0 +1,151 @@
+#include "simulation.h"
+#include "models.h"
+#include "profiler.h"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+/*
+ * ========================================
+ * Fixed Timestep
+ * ========================================
+ */
+FixedTimestep::FixedTimestep(double dt, int maxSteps)
+  : dt(dt), accumulator(0), maxSteps(maxSteps)
+{
+}
+
+int FixedTimestep::advance(double elapsed)
+{
+  accumulator += elapsed;
+
+  int steps = (int) (accumulator / dt);
+  if (steps > maxSteps)
+  {
+    // We fell too far behind (debugger, window drag), drop the backlog
+    // instead of trying to catch up and falling further behind
+    steps = maxSteps;
+    accumulator = 0;
+    return steps;
+  }
+
+  accumulator -= steps * dt;
+  return steps;
+}
+
+float FixedTimestep::alpha() const
+{
+  return (float) (accumulator / dt);
+}
+
+/*
+ * ========================================
+ * Step
+ * ========================================
+ */
+// Below this handing out the work costs more than it saves
+static const size_t PARALLEL_ENTITIES = 32768;
+// Entities per job, about 170 KB of components, inside L2 on most cores
+static const size_t ENTITY_BATCH = 4096;
+
+SimState::SimState()
+{
+  player = world.create(0, 0, MESH_SHIP);
+  world.radius[world.find(player)] = boundingRadius(SHIP_MODEL);
+}
+
+void step(SimState& state, double dt, const SimInput& input, JobSystem* jobs)
+{
+  EntityStore& world = state.world;
+
+  long player = world.find(state.player);
+  if (player >= 0)
+  {
+    world.steer[player] = (input.left ? STEER_LEFT : 0) | (input.right ? STEER_RIGHT : 0) |
+                          (input.up ? STEER_UP : 0) | (input.down ? STEER_DOWN : 0);
+  }
+
+  if (jobs && jobs->threads() > 1 && world.size() >= PARALLEL_ENTITIES)
+  {
+    // Every system runs over a batch at a time while it's still in cache.
+    // Looking for bodies only reads radii, so it goes alongside; the rest of
+    // collision needs everyone moved, damage needs the contacts.
+    CollisionWorld& collisions = state.collisions;
+    collisions.beginScan(world.size());
+
+    TaskGraph graph;
+    TaskId entities = graph.add("entity systems", world.size(), ENTITY_BATCH, [&](size_t begin, size_t end)
+    {
+      snapshotSystem(world, begin, end);
+      steeringSystem(world, (float) dt, begin, end);
+      movementSystem(world, (float) dt, begin, end);
+    });
+    TaskId scan = graph.add("collision scan", world.size(), COLLISION_SCAN_BATCH, [&](size_t begin, size_t end)
+    {
+      collisions.scanBodies(world, begin, end);
+    });
+    TaskId collision = graph.add("collision", [&] { collisions.detectScanned(world); });
+    TaskId damage = graph.add("damage", [&] { damageSystem(world, collisions.started()); });
+    graph.depend(collision, entities);
+    graph.depend(collision, scan);
+    graph.depend(damage, collision);
+    jobs->run(graph);
+  }
+  else
+  {
+    {
+      PROFILE_SCOPE("entity systems");
+      snapshotSystem(world);
+      steeringSystem(world, (float) dt);
+      movementSystem(world, (float) dt);
+    }
+
+    {
+      PROFILE_SCOPE("collision");
+      state.collisions.detect(world);
+      damageSystem(world, state.collisions.started());
+    }
+  }
+
+  state.time += dt;
+  state.tick++;
+
+  // Test: Move light
+  state.prevLight = state.light;
+  state.light.z = 20 * std::sin(5.0 * state.time) - 20;
+}
+
+/*
+ * ========================================
+ * Headless
+ * ========================================
+ */
+int simulateHeadless(unsigned long long ticks)
+{
+  SimState state;
+  SimInput input;
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (unsigned long long i = 0; i < ticks; i++)
+  {
+    // Scripted input: left, right, up, down, two seconds each
+    unsigned long long phase = (i / 120) % 4;
+    input.left = phase == 0;
+    input.right = phase == 1;
+    input.up = phase == 2;
+    input.down = phase == 3;
+
+    step(state, SimConstants::DT, input);
+  }
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::cout << "Simulated " << ticks << " ticks (" << state.time << " s game time) in "
+            << seconds << " s, " << (seconds > 0 ? ticks / seconds : 0) << " ticks/s" << std::endl;
+  long player = state.world.find(state.player);
+  std::cout << "Final state: x " << state.world.x[player] << ", tilt " << state.world.tiltX[player] << ", "
+            << state.world.tiltY[player] << ", health " << state.world.health[player] << std::endl;
+
+  return 0;
+}
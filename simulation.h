@@ -0,0 +1,117 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "collision.h"
+#include "entities.h"
+#include "jobs.h"
+#include <vector>
+
+/*
+ * ========================================
+ * Simulation
+ * ========================================
+ * Game state and the fixed-timestep step function. Nothing in here may
+ * include SDL or OpenGL so the same code runs in the game and headless.
+ */
+
+/*
+ * Tuning
+ * All rates are per second. The old per-frame amounts were tuned at 60 FPS,
+ * so a 60 Hz tick reproduces them exactly.
+ */
+struct SimConstants
+{
+  static constexpr double TICK_RATE = 60.0;
+  static constexpr double DT = 1.0 / TICK_RATE;
+  static constexpr int MAX_STEPS_PER_FRAME = 8;
+
+  static constexpr float PI = 3.14159f;
+  static constexpr float X_LIMIT = 5.0f;
+  static constexpr float MOVE_SPEED = 6.0f;   // 0.1 per tick
+  static constexpr float TILT_LIMIT = PI / 4;
+  static constexpr float TILT_SPEED = 0.6f;   // 0.01 per tick
+  static constexpr float RETURN_SPEED = 3.0f; // 0.05 per tick
+  static constexpr float TILT_SNAP = 0.1f;
+  static constexpr int COLLISION_DAMAGE = 10; // Per new contact
+};
+
+struct SimInput
+{
+  bool left = false;
+  bool right = false;
+  bool up = false;
+  bool down = false;
+};
+
+// Mesh ids stored on entities, the renderer maps them to its own meshes
+enum MeshId : uint16_t
+{
+  MESH_SHIP = 0,
+  MESH_COUNT
+};
+
+struct SimLight
+{
+  float x = 0;
+  float y = 5;
+  float z = -20;
+};
+
+/*
+ * Everything the game simulates. Entities keep their own last-tick copy for
+ * interpolation, so there is a single state rather than a previous/current
+ * pair, and it can't be copied.
+ */
+struct SimState
+{
+  SimState();
+
+  EntityStore world;
+  EntityHandle player;
+  CollisionWorld collisions;
+  // Light
+  SimLight light;
+  SimLight prevLight;
+  // Clock
+  double time = 0;
+  unsigned long long tick = 0;
+};
+
+// Transforms of every entity in dense order, SoA like the store
+struct EntityTransforms
+{
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> tiltX;
+  std::vector<float> tiltY;
+};
+
+/*
+ * Accumulates real frame time and hands out whole ticks. Whatever is left
+ * over becomes the interpolation factor for rendering.
+ */
+class FixedTimestep
+{
+public:
+  FixedTimestep(double dt = SimConstants::DT, int maxSteps = SimConstants::MAX_STEPS_PER_FRAME);
+
+  // Returns how many ticks to run for this much elapsed time (seconds)
+  int advance(double elapsed);
+  // How far between the previous and current tick we are, [0, 1)
+  float alpha() const;
+
+  double dt;
+
+private:
+  double accumulator;
+  int maxSteps;
+};
+
+// With jobs, big worlds run their entity systems across every core. The
+// result is the same either way, to the bit.
+void step(SimState& state, double dt, const SimInput& input, JobSystem* jobs = nullptr);
+
+// Runs the simulation with scripted input as fast as possible, prints a report
+int simulateHeadless(unsigned long long ticks);
+
+#endif
@@ -0,0 +1,145 @@
+#include "snapshot.h"
+#include "profiler.h"
+
+/*
+ * ========================================
+ * Capture
+ * ========================================
+ */
+static void resizeTransforms(EntityTransforms& transforms, size_t count)
+{
+  transforms.x.resize(count);
+  transforms.y.resize(count);
+  transforms.tiltX.resize(count);
+  transforms.tiltY.resize(count);
+}
+
+// Where one mesh's entities go in a snapshot, so the copy loop isn't
+// reloading vector pointers after every store
+struct CaptureTarget
+{
+  float* fields[8];
+  size_t used;
+};
+
+void captureSnapshot(const SimState& state, FrameSnapshot& out)
+{
+  const EntityStore& world = state.world;
+  size_t count = world.size();
+
+  // Room for everyone in every mesh, trimmed after
+  CaptureTarget targets[MESH_COUNT];
+  for (int m = 0; m < MESH_COUNT; m++)
+  {
+    EntityTransforms& previous = out.previous[m];
+    EntityTransforms& current = out.current[m];
+    resizeTransforms(previous, count);
+    resizeTransforms(current, count);
+    targets[m] = { { previous.x.data(), previous.y.data(), previous.tiltX.data(), previous.tiltY.data(),
+                     current.x.data(), current.y.data(), current.tiltX.data(), current.tiltY.data() }, 0 };
+  }
+
+  const float* fields[8] = { world.prevX.data(), world.prevY.data(), world.prevTiltX.data(), world.prevTiltY.data(),
+                             world.x.data(), world.y.data(), world.tiltX.data(), world.tiltY.data() };
+  const uint16_t* meshes = world.mesh.data();
+  for (size_t i = 0; i < count; i++)
+  {
+    if (meshes[i] >= MESH_COUNT)
+      continue;
+
+    CaptureTarget& target = targets[meshes[i]];
+    size_t slot = target.used++;
+    for (int f = 0; f < 8; f++)
+      target.fields[f][slot] = fields[f][i];
+  }
+
+  for (int m = 0; m < MESH_COUNT; m++)
+  {
+    resizeTransforms(out.previous[m], targets[m].used);
+    resizeTransforms(out.current[m], targets[m].used);
+  }
+
+  out.prevLight = state.prevLight;
+  out.light = state.light;
+  out.tick = state.tick;
+}
+
+/*
+ * ========================================
+ * Interpolation
+ * ========================================
+ */
+static void blend(const std::vector<float>& from, const std::vector<float>& to, float alpha, std::vector<float>& out)
+{
+  size_t count = to.size();
+  out.resize(count);
+  for (size_t i = 0; i < count; i++)
+    out[i] = from[i] + (to[i] - from[i]) * alpha;
+}
+
+void interpolate(const FrameSnapshot& snapshot, float alpha, uint16_t mesh, EntityTransforms& out)
+{
+  const EntityTransforms& previous = snapshot.previous[mesh];
+  const EntityTransforms& current = snapshot.current[mesh];
+  blend(previous.x, current.x, alpha, out.x);
+  blend(previous.y, current.y, alpha, out.y);
+  blend(previous.tiltX, current.tiltX, alpha, out.tiltX);
+  blend(previous.tiltY, current.tiltY, alpha, out.tiltY);
+}
+
+SimLight interpolate(const FrameSnapshot& snapshot, float alpha)
+{
+  SimLight light;
+  light.x = snapshot.prevLight.x + (snapshot.light.x - snapshot.prevLight.x) * alpha;
+  light.y = snapshot.prevLight.y + (snapshot.light.y - snapshot.prevLight.y) * alpha;
+  light.z = snapshot.prevLight.z + (snapshot.light.z - snapshot.prevLight.z) * alpha;
+  return light;
+}
+
+/*
+ * ========================================
+ * Snapshot Buffer
+ * ========================================
+ */
+SnapshotBuffer::SnapshotBuffer()
+  : middle(1), writing(0), reading(2), received(false), published(0), dropped(0), waits(0)
+{
+}
+
+void SnapshotBuffer::publish()
+{
+  // Release so the reader sees the whole snapshot, acquire so we don't
+  // start writing into the old middle before the reader is done with it
+  uint8_t previous = middle.exchange(writing | FRESH, std::memory_order_acq_rel);
+  writing = previous & INDEX;
+
+  published.fetch_add(1, std::memory_order_relaxed);
+  if (previous & FRESH)
+    dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+const FrameSnapshot* SnapshotBuffer::acquire()
+{
+  if (middle.load(std::memory_order_relaxed) & FRESH)
+  {
+    uint8_t previous = middle.exchange(reading, std::memory_order_acq_rel);
+    reading = previous & INDEX;
+    received = true;
+  }
+  else
+  {
+    waits.fetch_add(1, std::memory_order_relaxed);
+    profiler.count(COUNTER_SNAPSHOT_WAITS);
+  }
+
+  return received ? &buffers[reading] : nullptr;
+}
+
+SnapshotStats SnapshotBuffer::stats() const
+{
+  SnapshotStats stats;
+  stats.published = published.load(std::memory_order_relaxed);
+  stats.dropped = dropped.load(std::memory_order_relaxed);
+  stats.waits = waits.load(std::memory_order_relaxed);
+  return stats;
+}
@@ -0,0 +1,83 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "simulation.h"
+#include <atomic>
+#include <cstdint>
+
+/*
+ * ========================================
+ * Frame Snapshots
+ * ========================================
+ * Everything the renderer draws from, copied out of the simulation after it
+ * ticks: each entity's transforms at the last two ticks, split by mesh,
+ * and the light. The render thread blends between the two while the
+ * simulation carries on with the next tick.
+ */
+struct FrameSnapshot
+{
+  // Per mesh, dense, the tick before and the latest
+  EntityTransforms previous[MESH_COUNT];
+  EntityTransforms current[MESH_COUNT];
+  SimLight prevLight;
+  SimLight light;
+  unsigned long long tick = 0;
+  // When the latest tick was due, in seconds on whatever clock the
+  // simulation and renderer share
+  double tickTime = 0;
+};
+
+// Reuses out's memory, nothing is allocated once the world stops growing
+void captureSnapshot(const SimState& state, FrameSnapshot& out);
+// Blend between the two ticks, only the entities drawn with mesh
+void interpolate(const FrameSnapshot& snapshot, float alpha, uint16_t mesh, EntityTransforms& out);
+SimLight interpolate(const FrameSnapshot& snapshot, float alpha);
+
+struct SnapshotStats
+{
+  unsigned long long published = 0; // By the simulation
+  unsigned long long dropped = 0;   // Replaced before the renderer got to them
+  unsigned long long waits = 0;     // Frames that found nothing new to draw
+};
+
+/*
+ * Lock-free triple buffer from the simulation thread to the render thread.
+ * One snapshot is being written, one drawn, and the newest finished one
+ * waits in the middle. Publishing swaps the written one into the middle,
+ * acquiring swaps the middle out if it's new. Neither side ever waits for
+ * the other; a renderer that's ahead draws the same snapshot again, a
+ * simulation that's ahead replaces one the renderer never saw.
+ */
+class SnapshotBuffer
+{
+public:
+  SnapshotBuffer();
+  SnapshotBuffer(const SnapshotBuffer&) = delete;
+  SnapshotBuffer& operator=(const SnapshotBuffer&) = delete;
+
+  // Simulation thread: fill this one in, then publish it
+  FrameSnapshot& back() { return buffers[writing]; }
+  void publish();
+
+  // Render thread: the newest published snapshot, nullptr before the first.
+  // Stays put until the next acquire.
+  const FrameSnapshot* acquire();
+
+  SnapshotStats stats() const;
+
+private:
+  static const uint8_t INDEX = 3;
+  static const uint8_t FRESH = 4; // Set when the middle hasn't been acquired
+
+  FrameSnapshot buffers[3];
+  std::atomic<uint8_t> middle;
+  uint8_t writing; // Simulation thread only
+  uint8_t reading; // Render thread only
+  bool received;   // Render thread only
+
+  std::atomic<unsigned long long> published;
+  std::atomic<unsigned long long> dropped;
+  std::atomic<unsigned long long> waits;
+};
+
+#endif
@@ -0,0 +1,208 @@
+#include "streaming.h"
+#include "log.h"
+#include <chrono>
+
+/*
+ * ========================================
+ * Stream Buffer
+ * ========================================
+ */
+StreamBuffer::StreamBuffer(GLenum target, size_t frameBytes)
+  : target(target), id(0), coherent(GLEW_ARB_buffer_storage), mapped(nullptr), rangeMapped(false),
+    regionBytes(0), region(0), used(0)
+{
+  for (int i = 0; i < STREAM_FRAMES; i++)
+    fences[i] = nullptr;
+
+  create(frameBytes);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+  destroy();
+}
+
+void StreamBuffer::create(size_t frameBytes)
+{
+  regionBytes = frameBytes;
+  region = 0;
+  used = 0;
+
+  glGenBuffers(1, &id);
+  glBindBuffer(target, id);
+
+  GLsizeiptr size = regionBytes * STREAM_FRAMES;
+  if (coherent)
+  {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(target, size, NULL, flags);
+    mapped = (char*) glMapBufferRange(target, 0, size, flags);
+    if (mapped)
+      return;
+
+    // Storage is immutable, start over with a plain buffer
+    LOG(ERROR, LOG_RENDER, "ERROR::STREAM::PERSISTENT_MAP_FAILED");
+    coherent = false;
+    glDeleteBuffers(1, &id);
+    glGenBuffers(1, &id);
+    glBindBuffer(target, id);
+  }
+
+  glBufferData(target, size, NULL, GL_STREAM_DRAW);
+}
+
+void StreamBuffer::destroy()
+{
+  for (int i = 0; i < STREAM_FRAMES; i++)
+  {
+    if (fences[i])
+      glDeleteSync(fences[i]);
+    fences[i] = nullptr;
+  }
+
+  if (mapped || rangeMapped)
+  {
+    glBindBuffer(target, id);
+    glUnmapBuffer(target);
+  }
+  mapped = nullptr;
+  rangeMapped = false;
+
+  glDeleteBuffers(1, &id);
+  id = 0;
+}
+
+void StreamBuffer::waitForRegion(int index)
+{
+  GLsync fence = fences[index];
+  if (!fence)
+    return;
+
+  GLenum result = glClientWaitSync(fence, 0, 0);
+  if (result == GL_TIMEOUT_EXPIRED)
+  {
+    // The GPU is more than STREAM_FRAMES behind, this is the stall the ring
+    // is there to avoid
+    auto start = std::chrono::steady_clock::now();
+    do
+    {
+      result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+    } while (result == GL_TIMEOUT_EXPIRED);
+
+    stats.fenceWaits++;
+    stats.waitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  if (result == GL_WAIT_FAILED)
+    LOG(ERROR, LOG_RENDER, "ERROR::STREAM::FENCE_WAIT_FAILED");
+
+  glDeleteSync(fence);
+  fences[index] = nullptr;
+}
+
+void StreamBuffer::grow(size_t bytes)
+{
+  // Frame outgrew the ring, wait for the GPU to let go of all of it
+  size_t grown = regionBytes * 2;
+  while (grown < bytes)
+    grown *= 2;
+
+  flush();
+  for (int i = 0; i < STREAM_FRAMES; i++)
+    waitForRegion(i);
+  destroy();
+  create(grown);
+  stats.resizes++;
+}
+
+void StreamBuffer::reserve(size_t bytes)
+{
+  if (bytes <= regionBytes)
+    return;
+
+  if (used > 0)
+  {
+    LOG(ERROR, LOG_RENDER, "ERROR::STREAM::RESERVE_AFTER_ALLOCATE");
+    return;
+  }
+  grow(bytes);
+}
+
+StreamAllocation StreamBuffer::allocate(size_t bytes, size_t alignment)
+{
+  size_t offset = (used + alignment - 1) & ~(alignment - 1);
+
+  if (offset + bytes > regionBytes)
+  {
+    // Earlier allocations may already be queued for drawing, they'd read
+    // whatever the new buffer holds
+    if (used > 0)
+    {
+      LOG(ERROR, LOG_RENDER, "ERROR::STREAM::FRAME_FULL %zu bytes, reserve() the frame first", offset + bytes);
+      StreamAllocation failed = { nullptr, 0 };
+      return failed;
+    }
+    grow(bytes);
+    offset = 0;
+  }
+
+  // First write this frame, make sure the GPU is done with the region
+  if (used == 0)
+    waitForRegion(region);
+
+  size_t start = region * regionBytes + offset;
+  used = offset + bytes;
+  stats.bytesStreamed += bytes;
+
+  StreamAllocation allocation;
+  allocation.offset = start;
+
+  if (mapped)
+  {
+    allocation.data = mapped + start;
+    return allocation;
+  }
+
+  flush();
+  glBindBuffer(target, id);
+  allocation.data = glMapBufferRange(target, start, bytes,
+                                     GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+  rangeMapped = allocation.data != nullptr;
+  if (!rangeMapped)
+    LOG(ERROR, LOG_RENDER, "ERROR::STREAM::MAP_FAILED");
+  return allocation;
+}
+
+void StreamBuffer::flush()
+{
+  // Coherent persistent writes are visible as they are
+  if (!rangeMapped)
+    return;
+
+  glBindBuffer(target, id);
+  glUnmapBuffer(target);
+  rangeMapped = false;
+}
+
+void StreamBuffer::endFrame()
+{
+  flush();
+
+  if (used > 0)
+  {
+    if (fences[region])
+      glDeleteSync(fences[region]);
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region = (region + 1) % STREAM_FRAMES;
+    used = 0;
+  }
+
+  stats.frames++;
+}
+
+StreamStats StreamBuffer::takeStats()
+{
+  StreamStats taken = stats;
+  stats = StreamStats();
+  return taken;
+}
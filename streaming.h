@@ -0,0 +1,83 @@
+#ifndef STREAMING_H
+#define STREAMING_H
+
+#include <GL/glew.h>
+#include <cstddef>
+
+/*
+ * ========================================
+ * Stream Buffer
+ * ========================================
+ * A ring of STREAM_FRAMES regions for data rewritten every frame. The CPU
+ * fills region N while the GPU still reads N-1 and N-2, and a fence per
+ * region makes sure we never write into one the GPU hasn't finished.
+ *
+ * With GL_ARB_buffer_storage the whole ring is mapped once, persistent and
+ * coherent, and allocate() just hands out pointers into it. Without it each
+ * allocation maps its range with glMapBufferRange (unsynchronized, the
+ * fences already cover that) and must be unmapped before drawing.
+ *
+ * Either way callers write straight into buffer memory, no staging copy.
+ */
+static const int STREAM_FRAMES = 3;
+
+struct StreamStats
+{
+  unsigned int frames = 0;
+  unsigned long long bytesStreamed = 0;
+  // Times we found the GPU still reading the region we wanted to fill
+  unsigned int fenceWaits = 0;
+  double waitMs = 0;
+  unsigned int resizes = 0;
+};
+
+struct StreamAllocation
+{
+  void* data;    // nullptr if the allocation failed
+  size_t offset; // Byte offset into buffer(), for attribute pointers
+};
+
+class StreamBuffer
+{
+public:
+  StreamBuffer(GLenum target, size_t frameBytes);
+  ~StreamBuffer();
+
+  // Grows the ring so bytes fit this frame, which stalls once. Call before
+  // the frame's first allocate: growing moves everything handed out.
+  void reserve(size_t bytes);
+  // Space for this frame, aligned to alignment (a power of two). The
+  // frame's first allocation grows the ring if it has to, later ones that
+  // don't fit fail.
+  StreamAllocation allocate(size_t bytes, size_t alignment);
+  // Makes allocations visible to GL, call before drawing from them
+  void flush();
+  // Fences this frame's region and moves on, once per frame after the draws
+  void endFrame();
+
+  unsigned int buffer() const { return id; }
+  bool persistent() const { return mapped != nullptr; }
+  // Counters since the last call
+  StreamStats takeStats();
+
+private:
+  void create(size_t frameBytes);
+  void destroy();
+  void grow(size_t bytes);
+  void waitForRegion(int region);
+
+  GLenum target;
+  unsigned int id;
+  bool coherent; // Persistent mapping available
+  char* mapped;  // Whole ring, persistent path only
+  bool rangeMapped;
+
+  size_t regionBytes;
+  int region;
+  size_t used;
+  GLsync fences[STREAM_FRAMES];
+
+  StreamStats stats;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#include "timeline.h"
+#include "log.h"
+#include <algorithm>
+#include <cstdio>
+
+Timeline startupTimeline;
+
+/*
+ * ========================================
+ * Timeline
+ * ========================================
+ */
+Timeline::Timeline()
+  : zero(std::chrono::steady_clock::now())
+{
+}
+
+double Timeline::now() const
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - zero).count();
+}
+
+void Timeline::record(const std::string& name, double startMs, double endMs)
+{
+  std::lock_guard<std::mutex> guard(lock);
+
+  auto found = threads.find(std::this_thread::get_id());
+  if (found == threads.end())
+    found = threads.emplace(std::this_thread::get_id(), (int) threads.size()).first;
+
+  spans.push_back({ name, found->second, startMs, endMs });
+}
+
+void Timeline::mark(const std::string& name)
+{
+  double at = now();
+  record(name, at, at);
+}
+
+bool Timeline::write(const char* path) const
+{
+  std::vector<TimelineSpan> sorted;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    sorted = spans;
+  }
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const TimelineSpan& a, const TimelineSpan& b) { return a.startMs < b.startMs; });
+
+  FILE* file = std::fopen(path, "w");
+  if (!file)
+  {
+    LOG(ERROR, LOG_GAME, "ERROR::TIMELINE::CANNOT_WRITE %s", path);
+    return false;
+  }
+
+  std::fprintf(file, "stage,thread,start_ms,end_ms\n");
+  for (const TimelineSpan& span : sorted)
+    std::fprintf(file, "%s,%d,%.3f,%.3f\n", span.name.c_str(), span.thread, span.startMs, span.endMs);
+  return std::fclose(file) == 0;
+}
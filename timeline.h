@@ -0,0 +1,49 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * ========================================
+ * Timeline
+ * ========================================
+ * Named spans from any thread, in ms since the timeline was made. The
+ * startup one is a global so its zero is as close to process start as we
+ * get, and write() dumps it as CSV to compare load orders.
+ */
+struct TimelineSpan
+{
+  std::string name;
+  int thread; // Numbered in the order threads first record something
+  double startMs;
+  double endMs;
+};
+
+class Timeline
+{
+public:
+  Timeline();
+
+  double now() const;
+  void record(const std::string& name, double startMs, double endMs);
+  // A span of zero length, for "this happened" moments
+  void mark(const std::string& name);
+
+  // Sorted by start time, false if the file can't be written
+  bool write(const char* path) const;
+
+private:
+  std::chrono::steady_clock::time_point zero;
+  mutable std::mutex lock;
+  std::vector<TimelineSpan> spans;
+  std::map<std::thread::id, int> threads;
+};
+
+extern Timeline startupTimeline;
+
+#endif
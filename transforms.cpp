@@ -0,0 +1,268 @@
+#include "transforms.h"
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TRANSFORMS_X86 1
+#include <immintrin.h>
+#endif
+
+/*
+ * ========================================
+ * Scalar
+ * ========================================
+ */
+static void buildScalar(const float* x, const float* y, const float* tiltX, const float* tiltY,
+                        size_t count, float* out)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    float sa = std::sin(tiltX[i]), ca = std::cos(tiltX[i]);
+    float sb = std::sin(tiltY[i]), cb = std::cos(tiltY[i]);
+    float* m = out + i * 16;
+
+    m[0] = ca;       m[1] = sa;       m[2] = 0;   m[3] = 0;
+    m[4] = -sa * cb; m[5] = ca * cb;  m[6] = sb;  m[7] = 0;
+    m[8] = sa * sb;  m[9] = -ca * sb; m[10] = cb; m[11] = 0;
+    m[12] = x[i];    m[13] = y[i];    m[14] = 0;  m[15] = 1;
+  }
+}
+
+#ifdef TRANSFORMS_X86
+/*
+ * Vector sin/cos, Cephes sinf/cosf polynomials. The angle is reduced to
+ * [-pi/4, pi/4] around the nearest multiple of pi/2 (pi/2 split in three so
+ * the reduction stays exact), then the quadrant swaps and negates the
+ * results. Good to about 1e-7 for the angles a game uses.
+ */
+static const float TWO_OVER_PI = 0.636619772367581343f;
+static const float PIO2_1 = 1.5703125f;
+static const float PIO2_2 = 4.837512969970703125e-4f;
+static const float PIO2_3 = 7.54978995489188216e-8f;
+static const float SIN_1 = -1.6666654611e-1f;
+static const float SIN_2 = 8.3321608736e-3f;
+static const float SIN_3 = -1.9515295891e-4f;
+static const float COS_1 = 4.166664568298827e-2f;
+static const float COS_2 = -1.388731625493765e-3f;
+static const float COS_3 = 2.443315711809948e-5f;
+
+/*
+ * ========================================
+ * SSE2
+ * ========================================
+ * Baseline on x86-64, no dispatch needed.
+ */
+static inline void sincos4(__m128 a, __m128& s, __m128& c)
+{
+  __m128i q = _mm_cvtps_epi32(_mm_mul_ps(a, _mm_set1_ps(TWO_OVER_PI)));
+  __m128 qf = _mm_cvtepi32_ps(q);
+
+  __m128 r = _mm_sub_ps(a, _mm_mul_ps(qf, _mm_set1_ps(PIO2_1)));
+  r = _mm_sub_ps(r, _mm_mul_ps(qf, _mm_set1_ps(PIO2_2)));
+  r = _mm_sub_ps(r, _mm_mul_ps(qf, _mm_set1_ps(PIO2_3)));
+  __m128 z = _mm_mul_ps(r, r);
+
+  __m128 ps = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIN_3), z), _mm_set1_ps(SIN_2));
+  ps = _mm_add_ps(_mm_mul_ps(ps, z), _mm_set1_ps(SIN_1));
+  ps = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ps, z), r), r);
+
+  __m128 pc = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(COS_3), z), _mm_set1_ps(COS_2));
+  pc = _mm_add_ps(_mm_mul_ps(pc, z), _mm_set1_ps(COS_1));
+  pc = _mm_mul_ps(_mm_mul_ps(pc, z), z);
+  pc = _mm_add_ps(_mm_sub_ps(pc, _mm_mul_ps(z, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+
+  // Odd quadrants swap sin and cos
+  __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+  s = _mm_or_ps(_mm_and_ps(swap, pc), _mm_andnot_ps(swap, ps));
+  c = _mm_or_ps(_mm_and_ps(swap, ps), _mm_andnot_ps(swap, pc));
+
+  // Bit 1 of the quadrant flips sin, bit 1 of quadrant + 1 flips cos
+  __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), 30));
+  __m128 cosSign = _mm_castsi128_ps(
+    _mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+  s = _mm_xor_ps(s, sinSign);
+  c = _mm_xor_ps(c, cosSign);
+}
+
+static void buildSse2(const float* x, const float* y, const float* tiltX, const float* tiltY,
+                      size_t count, float* out)
+{
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    __m128 sa, ca, sb, cb;
+    sincos4(_mm_loadu_ps(tiltX + i), sa, ca);
+    sincos4(_mm_loadu_ps(tiltY + i), sb, cb);
+
+    // One register per matrix element across 4 entities, then transpose
+    // each column back to one register per entity
+    __m128 col0[4] = { ca, sa, zero, zero };
+    __m128 col1[4] = { _mm_sub_ps(zero, _mm_mul_ps(sa, cb)), _mm_mul_ps(ca, cb), sb, zero };
+    __m128 col2[4] = { _mm_mul_ps(sa, sb), _mm_sub_ps(zero, _mm_mul_ps(ca, sb)), cb, zero };
+    __m128 col3[4] = { _mm_loadu_ps(x + i), _mm_loadu_ps(y + i), zero, one };
+    _MM_TRANSPOSE4_PS(col0[0], col0[1], col0[2], col0[3]);
+    _MM_TRANSPOSE4_PS(col1[0], col1[1], col1[2], col1[3]);
+    _MM_TRANSPOSE4_PS(col2[0], col2[1], col2[2], col2[3]);
+    _MM_TRANSPOSE4_PS(col3[0], col3[1], col3[2], col3[3]);
+
+    for (int k = 0; k < 4; k++)
+    {
+      float* m = out + (i + k) * 16;
+      _mm_storeu_ps(m, col0[k]);
+      _mm_storeu_ps(m + 4, col1[k]);
+      _mm_storeu_ps(m + 8, col2[k]);
+      _mm_storeu_ps(m + 12, col3[k]);
+    }
+  }
+
+  buildScalar(x + i, y + i, tiltX + i, tiltY + i, count - i, out + i * 16);
+}
+
+/*
+ * ========================================
+ * AVX2
+ * ========================================
+ * Compiled for AVX2 and FMA here only, picked at runtime.
+ */
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+
+AVX2_TARGET static inline void sincos8(__m256 a, __m256& s, __m256& c)
+{
+  __m256i q = _mm256_cvtps_epi32(_mm256_mul_ps(a, _mm256_set1_ps(TWO_OVER_PI)));
+  __m256 qf = _mm256_cvtepi32_ps(q);
+
+  __m256 r = _mm256_fnmadd_ps(qf, _mm256_set1_ps(PIO2_1), a);
+  r = _mm256_fnmadd_ps(qf, _mm256_set1_ps(PIO2_2), r);
+  r = _mm256_fnmadd_ps(qf, _mm256_set1_ps(PIO2_3), r);
+  __m256 z = _mm256_mul_ps(r, r);
+
+  __m256 ps = _mm256_fmadd_ps(_mm256_set1_ps(SIN_3), z, _mm256_set1_ps(SIN_2));
+  ps = _mm256_fmadd_ps(ps, z, _mm256_set1_ps(SIN_1));
+  ps = _mm256_fmadd_ps(_mm256_mul_ps(ps, z), r, r);
+
+  __m256 pc = _mm256_fmadd_ps(_mm256_set1_ps(COS_3), z, _mm256_set1_ps(COS_2));
+  pc = _mm256_fmadd_ps(pc, z, _mm256_set1_ps(COS_1));
+  pc = _mm256_mul_ps(_mm256_mul_ps(pc, z), z);
+  pc = _mm256_add_ps(_mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), pc), _mm256_set1_ps(1.0f));
+
+  __m256 swap = _mm256_castsi256_ps(
+    _mm256_cmpeq_epi32(_mm256_and_si256(q, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+  s = _mm256_blendv_ps(ps, pc, swap);
+  c = _mm256_blendv_ps(pc, ps, swap);
+
+  __m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(q, _mm256_set1_epi32(2)), 30));
+  __m256 cosSign = _mm256_castsi256_ps(
+    _mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(q, _mm256_set1_epi32(1)), _mm256_set1_epi32(2)), 30));
+  s = _mm256_xor_ps(s, sinSign);
+  c = _mm256_xor_ps(c, cosSign);
+}
+
+// 4x4 transpose inside each 128 bit half: entities 0-3 low, 4-7 high
+AVX2_TARGET static inline void transpose8(__m256 v[4])
+{
+  __m256 t0 = _mm256_unpacklo_ps(v[0], v[1]);
+  __m256 t1 = _mm256_unpackhi_ps(v[0], v[1]);
+  __m256 t2 = _mm256_unpacklo_ps(v[2], v[3]);
+  __m256 t3 = _mm256_unpackhi_ps(v[2], v[3]);
+  v[0] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+  v[1] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+  v[2] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+  v[3] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+AVX2_TARGET static void buildAvx2(const float* x, const float* y, const float* tiltX,
+                                  const float* tiltY, size_t count, float* out)
+{
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    __m256 sa, ca, sb, cb;
+    sincos8(_mm256_loadu_ps(tiltX + i), sa, ca);
+    sincos8(_mm256_loadu_ps(tiltY + i), sb, cb);
+
+    __m256 col0[4] = { ca, sa, zero, zero };
+    __m256 col1[4] = { _mm256_sub_ps(zero, _mm256_mul_ps(sa, cb)), _mm256_mul_ps(ca, cb), sb, zero };
+    __m256 col2[4] = { _mm256_mul_ps(sa, sb), _mm256_sub_ps(zero, _mm256_mul_ps(ca, sb)), cb, zero };
+    __m256 col3[4] = { _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), zero, one };
+    transpose8(col0);
+    transpose8(col1);
+    transpose8(col2);
+    transpose8(col3);
+
+    // Pair columns up so every store writes half a matrix
+    for (int k = 0; k < 4; k++)
+    {
+      float* low = out + (i + k) * 16;
+      float* high = out + (i + k + 4) * 16;
+      _mm256_storeu_ps(low, _mm256_permute2f128_ps(col0[k], col1[k], 0x20));
+      _mm256_storeu_ps(low + 8, _mm256_permute2f128_ps(col2[k], col3[k], 0x20));
+      _mm256_storeu_ps(high, _mm256_permute2f128_ps(col0[k], col1[k], 0x31));
+      _mm256_storeu_ps(high + 8, _mm256_permute2f128_ps(col2[k], col3[k], 0x31));
+    }
+  }
+
+  buildScalar(x + i, y + i, tiltX + i, tiltY + i, count - i, out + i * 16);
+}
+#endif
+
+/*
+ * ========================================
+ * Dispatch
+ * ========================================
+ */
+static SimdLevel detectSimdLevel()
+{
+#ifdef TRANSFORMS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return SimdLevel::AVX2;
+  if (__builtin_cpu_supports("sse2"))
+    return SimdLevel::SSE2;
+#endif
+  return SimdLevel::SCALAR;
+}
+
+SimdLevel simdLevel()
+{
+  static const SimdLevel level = detectSimdLevel();
+  return level;
+}
+
+const char* simdLevelName(SimdLevel level)
+{
+  switch (level)
+  {
+  case SimdLevel::AVX2:
+    return "avx2";
+  case SimdLevel::SSE2:
+    return "sse2";
+  default:
+    return "scalar";
+  }
+}
+
+void buildModelMatrices(const float* x, const float* y, const float* tiltX, const float* tiltY,
+                        size_t count, float* out)
+{
+  buildModelMatrices(simdLevel(), x, y, tiltX, tiltY, count, out);
+}
+
+void buildModelMatrices(SimdLevel level, const float* x, const float* y, const float* tiltX,
+                        const float* tiltY, size_t count, float* out)
+{
+  if ((int) level > (int) simdLevel())
+    level = SimdLevel::SCALAR;
+
+#ifdef TRANSFORMS_X86
+  if (level == SimdLevel::AVX2)
+    return buildAvx2(x, y, tiltX, tiltY, count, out);
+  if (level == SimdLevel::SSE2)
+    return buildSse2(x, y, tiltX, tiltY, count, out);
+#endif
+  buildScalar(x, y, tiltX, tiltY, count, out);
+}
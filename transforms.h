@@ -0,0 +1,35 @@
+#ifndef TRANSFORMS_H
+#define TRANSFORMS_H
+
+#include <cstddef>
+
+/*
+ * ========================================
+ * Model Matrices
+ * ========================================
+ * Builds translate(x, y, 0) * rotateZ(tiltX) * rotateX(tiltY) for a whole
+ * batch of entities straight from their SoA arrays, the same matrix the
+ * glm::translate/glm::rotate chain gives but without any 4x4 multiplies.
+ *
+ * Output is 16 floats per entity, column-major, so it can be uploaded as
+ * glm::mat4 instance data as is.
+ */
+enum class SimdLevel
+{
+  SCALAR,
+  SSE2,
+  AVX2
+};
+
+// Best level this CPU runs, checked once
+SimdLevel simdLevel();
+const char* simdLevelName(SimdLevel level);
+
+void buildModelMatrices(const float* x, const float* y, const float* tiltX, const float* tiltY,
+                        size_t count, float* out);
+// Forces one implementation, for benchmarks. Falls back to scalar if the
+// CPU can't run it.
+void buildModelMatrices(SimdLevel level, const float* x, const float* y, const float* tiltX,
+                        const float* tiltY, size_t count, float* out);
+
+#endif
@@ -0,0 +1,287 @@
+#include "vertexformat.h"
+#include "mesh.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/*
+ * ========================================
+ * Half Floats
+ * ========================================
+ */
+uint16_t encodeHalf(float value)
+{
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  uint32_t sign = (bits >> 16) & 0x8000;
+  uint32_t magnitude = bits & 0x7FFFFFFF;
+
+  // Infinity and NaN, then anything that rounds past 65504
+  if (magnitude >= 0x7F800000)
+    return (uint16_t) (sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0));
+  if (magnitude >= 0x477FF000)
+    return (uint16_t) (sign | 0x7C00);
+
+  // Below 2^-14 only subnormals are left, steps of 2^-24
+  if (magnitude < 0x38800000)
+  {
+    if (magnitude < 0x33000000)
+      return (uint16_t) sign;
+    uint32_t shift = 126 - (magnitude >> 23);
+    uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+    uint32_t half = mantissa >> shift;
+    uint32_t rest = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (half & 1)))
+      half++;
+    return (uint16_t) (sign | half);
+  }
+
+  // Rebias the exponent and drop 13 bits of mantissa, a carry out of the
+  // mantissa bumps the exponent as it should
+  uint32_t half = (magnitude - 0x38000000) >> 13;
+  uint32_t rest = magnitude & 0x1FFF;
+  if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+    half++;
+  return (uint16_t) (sign | half);
+}
+
+float decodeHalf(uint16_t half)
+{
+  uint32_t sign = (uint32_t) (half & 0x8000) << 16;
+  uint32_t exponent = (half >> 10) & 0x1F;
+  uint32_t mantissa = half & 0x3FF;
+
+  if (exponent == 0)
+  {
+    float value = std::ldexp((float) mantissa, -24);
+    return sign ? -value : value;
+  }
+
+  uint32_t bits = exponent == 31 ? sign | 0x7F800000 | (mantissa << 13)
+                                 : sign | ((exponent + 112) << 23) | (mantissa << 13);
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/*
+ * ========================================
+ * Integers
+ * ========================================
+ */
+// One component as a bits wide integer. Clamped while still a float,
+// lround of anything past a long is undefined, and NaN has no nearest
+// step so it goes to 0.
+static int32_t encodeInteger(float value, int bits, bool isSigned, bool normalized)
+{
+  if (std::isnan(value))
+    return 0;
+
+  int32_t high = isSigned ? (1 << (bits - 1)) - 1 : (1 << bits) - 1;
+  int32_t low = isSigned ? -high - 1 : 0;
+  if (normalized)
+    value = std::min(std::max(value, isSigned ? -1.0f : 0.0f), 1.0f) * high;
+  value = std::min(std::max(value, (float) low), (float) high);
+  return (int32_t) std::lround(value);
+}
+
+static float decodeInteger(int32_t value, int bits, bool isSigned, bool normalized)
+{
+  if (!normalized)
+    return (float) value;
+  float high = (float) (isSigned ? (1 << (bits - 1)) - 1 : (1 << bits) - 1);
+  return std::max(value / high, -1.0f);
+}
+
+// The low bits of packed, sign extended
+static int32_t signExtend(uint32_t packed, int bits)
+{
+  uint32_t value = packed & ((1u << bits) - 1);
+  return (int32_t) (value << (32 - bits)) >> (32 - bits);
+}
+
+/*
+ * ========================================
+ * Attributes
+ * ========================================
+ */
+uint32_t attributeBytes(MeshAttributeType type, uint32_t components)
+{
+  switch (type)
+  {
+  case MESH_FLOAT16:
+  case MESH_INT16:
+    return components * 2;
+  case MESH_UINT8:
+    return components;
+  case MESH_INT_2_10_10_10:
+    return 4;
+  case MESH_FLOAT32:
+  default:
+    return components * 4;
+  }
+}
+
+void encodeAttribute(MeshAttributeType type, bool normalized, uint32_t components, const float* in,
+                     uint32_t count, void* out)
+{
+  float values[4] = {};
+  std::copy(in, in + std::min(count, 4u), values);
+
+  switch (type)
+  {
+  case MESH_FLOAT16:
+  {
+    uint16_t halves[4];
+    for (uint32_t i = 0; i < components; i++)
+      halves[i] = encodeHalf(values[i]);
+    std::memcpy(out, halves, components * sizeof(uint16_t));
+    break;
+  }
+  case MESH_INT16:
+  {
+    int16_t shorts[4];
+    for (uint32_t i = 0; i < components; i++)
+      shorts[i] = (int16_t) encodeInteger(values[i], 16, true, normalized);
+    std::memcpy(out, shorts, components * sizeof(int16_t));
+    break;
+  }
+  case MESH_UINT8:
+  {
+    uint8_t* bytes = (uint8_t*) out;
+    for (uint32_t i = 0; i < components; i++)
+      bytes[i] = (uint8_t) encodeInteger(values[i], 8, false, normalized);
+    break;
+  }
+  case MESH_INT_2_10_10_10:
+  {
+    // x in the lowest bits, GL_INT_2_10_10_10_REV's order
+    uint32_t packed = 0;
+    for (int i = 0; i < 3; i++)
+      packed |= ((uint32_t) encodeInteger(values[i], 10, true, normalized) & 0x3FF) << (i * 10);
+    packed |= ((uint32_t) encodeInteger(values[3], 2, true, normalized) & 0x3) << 30;
+    std::memcpy(out, &packed, sizeof(packed));
+    break;
+  }
+  case MESH_FLOAT32:
+  default:
+    std::memcpy(out, values, components * sizeof(float));
+    break;
+  }
+}
+
+void decodeAttribute(MeshAttributeType type, bool normalized, uint32_t components, const void* in, float* out)
+{
+  switch (type)
+  {
+  case MESH_FLOAT16:
+  {
+    uint16_t halves[4];
+    std::memcpy(halves, in, components * sizeof(uint16_t));
+    for (uint32_t i = 0; i < components; i++)
+      out[i] = decodeHalf(halves[i]);
+    break;
+  }
+  case MESH_INT16:
+  {
+    int16_t shorts[4];
+    std::memcpy(shorts, in, components * sizeof(int16_t));
+    for (uint32_t i = 0; i < components; i++)
+      out[i] = decodeInteger(shorts[i], 16, true, normalized);
+    break;
+  }
+  case MESH_UINT8:
+  {
+    const uint8_t* bytes = (const uint8_t*) in;
+    for (uint32_t i = 0; i < components; i++)
+      out[i] = decodeInteger(bytes[i], 8, false, normalized);
+    break;
+  }
+  case MESH_INT_2_10_10_10:
+  {
+    uint32_t packed;
+    std::memcpy(&packed, in, sizeof(packed));
+    for (int i = 0; i < 3; i++)
+      out[i] = decodeInteger(signExtend(packed >> (i * 10), 10), 10, true, normalized);
+    out[3] = decodeInteger(signExtend(packed >> 30, 2), 2, true, normalized);
+    break;
+  }
+  case MESH_FLOAT32:
+  default:
+    std::memcpy(out, in, components * sizeof(float));
+    break;
+  }
+}
+
+float vertexError(MeshAttributeType type, bool normalized, float range)
+{
+  // Half a step, and the float maths either side of the rounding can
+  // push a value that was just under half a step just over
+  float step;
+  switch (type)
+  {
+  case MESH_FLOAT16:
+  {
+    // Steps of the binade range is in, subnormal steps below 2^-14
+    int exponent = std::max((int) std::floor(std::log2(std::max(range, 1e-30f))), -14);
+    step = std::ldexp(1.0f, exponent - 10);
+    break;
+  }
+  case MESH_INT16:
+    step = normalized ? 1.0f / 32767.0f : 1.0f;
+    break;
+  case MESH_UINT8:
+    step = normalized ? 1.0f / 255.0f : 1.0f;
+    break;
+  case MESH_INT_2_10_10_10:
+    step = normalized ? 1.0f / 511.0f : 1.0f;
+    break;
+  case MESH_FLOAT32:
+  default:
+    return 0.0f;
+  }
+  return step * 0.5f + range * std::ldexp(1.0f, -22);
+}
+
+/*
+ * ========================================
+ * Lit Vertices
+ * ========================================
+ */
+VertexLayout vertexLayout(const VertexFormat& format)
+{
+  const MeshAttributeType types[3] = { format.position, format.color, format.normal };
+
+  VertexLayout layout;
+  uint32_t offset = 0;
+  for (uint32_t i = 0; i < 3; i++)
+  {
+    MeshAttribute& attribute = layout.attributes[i];
+    attribute.location = i;
+    attribute.components = types[i] == MESH_INT_2_10_10_10 ? 4 : 3;
+    attribute.type = types[i];
+    attribute.normalized = i > 0 && types[i] != MESH_FLOAT32 && types[i] != MESH_FLOAT16;
+    attribute.offset = offset;
+    offset = (offset + attributeBytes(types[i], attribute.components) + 3) / 4 * 4;
+  }
+  layout.stride = offset;
+  return layout;
+}
+
+void packVertices(const float* vertices, uint32_t count, const VertexLayout& layout, std::vector<uint8_t>& out)
+{
+  // Zeros in the padding, so the files bake the same every time
+  out.assign((size_t) count * layout.stride, 0);
+  for (uint32_t v = 0; v < count; v++)
+  {
+    const float* vertex = vertices + (size_t) v * MESH_STRIDE;
+    uint8_t* packed = out.data() + (size_t) v * layout.stride;
+    for (int i = 0; i < 3; i++)
+    {
+      const MeshAttribute& attribute = layout.attributes[i];
+      encodeAttribute((MeshAttributeType) attribute.type, attribute.normalized != 0, attribute.components,
+                      vertex + i * 3, 3, packed + attribute.offset);
+    }
+  }
+}
@@ -0,0 +1,70 @@
+#ifndef VERTEXFORMAT_H
+#define VERTEXFORMAT_H
+
+#include "meshfile.h"
+#include <cstdint>
+#include <vector>
+
+/*
+ * ========================================
+ * Vertex Formats
+ * ========================================
+ * Packing float vertices into the smaller types a .mesh file can hold,
+ * and reading them back exactly as GL will. Normalized integers decode
+ * the GL 4.2 way, c / (2^(b-1) - 1) clamped to -1 for signed ones; older
+ * drivers that still use (2c + 1) / (2^b - 1) land within one more step.
+ *
+ * Values are rounded to the nearest step and clamped to what the type can
+ * hold, so anything in range comes back within vertexError() of where it
+ * started. Infinities clamp like any other value; NaN stores as 0 in the
+ * integer types and stays NaN in half floats.
+ */
+// Bytes one attribute of this many components takes
+uint32_t attributeBytes(MeshAttributeType type, uint32_t components);
+
+// Stores count floats from in as components values of type, missing ones
+// zero. MESH_INT_2_10_10_10 takes 3 or 4 and is always 4 components.
+void encodeAttribute(MeshAttributeType type, bool normalized, uint32_t components, const float* in,
+                     uint32_t count, void* out);
+// The components floats the vertex shader sees
+void decodeAttribute(MeshAttributeType type, bool normalized, uint32_t components, const void* in, float* out);
+
+// Worst round trip error for values within [-range, range], which must be
+// in the type's range: at most 1 for normalized types. Half a step, give
+// or take float rounding.
+float vertexError(MeshAttributeType type, bool normalized, float range);
+
+// Half floats, rounded to nearest even. Overflow goes to infinity.
+uint16_t encodeHalf(float value);
+float decodeHalf(uint16_t half);
+
+/*
+ * What the lit vertex (position, colour, normal, see mesh.h) is stored as.
+ * Colours and normals are always normalized. Positions have to be a float
+ * type: normalized ones would need a scale per mesh in the shader.
+ */
+struct VertexFormat
+{
+  MeshAttributeType position; // MESH_FLOAT32 or MESH_FLOAT16
+  MeshAttributeType color;    // MESH_FLOAT32 or MESH_UINT8
+  MeshAttributeType normal;   // MESH_FLOAT32, MESH_INT16 or MESH_INT_2_10_10_10
+};
+
+// 36 bytes a vertex
+static const VertexFormat VERTEX_FORMAT_FLOAT = { MESH_FLOAT32, MESH_FLOAT32, MESH_FLOAT32 };
+// 16 bytes a vertex
+static const VertexFormat VERTEX_FORMAT_PACKED = { MESH_FLOAT16, MESH_UINT8, MESH_INT_2_10_10_10 };
+
+struct VertexLayout
+{
+  MeshAttribute attributes[3]; // Position, colour, normal, at locations 0 to 2
+  uint32_t stride;             // Bytes, attributes start 4 byte aligned
+};
+
+VertexLayout vertexLayout(const VertexFormat& format);
+
+// Interleaves count of mesh.h's float vertices as layout says. out is
+// refilled.
+void packVertices(const float* vertices, uint32_t count, const VertexLayout& layout, std::vector<uint8_t>& out);
+
+#endif